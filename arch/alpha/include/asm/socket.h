@@ -62,6 +62,10 @@
 
 #define SO_MARK			36
 
+#define SO_BUSY_POLL		46
+
+#define SO_ZEROCOPY		60
+
 /* O_NONBLOCK clashes with the bits used for socket types.  Therefore we
  * have to define SOCK_NONBLOCK to a different value here.
  */
@@ -54,4 +54,8 @@
 
 #define SO_MARK			36
 
+#define SO_BUSY_POLL		46
+
+#define SO_ZEROCOPY		60
+
 #endif /* __ASM_AVR32_SOCKET_H */
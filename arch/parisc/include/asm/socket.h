@@ -54,6 +54,10 @@
 
 #define SO_MARK			0x401f
 
+#define SO_BUSY_POLL		0x4027
+
+#define SO_ZEROCOPY		0x4035
+
 /* O_NONBLOCK clashes with the bits used for socket types.  Therefore we
  * have to define SOCK_NONBLOCK to a different value here.
  */
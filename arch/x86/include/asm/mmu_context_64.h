@@ -21,6 +21,8 @@ static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 #ifdef CONFIG_SMP
 		write_pda(mmu_state, TLBSTATE_OK);
 		write_pda(active_mm, next);
+		/* the cr3 load below takes care of skipped flushes */
+		write_pda(tlb_flush_pending, 0);
 #endif
 		cpu_set(cpu, next->cpu_vm_mask);
 		load_cr3(next->pgd);
@@ -37,9 +39,19 @@ static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 			/* We were in lazy tlb mode and leave_mm disabled
 			 * tlb flush IPI delivery. We must reload CR3
 			 * to make sure to use no freed page tables.
+			 * That also covers any flush skipped meanwhile.
 			 */
+			write_pda(tlb_flush_pending, 0);
 			load_cr3(next->pgd);
 			load_LDT_nolock(&next->context);
+		} else if (read_pda(tlb_flush_pending)) {
+			/*
+			 * Flushes were skipped while we were lazy, see
+			 * flush_tlb_skip_lazy().  The locked bit operation
+			 * above orders the mmu_state store before this load.
+			 */
+			write_pda(tlb_flush_pending, 0);
+			local_flush_tlb();
 		}
 	}
 #endif
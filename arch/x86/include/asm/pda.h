@@ -37,6 +37,7 @@ struct x8664_pda {
 	unsigned irq_thermal_count;
 	unsigned irq_threshold_count;
 	unsigned irq_spurious_count;
+	short tlb_flush_pending;	/* flush skipped in lazy tlb mode */
 } ____cacheline_aligned_in_smp;
 
 extern struct x8664_pda **_cpu_pda;
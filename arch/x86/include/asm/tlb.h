@@ -4,7 +4,9 @@
 #define tlb_start_vma(tlb, vma) do { } while (0)
 #define tlb_end_vma(tlb, vma) do { } while (0)
 #define __tlb_remove_tlb_entry(tlb, ptep, address) do { } while (0)
-#define tlb_flush(tlb) flush_tlb_mm((tlb)->mm)
+#define tlb_flush(tlb)						\
+	flush_tlb_mm_range((tlb)->mm, (tlb)->start, (tlb)->end,		\
+			   (tlb)->freed_tables)
 
 #include <asm-generic/tlb.h>
 
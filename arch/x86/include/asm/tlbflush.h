@@ -76,15 +76,16 @@ static inline void __flush_tlb_one(unsigned long addr)
  *  - flush_tlb_mm(mm) flushes the specified mm context TLB's
  *  - flush_tlb_page(vma, vmaddr) flushes one page
  *  - flush_tlb_range(vma, start, end) flushes a range of pages
+ *  - flush_tlb_mm_range(mm, start, end, freed_tables) flushes a range of
+ *    pages of the specified mm, after unmapping or freeing page tables
  *  - flush_tlb_kernel_range(start, end) flushes a range of kernel pages
  *  - flush_tlb_others(cpumask, mm, va) flushes TLBs on other cpus
  *
  * ..but the i386 has somewhat limited tlb flushing capabilities,
  * and page-granular flushes are available only on i486 and up.
  *
- * x86-64 can only flush individual pages or full VMs. For a range flush
- * we always do the full VM. Might be worth trying if for a small
- * range a few INVLPGs in a row are a win.
+ * x86-64 can only flush individual pages or full VMs. Small ranges are
+ * flushed with a few INVLPGs in a row, larger ones flush the full VM.
  */
 
 #ifndef CONFIG_SMP
@@ -113,6 +114,13 @@ static inline void flush_tlb_range(struct vm_area_struct *vma,
 		__flush_tlb();
 }
 
+static inline void flush_tlb_mm_range(struct mm_struct *mm,
+				      unsigned long start, unsigned long end,
+				      int freed_tables)
+{
+	flush_tlb_mm(mm);
+}
+
 static inline void native_flush_tlb_others(const cpumask_t *cpumask,
 					   struct mm_struct *mm,
 					   unsigned long va)
@@ -136,10 +144,23 @@ extern void flush_tlb_page(struct vm_area_struct *, unsigned long);
 
 #define flush_tlb()	flush_tlb_current_task()
 
+#ifdef CONFIG_X86_64
+extern void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
+			       unsigned long end, int freed_tables);
+extern void flush_tlb_batched(cpumask_t *cpumask);
+#else
+static inline void flush_tlb_mm_range(struct mm_struct *mm,
+				      unsigned long start, unsigned long end,
+				      int freed_tables)
+{
+	flush_tlb_mm(mm);
+}
+#endif
+
 static inline void flush_tlb_range(struct vm_area_struct *vma,
 				   unsigned long start, unsigned long end)
 {
-	flush_tlb_mm(vma->vm_mm);
+	flush_tlb_mm_range(vma->vm_mm, start, end, 0);
 }
 
 void native_flush_tlb_others(const cpumask_t *cpumask, struct mm_struct *mm,
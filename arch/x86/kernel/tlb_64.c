@@ -45,7 +45,8 @@ union smp_flush_state {
 	struct {
 		cpumask_t flush_cpumask;
 		struct mm_struct *flush_mm;
-		unsigned long flush_va;
+		unsigned long flush_start;
+		unsigned long flush_end;
 		spinlock_t tlbstate_lock;
 	};
 	char pad[SMP_CACHE_BYTES];
@@ -56,6 +57,14 @@ union smp_flush_state {
    want false sharing in the per cpu data segment. */
 static DEFINE_PER_CPU(union smp_flush_state, flush_state);
 
+/*
+ * Up to this many pages are flushed one by one with invlpg, larger
+ * ranges flush the whole TLB.  An invlpg costs about as much as
+ * refilling a few TLB entries, so past a few dozen pages throwing away
+ * the entire TLB is cheaper, even counting the refills.
+ */
+static unsigned long tlb_single_page_flush_ceiling __read_mostly = 33;
+
 /*
  * We cannot call mmdrop() because we are in interrupt context,
  * instead update mm->cpu_vm_mask.
@@ -108,10 +117,48 @@ EXPORT_SYMBOL_GPL(leave_mm);
  * write/read ordering problems.
  */
 
+/*
+ * A cpu in lazy tlb mode runs a kernel thread on a borrowed mm and does
+ * not use its user space translations, so it does not need to be flushed
+ * right away: it only has to flush before it switches back to that mm.
+ * Mark it so in the pda instead of interrupting it, unless page tables are
+ * being freed, which it could still walk speculatively.
+ *
+ * The mmu_state store and the tlb_flush_pending load in switch_mm() pair
+ * with the store and load here: either the cpu sees the pending flush, or
+ * we see it left lazy mode and send it the IPI.
+ */
+static void flush_tlb_skip_lazy(cpumask_t *cpumask)
+{
+	int cpu;
+
+	for_each_cpu_mask_nr(cpu, *cpumask) {
+		if (cpu_pda(cpu)->mmu_state != TLBSTATE_LAZY)
+			continue;
+		cpu_pda(cpu)->tlb_flush_pending = 1;
+		smp_mb();
+		if (cpu_pda(cpu)->mmu_state == TLBSTATE_LAZY)
+			cpu_clear(cpu, *cpumask);
+	}
+}
+
+static void local_flush_tlb_range(unsigned long start, unsigned long end)
+{
+	unsigned long addr;
+
+	if (start == TLB_FLUSH_ALL) {
+		local_flush_tlb();
+		return;
+	}
+	for (addr = start; addr < end; addr += PAGE_SIZE)
+		__flush_tlb_one(addr);
+}
+
 /*
  * TLB flush IPI:
  *
- * 1) Flush the tlb entries if the cpu uses the mm that's being flushed.
+ * 1) Flush the tlb entries if the cpu uses the mm that's being flushed,
+ *    or any mm if none is given.
  * 2) Leave the mm if we are in the lazy tlb mode.
  *
  * Interrupts are disabled.
@@ -142,13 +189,10 @@ asmlinkage void smp_invalidate_interrupt(struct pt_regs *regs)
 		 * BUG();
 		 */
 
-	if (f->flush_mm == read_pda(active_mm)) {
-		if (read_pda(mmu_state) == TLBSTATE_OK) {
-			if (f->flush_va == TLB_FLUSH_ALL)
-				local_flush_tlb();
-			else
-				__flush_tlb_one(f->flush_va);
-		} else
+	if (!f->flush_mm || f->flush_mm == read_pda(active_mm)) {
+		if (read_pda(mmu_state) == TLBSTATE_OK)
+			local_flush_tlb_range(f->flush_start, f->flush_end);
+		else
 			leave_mm(cpu);
 	}
 out:
@@ -157,15 +201,26 @@ out:
 	inc_irq_stat(irq_tlb_count);
 }
 
-void native_flush_tlb_others(const cpumask_t *cpumaskp, struct mm_struct *mm,
-			     unsigned long va)
+/*
+ * Flush [start, end) of @mm on the cpus in @cpumaskp, or their whole TLB
+ * if @start is TLB_FLUSH_ALL.  A NULL @mm flushes whatever mm they run.
+ */
+static void native_flush_tlb_others_range(const cpumask_t *cpumaskp,
+					  struct mm_struct *mm,
+					  unsigned long start,
+					  unsigned long end)
 {
 	int sender;
 	union smp_flush_state *f;
 	cpumask_t cpumask = *cpumaskp;
 
-	if (is_uv_system() && uv_flush_tlb_others(&cpumask, mm, va))
-		return;
+	if (is_uv_system()) {
+		/* the BAU only knows about single pages */
+		if (end - start != PAGE_SIZE)
+			start = TLB_FLUSH_ALL;
+		if (uv_flush_tlb_others(&cpumask, mm, start))
+			return;
+	}
 
 	/* Caller has disabled preemption */
 	sender = smp_processor_id() % NUM_INVALIDATE_TLB_VECTORS;
@@ -179,7 +234,8 @@ void native_flush_tlb_others(const cpumask_t *cpumaskp, struct mm_struct *mm,
 	spin_lock(&f->tlbstate_lock);
 
 	f->flush_mm = mm;
-	f->flush_va = va;
+	f->flush_start = start;
+	f->flush_end = end;
 	cpus_or(f->flush_cpumask, cpumask, f->flush_cpumask);
 
 	/*
@@ -197,10 +253,30 @@ void native_flush_tlb_others(const cpumask_t *cpumaskp, struct mm_struct *mm,
 		cpu_relax();
 
 	f->flush_mm = NULL;
-	f->flush_va = 0;
+	f->flush_start = 0;
+	f->flush_end = 0;
 	spin_unlock(&f->tlbstate_lock);
 }
 
+void native_flush_tlb_others(const cpumask_t *cpumaskp, struct mm_struct *mm,
+			     unsigned long va)
+{
+	native_flush_tlb_others_range(cpumaskp, mm, va, va + PAGE_SIZE);
+}
+
+static void flush_tlb_others_range(cpumask_t cpumask, struct mm_struct *mm,
+				   unsigned long start, unsigned long end)
+{
+#ifdef CONFIG_PARAVIRT
+	/* the hypervisor interface only knows about single pages */
+	if (end - start != PAGE_SIZE)
+		start = TLB_FLUSH_ALL;
+	flush_tlb_others(cpumask, mm, start);
+#else
+	native_flush_tlb_others_range(&cpumask, mm, start, end);
+#endif
+}
+
 static int __cpuinit init_smp_flush(void)
 {
 	int i;
@@ -249,26 +325,80 @@ void flush_tlb_mm(struct mm_struct *mm)
 
 void flush_tlb_page(struct vm_area_struct *vma, unsigned long va)
 {
-	struct mm_struct *mm = vma->vm_mm;
+	flush_tlb_mm_range(vma->vm_mm, va, va + PAGE_SIZE, 0);
+}
+
+/**
+ * flush_tlb_mm_range - flush a range of user addresses on all cpus
+ * @mm: address space
+ * @start: first address
+ * @end: end of the range, TLB_FLUSH_ALL to flush everything
+ * @freed_tables: page tables of the range were freed
+ *
+ * Ranges of up to tlb_single_page_flush_ceiling pages are flushed page by
+ * page, larger ones flush the whole TLB.  Cpus in lazy tlb mode are only
+ * interrupted when page tables were freed.
+ */
+void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
+			unsigned long end, int freed_tables)
+{
 	cpumask_t cpu_mask;
 
+	if (end == TLB_FLUSH_ALL || freed_tables || start >= end ||
+	    (end - start) >> PAGE_SHIFT > tlb_single_page_flush_ceiling) {
+		start = TLB_FLUSH_ALL;
+		end = TLB_FLUSH_ALL;
+	}
+
 	preempt_disable();
 	cpu_mask = mm->cpu_vm_mask;
 	cpu_clear(smp_processor_id(), cpu_mask);
 
 	if (current->active_mm == mm) {
 		if (current->mm)
-			__flush_tlb_one(va);
+			local_flush_tlb_range(start, end);
 		else
 			leave_mm(smp_processor_id());
 	}
 
+	if (!freed_tables)
+		flush_tlb_skip_lazy(&cpu_mask);
 	if (!cpus_empty(cpu_mask))
-		flush_tlb_others(cpu_mask, mm, va);
+		flush_tlb_others_range(cpu_mask, mm, start, end);
 
 	preempt_enable();
 }
 
+/**
+ * flush_tlb_batched - flush the TLBs of a set of cpus
+ * @cpumask: cpus to flush, cleared when done
+ *
+ * Used by reclaim to flush once for the mappings of many pages, of any
+ * number of mms, that it unmapped without flushing.
+ */
+void flush_tlb_batched(cpumask_t *cpumask)
+{
+	int cpu = get_cpu();
+
+	/*
+	 * The mask was gathered before reclaim slept; cpus that went
+	 * offline since then must not be sent an IPI.  Preemption is
+	 * off, so none can go away under us from here on.
+	 */
+	cpus_and(*cpumask, *cpumask, cpu_online_map);
+	if (cpu_isset(cpu, *cpumask)) {
+		cpu_clear(cpu, *cpumask);
+		local_flush_tlb();
+	}
+	flush_tlb_skip_lazy(cpumask);
+	if (!cpus_empty(*cpumask))
+		flush_tlb_others_range(*cpumask, NULL,
+				       TLB_FLUSH_ALL, TLB_FLUSH_ALL);
+	cpus_clear(*cpumask);
+
+	put_cpu();
+}
+
 static void do_flush_tlb_all(void *info)
 {
 	unsigned long cpu = smp_processor_id();
@@ -2078,7 +2078,7 @@ mmio:
 	 */
 	mutex_lock(&vcpu->kvm->lock);
 	mmio_dev = vcpu_find_mmio_dev(vcpu, gpa, bytes, 1);
-	if (mmio_dev) {
+	if (mmio_dev && kvm_iodevice_accepts_write(mmio_dev, gpa, bytes, val)) {
 		kvm_iodevice_write(mmio_dev, gpa, bytes, val);
 		mutex_unlock(&vcpu->kvm->lock);
 		return X86EMUL_CONTINUE;
@@ -2483,6 +2483,10 @@ int kvm_emulate_pio(struct kvm_vcpu *vcpu, struct kvm_run *run, int in,
 	memcpy(vcpu->arch.pio_data, &val, 4);
 
 	pio_dev = vcpu_find_pio_dev(vcpu, port, size, !in);
+	if (pio_dev && !in &&
+	    !kvm_iodevice_accepts_write(pio_dev, port, size,
+					vcpu->arch.pio_data))
+		pio_dev = NULL;
 	if (pio_dev) {
 		kernel_pio(pio_dev, vcpu, vcpu->arch.pio_data);
 		complete_pio(vcpu);
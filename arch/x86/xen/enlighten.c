@@ -652,7 +652,6 @@ static void xen_flush_tlb_others(const cpumask_t *cpus, struct mm_struct *mm,
 	 */
 	BUG_ON(cpus_empty(cpumask));
 	BUG_ON(cpu_isset(smp_processor_id(), cpumask));
-	BUG_ON(!mm);
 
 	/* If a CPU which we ran on has gone down, OK. */
 	cpus_and(cpumask, cpumask, cpu_online_map);
@@ -65,4 +65,8 @@
 
 #define SO_MARK			36
 
+#define SO_BUSY_POLL		46
+
+#define SO_ZEROCOPY		60
+
 #endif	/* _XTENSA_SOCKET_H */
@@ -87,18 +87,34 @@ struct tap_filter {
 	unsigned char	addr[FLT_EXACT_COUNT][ETH_ALEN];
 };
 
+/* Maximum number of queues (file descriptors) a multiqueue device can
+ * have attached.  Each queue maps onto one netdev TX queue. */
+#define TUN_MAX_QUEUES	16
+
+/* Per file descriptor state.  A single queue device has at most one of
+ * these attached, a multiqueue device up to TUN_MAX_QUEUES. */
+struct tun_file {
+	struct tun_struct	*tun;
+	u16			queue_index;
+
+	wait_queue_head_t	read_wait;
+	struct sk_buff_head	readq;
+
+	struct fasync_struct	*fasync;
+};
+
 struct tun_struct {
 	struct list_head        list;
 	unsigned int 		flags;
-	int			attached;
+	unsigned int		numqueues;
 	uid_t			owner;
 	gid_t			group;
 
-	wait_queue_head_t	read_wait;
-	struct sk_buff_head	readq;
+	/* Attached queues, indexed by TX queue.  Written under RTNL,
+	 * read under RCU from the transmit path. */
+	struct tun_file		*tfiles[TUN_MAX_QUEUES];
 
 	struct net_device	*dev;
-	struct fasync_struct	*fasync;
 
 	struct tap_filter       txflt;
 
@@ -220,17 +236,70 @@ struct tun_net {
 
 static const struct ethtool_ops tun_ethtool_ops;
 
+/* Attach a file to the device as its next queue. Caller holds RTNL. */
+static int tun_attach(struct tun_struct *tun, struct tun_file *tfile)
+{
+	unsigned int max = (tun->flags & TUN_TAP_MQ) ? TUN_MAX_QUEUES : 1;
+
+	ASSERT_RTNL();
+
+	if (tun->numqueues >= max)
+		return -EBUSY;
+
+	tfile->tun = tun;
+	tfile->queue_index = tun->numqueues;
+	rcu_assign_pointer(tun->tfiles[tun->numqueues], tfile);
+	tun->numqueues++;
+
+	/* Let dev_pick_tx hash flows over the attached queues only. */
+	tun->dev->real_num_tx_queues = tun->numqueues;
+
+	get_net(dev_net(tun->dev));
+	return 0;
+}
+
+/* Detach a file from its device.  The last queue is moved into the hole
+ * so that the attached queues stay contiguous.  Caller holds RTNL. */
+static void tun_detach(struct tun_file *tfile)
+{
+	struct tun_struct *tun = tfile->tun;
+	struct tun_file *last;
+	u16 index = tfile->queue_index;
+
+	ASSERT_RTNL();
+
+	last = tun->tfiles[--tun->numqueues];
+	last->queue_index = index;
+	rcu_assign_pointer(tun->tfiles[index], last);
+	rcu_assign_pointer(tun->tfiles[tun->numqueues], NULL);
+	tun->dev->real_num_tx_queues = tun->numqueues ? : 1;
+
+	/* Make sure tun_net_xmit no longer sees this queue */
+	synchronize_net();
+
+	/* The moved queue is only ever woken through its new index, which
+	 * may have been left stopped by the file that just went away. */
+	if (index != tun->numqueues && netif_running(tun->dev))
+		netif_tx_wake_queue(netdev_get_tx_queue(tun->dev, index));
+
+	tfile->tun = NULL;
+	put_net(dev_net(tun->dev));
+
+	/* Drop read queue */
+	skb_queue_purge(&tfile->readq);
+}
+
 /* Net device open. */
 static int tun_net_open(struct net_device *dev)
 {
-	netif_start_queue(dev);
+	netif_tx_start_all_queues(dev);
 	return 0;
 }
 
 /* Net device close. */
 static int tun_net_close(struct net_device *dev)
 {
-	netif_stop_queue(dev);
+	netif_tx_stop_all_queues(dev);
 	return 0;
 }
 
@@ -238,11 +307,16 @@ static int tun_net_close(struct net_device *dev)
 static int tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct tun_struct *tun = netdev_priv(dev);
+	u16 txq = skb_get_queue_mapping(skb);
+	struct tun_file *tfile;
 
 	DBG(KERN_INFO "%s: tun_net_xmit %d\n", tun->dev->name, skb->len);
 
+	rcu_read_lock();
+	tfile = rcu_dereference(tun->tfiles[txq]);
+
 	/* Drop packet if interface is not attached */
-	if (!tun->attached)
+	if (!tfile)
 		goto drop;
 
 	/* Drop if the filter does not like it.
@@ -251,11 +325,11 @@ static int tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 	if (!check_filter(&tun->txflt, skb))
 		goto drop;
 
-	if (skb_queue_len(&tun->readq) >= dev->tx_queue_len) {
+	if (skb_queue_len(&tfile->readq) >= dev->tx_queue_len) {
 		if (!(tun->flags & TUN_ONE_QUEUE)) {
 			/* Normal queueing mode. */
 			/* Packet scheduler handles dropping of further packets. */
-			netif_stop_queue(dev);
+			netif_tx_stop_queue(netdev_get_tx_queue(dev, txq));
 
 			/* We won't see all dropped packets individually, so overrun
 			 * error is more appropriate. */
@@ -268,16 +342,18 @@ static int tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	/* Enqueue packet */
-	skb_queue_tail(&tun->readq, skb);
+	skb_queue_tail(&tfile->readq, skb);
 	dev->trans_start = jiffies;
 
 	/* Notify and wake up reader process */
 	if (tun->flags & TUN_FASYNC)
-		kill_fasync(&tun->fasync, SIGIO, POLL_IN);
-	wake_up_interruptible(&tun->read_wait);
+		kill_fasync(&tfile->fasync, SIGIO, POLL_IN);
+	wake_up_interruptible(&tfile->read_wait);
+	rcu_read_unlock();
 	return 0;
 
 drop:
+	rcu_read_unlock();
 	dev->stats.tx_dropped++;
 	kfree_skb(skb);
 	return 0;
@@ -359,7 +435,8 @@ static void tun_net_init(struct net_device *dev)
 /* Poll */
 static unsigned int tun_chr_poll(struct file *file, poll_table * wait)
 {
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 	unsigned int mask = POLLOUT | POLLWRNORM;
 
 	if (!tun)
@@ -367,9 +444,9 @@ static unsigned int tun_chr_poll(struct file *file, poll_table * wait)
 
 	DBG(KERN_INFO "%s: tun_chr_poll\n", tun->dev->name);
 
-	poll_wait(file, &tun->read_wait, wait);
+	poll_wait(file, &tfile->read_wait, wait);
 
-	if (!skb_queue_empty(&tun->readq))
+	if (!skb_queue_empty(&tfile->readq))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
@@ -556,7 +633,8 @@ static __inline__ ssize_t tun_get_user(struct tun_struct *tun, struct iovec *iv,
 static ssize_t tun_chr_aio_write(struct kiocb *iocb, const struct iovec *iv,
 			      unsigned long count, loff_t pos)
 {
-	struct tun_struct *tun = iocb->ki_filp->private_data;
+	struct tun_file *tfile = iocb->ki_filp->private_data;
+	struct tun_struct *tun = tfile->tun;
 
 	if (!tun)
 		return -EBADFD;
@@ -636,7 +714,8 @@ static ssize_t tun_chr_aio_read(struct kiocb *iocb, const struct iovec *iv,
 			    unsigned long count, loff_t pos)
 {
 	struct file *file = iocb->ki_filp;
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 	DECLARE_WAITQUEUE(wait, current);
 	struct sk_buff *skb;
 	ssize_t len, ret = 0;
@@ -650,12 +729,12 @@ static ssize_t tun_chr_aio_read(struct kiocb *iocb, const struct iovec *iv,
 	if (len < 0)
 		return -EINVAL;
 
-	add_wait_queue(&tun->read_wait, &wait);
+	add_wait_queue(&tfile->read_wait, &wait);
 	while (len) {
 		current->state = TASK_INTERRUPTIBLE;
 
 		/* Read frames from the queue */
-		if (!(skb=skb_dequeue(&tun->readq))) {
+		if (!(skb=skb_dequeue(&tfile->readq))) {
 			if (file->f_flags & O_NONBLOCK) {
 				ret = -EAGAIN;
 				break;
@@ -669,7 +748,8 @@ static ssize_t tun_chr_aio_read(struct kiocb *iocb, const struct iovec *iv,
 			schedule();
 			continue;
 		}
-		netif_wake_queue(tun->dev);
+		netif_tx_wake_queue(netdev_get_tx_queue(tun->dev,
+							tfile->queue_index));
 
 		ret = tun_put_user(tun, skb, (struct iovec *) iv, len);
 		kfree_skb(skb);
@@ -677,7 +757,7 @@ static ssize_t tun_chr_aio_read(struct kiocb *iocb, const struct iovec *iv,
 	}
 
 	current->state = TASK_RUNNING;
-	remove_wait_queue(&tun->read_wait, &wait);
+	remove_wait_queue(&tfile->read_wait, &wait);
 
 	return ret;
 }
@@ -686,9 +766,6 @@ static void tun_setup(struct net_device *dev)
 {
 	struct tun_struct *tun = netdev_priv(dev);
 
-	skb_queue_head_init(&tun->readq);
-	init_waitqueue_head(&tun->read_wait);
-
 	tun->owner = -1;
 	tun->group = -1;
 
@@ -710,20 +787,53 @@ static struct tun_struct *tun_get_by_name(struct tun_net *tn, const char *name)
 	return NULL;
 }
 
+/* Translate TUNSETIFF flags into the per device flags they control */
+static unsigned int tun_iff_flags(struct ifreq *ifr)
+{
+	unsigned int flags = 0;
+
+	if (ifr->ifr_flags & IFF_NO_PI)
+		flags |= TUN_NO_PI;
+	if (ifr->ifr_flags & IFF_ONE_QUEUE)
+		flags |= TUN_ONE_QUEUE;
+	if (ifr->ifr_flags & IFF_VNET_HDR)
+		flags |= TUN_VNET_HDR;
+
+	return flags;
+}
+
+#define TUN_IFF_MASK	(TUN_NO_PI | TUN_ONE_QUEUE | TUN_VNET_HDR)
+
 static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 {
+	struct tun_file *tfile = file->private_data;
 	struct tun_net *tn;
 	struct tun_struct *tun;
 	struct net_device *dev;
 	const struct cred *cred = current_cred();
 	int err;
 
+	/* tun_chr_ioctl() checked this without RTNL; another TUNSETIFF on
+	 * the same file may have attached it since. */
+	if (tfile->tun)
+		return -EINVAL;
+
 	tn = net_generic(net, tun_net_id);
 	tun = tun_get_by_name(tn, ifr->ifr_name);
 	if (tun) {
-		if (tun->attached)
+		/* Queue mode is fixed when the device is created */
+		if (!(ifr->ifr_flags & IFF_MULTI_QUEUE) !=
+		    !(tun->flags & TUN_TAP_MQ))
+			return -EINVAL;
+
+		if (tun->numqueues && !(tun->flags & TUN_TAP_MQ))
 			return -EBUSY;
 
+		/* All queues of a device must agree on the frame format */
+		if (tun->numqueues &&
+		    tun_iff_flags(ifr) != (tun->flags & TUN_IFF_MASK))
+			return -EINVAL;
+
 		/* Check permissions */
 		if (((tun->owner != -1 &&
 		      cred->euid != tun->owner) ||
@@ -756,14 +866,20 @@ static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 		} else
 			goto failed;
 
+		if (ifr->ifr_flags & IFF_MULTI_QUEUE)
+			flags |= TUN_TAP_MQ;
+
 		if (*ifr->ifr_name)
 			name = ifr->ifr_name;
 
-		dev = alloc_netdev(sizeof(struct tun_struct), name,
-				   tun_setup);
+		dev = alloc_netdev_mq(sizeof(struct tun_struct), name, tun_setup,
+				      (flags & TUN_TAP_MQ) ? TUN_MAX_QUEUES : 1);
 		if (!dev)
 			return -ENOMEM;
 
+		/* Grows as queues are attached */
+		dev->real_num_tx_queues = 1;
+
 		dev_net_set(dev, net);
 
 		tun = netdev_priv(dev);
@@ -788,30 +904,17 @@ static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 
 	DBG(KERN_INFO "%s: tun_set_iff\n", tun->dev->name);
 
-	if (ifr->ifr_flags & IFF_NO_PI)
-		tun->flags |= TUN_NO_PI;
-	else
-		tun->flags &= ~TUN_NO_PI;
-
-	if (ifr->ifr_flags & IFF_ONE_QUEUE)
-		tun->flags |= TUN_ONE_QUEUE;
-	else
-		tun->flags &= ~TUN_ONE_QUEUE;
+	err = tun_attach(tun, tfile);
+	if (err < 0)
+		return err;
 
-	if (ifr->ifr_flags & IFF_VNET_HDR)
-		tun->flags |= TUN_VNET_HDR;
-	else
-		tun->flags &= ~TUN_VNET_HDR;
-
-	file->private_data = tun;
-	tun->attached = 1;
-	get_net(dev_net(tun->dev));
+	tun->flags = (tun->flags & ~TUN_IFF_MASK) | tun_iff_flags(ifr);
 
 	/* Make sure persistent devices do not get stuck in
 	 * xoff state.
 	 */
 	if (netif_running(tun->dev))
-		netif_wake_queue(tun->dev);
+		netif_tx_wake_all_queues(tun->dev);
 
 	strcpy(ifr->ifr_name, tun->dev->name);
 	return 0;
@@ -824,7 +927,8 @@ static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 
 static int tun_get_iff(struct net *net, struct file *file, struct ifreq *ifr)
 {
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 
 	if (!tun)
 		return -EBADFD;
@@ -849,6 +953,9 @@ static int tun_get_iff(struct net *net, struct file *file, struct ifreq *ifr)
 	if (tun->flags & TUN_VNET_HDR)
 		ifr->ifr_flags |= IFF_VNET_HDR;
 
+	if (tun->flags & TUN_TAP_MQ)
+		ifr->ifr_flags |= IFF_MULTI_QUEUE;
+
 	return 0;
 }
 
@@ -895,7 +1002,8 @@ static int set_offload(struct net_device *dev, unsigned long arg)
 static int tun_chr_ioctl(struct inode *inode, struct file *file,
 			 unsigned int cmd, unsigned long arg)
 {
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 	void __user* argp = (void __user*)arg;
 	struct ifreq ifr;
 	int ret;
@@ -926,7 +1034,7 @@ static int tun_chr_ioctl(struct inode *inode, struct file *file,
 		 * This is needed because we never checked for invalid flags on
 		 * TUNSETIFF. */
 		return put_user(IFF_TUN | IFF_TAP | IFF_NO_PI | IFF_ONE_QUEUE |
-				IFF_VNET_HDR,
+				IFF_VNET_HDR | IFF_MULTI_QUEUE,
 				(unsigned int __user*)argp);
 	}
 
@@ -1043,7 +1151,8 @@ static int tun_chr_ioctl(struct inode *inode, struct file *file,
 
 static int tun_chr_fasync(int fd, struct file *file, int on)
 {
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 	int ret;
 
 	if (!tun)
@@ -1052,7 +1161,7 @@ static int tun_chr_fasync(int fd, struct file *file, int on)
 	DBG(KERN_INFO "%s: tun_chr_fasync %d\n", tun->dev->name, on);
 
 	lock_kernel();
-	if ((ret = fasync_helper(fd, file, on, &tun->fasync)) < 0)
+	if ((ret = fasync_helper(fd, file, on, &tfile->fasync)) < 0)
 		goto out;
 
 	if (on) {
@@ -1070,38 +1179,44 @@ out:
 
 static int tun_chr_open(struct inode *inode, struct file * file)
 {
+	struct tun_file *tfile;
+
 	cycle_kernel_lock();
 	DBG1(KERN_INFO "tunX: tun_chr_open\n");
-	file->private_data = NULL;
+
+	tfile = kzalloc(sizeof(*tfile), GFP_KERNEL);
+	if (!tfile)
+		return -ENOMEM;
+
+	skb_queue_head_init(&tfile->readq);
+	init_waitqueue_head(&tfile->read_wait);
+
+	file->private_data = tfile;
 	return 0;
 }
 
 static int tun_chr_close(struct inode *inode, struct file *file)
 {
-	struct tun_struct *tun = file->private_data;
+	struct tun_file *tfile = file->private_data;
+	struct tun_struct *tun = tfile->tun;
 
-	if (!tun)
-		return 0;
+	if (tun) {
+		DBG(KERN_INFO "%s: tun_chr_close\n", tun->dev->name);
 
-	DBG(KERN_INFO "%s: tun_chr_close\n", tun->dev->name);
+		rtnl_lock();
 
-	rtnl_lock();
+		/* Detach from net device */
+		tun_detach(tfile);
 
-	/* Detach from net device */
-	file->private_data = NULL;
-	tun->attached = 0;
-	put_net(dev_net(tun->dev));
-
-	/* Drop read queue */
-	skb_queue_purge(&tun->readq);
+		if (!tun->numqueues && !(tun->flags & TUN_PERSIST)) {
+			list_del(&tun->list);
+			unregister_netdevice(tun->dev);
+		}
 
-	if (!(tun->flags & TUN_PERSIST)) {
-		list_del(&tun->list);
-		unregister_netdevice(tun->dev);
+		rtnl_unlock();
 	}
 
-	rtnl_unlock();
-
+	kfree(tfile);
 	return 0;
 }
 
@@ -1119,6 +1234,13 @@ static const struct file_operations tun_fops = {
 	.fasync = tun_chr_fasync
 };
 
+/* Used by vhost-net to check that its backend really is a tun/tap file. */
+int tun_is_tun_file(struct file *file)
+{
+	return file->f_op == &tun_fops;
+}
+EXPORT_SYMBOL_GPL(tun_is_tun_file);
+
 static struct miscdevice tun_miscdev = {
 	.minor = TUN_MINOR,
 	.name = "tun",
@@ -1181,7 +1303,7 @@ static void tun_set_msglevel(struct net_device *dev, u32 value)
 static u32 tun_get_link(struct net_device *dev)
 {
 	struct tun_struct *tun = netdev_priv(dev);
-	return tun->attached;
+	return tun->numqueues != 0;
 }
 
 static u32 tun_get_rx_csum(struct net_device *dev)
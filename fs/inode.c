@@ -233,6 +233,7 @@ void inode_init_once(struct inode *inode)
 	spin_lock_init(&inode->i_data.tree_lock);
 	spin_lock_init(&inode->i_data.i_mmap_lock);
 	INIT_LIST_HEAD(&inode->i_data.private_list);
+	INIT_LIST_HEAD(&inode->i_data.shadow_list);
 	spin_lock_init(&inode->i_data.private_lock);
 	INIT_RAW_PRIO_TREE_ROOT(&inode->i_data.i_mmap);
 	INIT_LIST_HEAD(&inode->i_data.i_mmap_nonlinear);
@@ -279,7 +280,14 @@ void clear_inode(struct inode *inode)
 {
 	might_sleep();
 	invalidate_inode_buffers(inode);
-       
+	/*
+	 * Callers only truncate the mapping while it still has pages:
+	 * drop the shadow entries of evicted pages that may be left.
+	 * This takes the tree_lock even when there are none, to wait
+	 * for the shadow shrinker to let go of the mapping.
+	 */
+	clear_shadow_entries(&inode->i_data, 0, ~0UL);
+
 	BUG_ON(inode->i_data.nrpages);
 	BUG_ON(!(inode->i_state & I_FREEING));
 	BUG_ON(inode->i_state & I_CLEAR);
@@ -449,15 +449,12 @@ static const struct file_operations proc_lstats_operations = {
 #endif
 
 /* The badness from the OOM killer */
-unsigned long badness(struct task_struct *p, unsigned long uptime);
 static int proc_oom_score(struct task_struct *task, char *buffer)
 {
 	unsigned long points;
-	struct timespec uptime;
 
-	do_posix_clock_monotonic_gettime(&uptime);
 	read_lock(&tasklist_lock);
-	points = badness(task, uptime.tv_sec);
+	points = badness(task, oom_total_pages(NULL));
 	read_unlock(&tasklist_lock);
 	return sprintf(buffer, "%lu\n", points);
 }
@@ -1054,6 +1051,15 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 		return -EACCES;
 	}
 	task->oomkilladj = oom_adjust;
+	/*
+	 * oom_adj is a legacy interface: scale it to oom_score_adj, which
+	 * is what the OOM killer uses.
+	 */
+	if (oom_adjust == OOM_DISABLE)
+		task->oom_score_adj = OOM_SCORE_ADJ_MIN;
+	else
+		task->oom_score_adj = oom_adjust * OOM_SCORE_ADJ_MAX /
+				      -OOM_DISABLE;
 	put_task_struct(task);
 	if (end - buffer == 0)
 		return -EIO;
@@ -1065,6 +1071,69 @@ static const struct file_operations proc_oom_adjust_operations = {
 	.write		= oom_adjust_write,
 };
 
+static ssize_t oom_score_adj_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct task_struct *task = get_proc_task(file->f_path.dentry->d_inode);
+	char buffer[PROC_NUMBUF];
+	size_t len;
+	int oom_score_adj;
+
+	if (!task)
+		return -ESRCH;
+	oom_score_adj = task->oom_score_adj;
+	put_task_struct(task);
+
+	len = snprintf(buffer, sizeof(buffer), "%d\n", oom_score_adj);
+
+	return simple_read_from_buffer(buf, count, ppos, buffer, len);
+}
+
+static ssize_t oom_score_adj_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[PROC_NUMBUF], *end;
+	int oom_score_adj;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+	oom_score_adj = simple_strtol(buffer, &end, 0);
+	if (oom_score_adj < OOM_SCORE_ADJ_MIN ||
+	    oom_score_adj > OOM_SCORE_ADJ_MAX)
+		return -EINVAL;
+	if (*end == '\n')
+		end++;
+	task = get_proc_task(file->f_path.dentry->d_inode);
+	if (!task)
+		return -ESRCH;
+	if (oom_score_adj < task->oom_score_adj &&
+	    !capable(CAP_SYS_RESOURCE)) {
+		put_task_struct(task);
+		return -EACCES;
+	}
+	task->oom_score_adj = oom_score_adj;
+	/* Keep the legacy oom_adj roughly in line */
+	if (oom_score_adj == OOM_SCORE_ADJ_MIN)
+		task->oomkilladj = OOM_DISABLE;
+	else
+		task->oomkilladj = clamp(oom_score_adj * -OOM_DISABLE /
+					 OOM_SCORE_ADJ_MAX,
+					 OOM_ADJUST_MIN, OOM_ADJUST_MAX);
+	put_task_struct(task);
+	if (end - buffer == 0)
+		return -EIO;
+	return end - buffer;
+}
+
+static const struct file_operations proc_oom_score_adj_operations = {
+	.read		= oom_score_adj_read,
+	.write		= oom_score_adj_write,
+};
+
 #ifdef CONFIG_AUDITSYSCALL
 #define TMPBUFLEN 21
 static ssize_t proc_loginuid_read(struct file * file, char __user * buf,
@@ -2543,6 +2612,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 #endif
 	INF("oom_score",  S_IRUGO, proc_oom_score),
 	REG("oom_adj",    S_IRUGO|S_IWUSR, proc_oom_adjust_operations),
+	REG("oom_score_adj", S_IRUGO|S_IWUSR, proc_oom_score_adj_operations),
 #ifdef CONFIG_AUDITSYSCALL
 	REG("loginuid",   S_IWUSR|S_IRUGO, proc_loginuid_operations),
 	REG("sessionid",  S_IRUGO, proc_sessionid_operations),
@@ -2881,6 +2951,7 @@ static const struct pid_entry tid_base_stuff[] = {
 #endif
 	INF("oom_score", S_IRUGO, proc_oom_score),
 	REG("oom_adj",   S_IRUGO|S_IWUSR, proc_oom_adjust_operations),
+	REG("oom_score_adj", S_IRUGO|S_IWUSR, proc_oom_score_adj_operations),
 #ifdef CONFIG_AUDITSYSCALL
 	REG("loginuid",  S_IWUSR|S_IRUGO, proc_loginuid_operations),
 	REG("sessionid",  S_IRUSR, proc_sessionid_operations),
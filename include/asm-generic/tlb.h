@@ -41,12 +41,22 @@ struct mmu_gather {
 	unsigned int		nr;	/* set to ~0U means fast mode */
 	unsigned int		need_flush;/* Really unmapped some ptes? */
 	unsigned int		fullmm; /* non-zero means full mm flush */
+	unsigned int		freed_tables; /* page tables were freed */
+	unsigned long		start;	/* range of unmapped ptes, */
+	unsigned long		end;	/* for archs that flush ranges */
 	struct page *		pages[FREE_PTE_NR];
 };
 
 /* Users of the generic TLB shootdown code must declare this storage space. */
 DECLARE_PER_CPU(struct mmu_gather, mmu_gathers);
 
+static inline void __tlb_reset_range(struct mmu_gather *tlb)
+{
+	tlb->start = ~0UL;
+	tlb->end = 0;
+	tlb->freed_tables = 0;
+}
+
 /* tlb_gather_mmu
  *	Return a pointer to an initialized struct mmu_gather.
  */
@@ -61,6 +71,7 @@ tlb_gather_mmu(struct mm_struct *mm, unsigned int full_mm_flush)
 	tlb->nr = num_online_cpus() > 1 ? 0U : ~0U;
 
 	tlb->fullmm = full_mm_flush;
+	__tlb_reset_range(tlb);
 
 	return tlb;
 }
@@ -72,6 +83,7 @@ tlb_flush_mmu(struct mmu_gather *tlb, unsigned long start, unsigned long end)
 		return;
 	tlb->need_flush = 0;
 	tlb_flush(tlb);
+	__tlb_reset_range(tlb);
 	if (!tlb_fast_mode(tlb)) {
 		free_pages_and_swap_cache(tlb->pages, tlb->nr);
 		tlb->nr = 0;
@@ -115,17 +127,24 @@ static inline void tlb_remove_page(struct mmu_gather *tlb, struct page *page)
  *
  * Record the fact that pte's were really umapped in ->need_flush, so we can
  * later optimise away the tlb invalidate.   This helps when userspace is
- * unmapping already-unmapped pages, which happens quite a lot.
+ * unmapping already-unmapped pages, which happens quite a lot.  The range
+ * of the unmapped ptes is kept in ->start and ->end, so that a small
+ * munmap() does not have to flush the whole TLB.
  */
 #define tlb_remove_tlb_entry(tlb, ptep, address)		\
 	do {							\
 		tlb->need_flush = 1;				\
+		if (address < tlb->start)			\
+			tlb->start = address;			\
+		if (address + PAGE_SIZE > tlb->end)		\
+			tlb->end = address + PAGE_SIZE;		\
 		__tlb_remove_tlb_entry(tlb, ptep, address);	\
 	} while (0)
 
 #define pte_free_tlb(tlb, ptep)					\
 	do {							\
 		tlb->need_flush = 1;				\
+		tlb->freed_tables = 1;				\
 		__pte_free_tlb(tlb, ptep);			\
 	} while (0)
 
@@ -133,6 +152,7 @@ static inline void tlb_remove_page(struct mmu_gather *tlb, struct page *page)
 #define pud_free_tlb(tlb, pudp)					\
 	do {							\
 		tlb->need_flush = 1;				\
+		tlb->freed_tables = 1;				\
 		__pud_free_tlb(tlb, pudp);			\
 	} while (0)
 #endif
@@ -140,6 +160,7 @@ static inline void tlb_remove_page(struct mmu_gather *tlb, struct page *page)
 #define pmd_free_tlb(tlb, pmdp)					\
 	do {							\
 		tlb->need_flush = 1;				\
+		tlb->freed_tables = 1;				\
 		__pmd_free_tlb(tlb, pmdp);			\
 	} while (0)
 
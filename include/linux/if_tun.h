@@ -33,6 +33,7 @@
 #define TUN_ONE_QUEUE	0x0080
 #define TUN_PERSIST 	0x0100	
 #define TUN_VNET_HDR 	0x0200
+#define TUN_TAP_MQ	0x0400
 
 /* Ioctl defines */
 #define TUNSETNOCSUM  _IOW('T', 200, int) 
@@ -50,6 +51,7 @@
 /* TUNSETIFF ifr flags */
 #define IFF_TUN		0x0001
 #define IFF_TAP		0x0002
+#define IFF_MULTI_QUEUE	0x0100
 #define IFF_NO_PI	0x1000
 #define IFF_ONE_QUEUE	0x2000
 #define IFF_VNET_HDR	0x4000
@@ -82,4 +84,17 @@ struct tun_filter {
 	__u8   addr[0][ETH_ALEN];
 };
 
+#ifdef __KERNEL__
+struct file;
+
+#if defined(CONFIG_TUN) || defined(CONFIG_TUN_MODULE)
+extern int tun_is_tun_file(struct file *file);
+#else
+static inline int tun_is_tun_file(struct file *file)
+{
+	return 0;
+}
+#endif
+#endif /* __KERNEL__ */
+
 #endif /* __IF_TUN_H */
@@ -396,6 +396,10 @@ struct kvm_trace_rec {
 #if defined(CONFIG_X86)
 #define KVM_CAP_USER_NMI 22
 #endif
+#if defined(CONFIG_X86)
+#define KVM_CAP_IRQFD 32
+#define KVM_CAP_IOEVENTFD 36
+#endif
 
 /*
  * ioctls for VM fds
@@ -429,6 +433,8 @@ struct kvm_trace_rec {
 				   struct kvm_assigned_pci_dev)
 #define KVM_ASSIGN_IRQ _IOR(KVMIO, 0x70, \
 			    struct kvm_assigned_irq)
+#define KVM_IRQFD                 _IOW(KVMIO,  0x76, struct kvm_irqfd)
+#define KVM_IOEVENTFD             _IOW(KVMIO,  0x79, struct kvm_ioeventfd)
 
 /*
  * ioctls for vcpu fds
@@ -524,4 +530,28 @@ struct kvm_assigned_irq {
 
 #define KVM_DEV_IRQ_ASSIGN_ENABLE_MSI	(1 << 0)
 
+/* for KVM_IRQFD */
+#define KVM_IRQFD_FLAG_DEASSIGN (1 << 0)
+
+struct kvm_irqfd {
+	__u32 fd;
+	__u32 gsi;
+	__u32 flags;
+	__u8  pad[20];
+};
+
+/* for KVM_IOEVENTFD */
+#define KVM_IOEVENTFD_FLAG_DATAMATCH	(1 << 0)
+#define KVM_IOEVENTFD_FLAG_PIO		(1 << 1)
+#define KVM_IOEVENTFD_FLAG_DEASSIGN	(1 << 2)
+
+struct kvm_ioeventfd {
+	__u64 datamatch;
+	__u64 addr;        /* legal pio/mmio address */
+	__u32 len;         /* 1, 2, 4, or 8 bytes    */
+	__s32 fd;
+	__u32 flags;
+	__u8  pad[36];
+};
+
 #endif
@@ -126,6 +126,10 @@ struct kvm {
 	struct kvm_coalesced_mmio_dev *coalesced_mmio_dev;
 	struct kvm_coalesced_mmio_ring *coalesced_mmio_ring;
 #endif
+#ifdef KVM_CAP_IRQFD
+	struct list_head irqfds;	/* protected by lock */
+	struct list_head ioeventfds;	/* RCU, updates under lock */
+#endif
 
 #ifdef KVM_ARCH_WANT_MMU_NOTIFIER
 	struct mmu_notifier mmu_notifier;
@@ -328,6 +332,13 @@ void kvm_unregister_irq_ack_notifier(struct kvm_irq_ack_notifier *kian);
 int kvm_request_irq_source_id(struct kvm *kvm);
 void kvm_free_irq_source_id(struct kvm *kvm, int irq_source_id);
 
+#ifdef KVM_CAP_IRQFD
+int kvm_eventfd_init(struct kvm *kvm);
+void kvm_eventfd_release(struct kvm *kvm);
+int kvm_irqfd(struct kvm *kvm, int fd, u32 gsi, int flags);
+int kvm_ioeventfd(struct kvm *kvm, struct kvm_ioeventfd *args);
+#endif
+
 #ifdef CONFIG_IOMMU_API
 int kvm_iommu_map_pages(struct kvm *kvm, gfn_t base_gfn,
 			unsigned long npages);
@@ -20,6 +20,7 @@
 #ifndef _LINUX_MEMCONTROL_H
 #define _LINUX_MEMCONTROL_H
 #include <linux/cgroup.h>
+#include <linux/vm_event_item.h>
 struct mem_cgroup;
 struct page_cgroup;
 struct page;
@@ -104,6 +105,15 @@ struct zone_reclaim_stat *mem_cgroup_get_reclaim_stat(struct mem_cgroup *memcg,
 						      struct zone *zone);
 struct zone_reclaim_stat*
 mem_cgroup_get_reclaim_stat_from_page(struct page *page);
+void mem_cgroup_reclaim_statistics(struct mem_cgroup *mem,
+				   unsigned long scanned,
+				   unsigned long reclaimed);
+unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
+					    gfp_t gfp_mask);
+void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
+struct mem_cgroup *mem_cgroup_memstall_enter(u64 now);
+void mem_cgroup_memstall_leave(struct mem_cgroup *mem, u64 now);
+u64 mem_cgroup_get_limit(struct mem_cgroup *mem);
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 extern int do_swap_account;
@@ -270,6 +280,37 @@ mem_cgroup_get_reclaim_stat_from_page(struct page *page)
 	return NULL;
 }
 
+static inline void mem_cgroup_reclaim_statistics(struct mem_cgroup *mem,
+						 unsigned long scanned,
+						 unsigned long reclaimed)
+{
+}
+
+static inline unsigned long
+mem_cgroup_soft_limit_reclaim(struct zone *zone, int order, gfp_t gfp_mask)
+{
+	return 0;
+}
+
+static inline void
+mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
+{
+}
+
+static inline struct mem_cgroup *mem_cgroup_memstall_enter(u64 now)
+{
+	return NULL;
+}
+
+static inline void mem_cgroup_memstall_leave(struct mem_cgroup *mem, u64 now)
+{
+}
+
+static inline u64 mem_cgroup_get_limit(struct mem_cgroup *mem)
+{
+	return 0;
+}
+
 #endif /* CONFIG_CGROUP_MEM_CONT */
 
 #endif /* _LINUX_MEMCONTROL_H */
@@ -0,0 +1,40 @@
+#ifndef _LINUX_MEMSTALL_H
+#define _LINUX_MEMSTALL_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+
+struct mem_cgroup;
+
+/*
+ * Time during which at least one task of a group was stalled on memory:
+ * in direct reclaim or compaction, or waiting for a refaulting page of
+ * its working set to be read back in.
+ */
+struct memstall_group {
+	spinlock_t lock;
+	unsigned int nr_stalled;	/* tasks stalled right now */
+	u64 start;			/* ns, when nr_stalled became non-zero */
+	u64 total;			/* ns, completed stall time */
+	struct list_head triggers;	/* registered eventfds */
+};
+
+/* Cookie for one memstall_enter()/memstall_leave() section */
+struct memstall {
+	struct mem_cgroup *memcg;
+	int nested;
+};
+
+extern void memstall_enter(struct memstall *ms);
+extern void memstall_leave(struct memstall *ms);
+
+extern void memstall_group_init(struct memstall_group *grp);
+extern void memstall_group_cleanup(struct memstall_group *grp);
+extern void memstall_group_enter(struct memstall_group *grp, u64 now);
+extern void memstall_group_leave(struct memstall_group *grp, u64 now);
+extern u64 memstall_group_total(struct memstall_group *grp);
+extern int memstall_register_trigger(struct memstall_group *grp,
+				     const char *args);
+
+#endif /* _LINUX_MEMSTALL_H */
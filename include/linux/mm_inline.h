@@ -23,14 +23,121 @@ static inline int page_is_file_cache(struct page *page)
 	return LRU_FILE;
 }
 
+#ifdef CONFIG_LRU_GEN
+
+#define LRU_GEN_MASK	(((1UL << LRU_GEN_WIDTH) - 1) << PG_lru_gen)
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+static inline int page_lru_gen(struct page *page)
+{
+	return (page->flags & LRU_GEN_MASK) >> PG_lru_gen;
+}
+
+/*
+ * The page table walk promotes pages without holding the lru_lock, and
+ * other page flags are changed with atomic bitops, so the generation
+ * bits are updated with cmpxchg.
+ */
+static inline void set_page_lru_gen(struct page *page, int gen)
+{
+	unsigned long old, new;
+
+	BUILD_BUG_ON(MAX_NR_GENS > (1 << LRU_GEN_WIDTH));
+	do {
+		old = page->flags;
+		new = (old & ~LRU_GEN_MASK) |
+		      ((unsigned long)gen << PG_lru_gen);
+	} while (cmpxchg(&page->flags, old, new) != old);
+}
+
+/*
+ * Put @page on a generation list instead of the LRU list @l.  Pages
+ * going onto an active list have just been found referenced and join
+ * the youngest generation; others start out in the second oldest, so
+ * that they survive at least one round of eviction.
+ *
+ * Returns 0 if @page belongs on @l after all.
+ */
+static inline int lru_gen_add_page(struct zone *zone, struct page *page,
+				   enum lru_list l)
+{
+	struct lru_gen *lrugen = &zone->lrugen;
+	int file = is_file_lru(l);
+	unsigned long seq;
+	int gen;
+
+	if (!lru_gen_enabled() || is_unevictable_lru(l))
+		return 0;
+
+	if (is_active_lru(l))
+		seq = lrugen->max_seq[file];
+	else
+		seq = lrugen->min_seq[file] + 1;
+	gen = lru_gen_from_seq(seq);
+	set_page_lru_gen(page, gen);
+	list_add(&page->lru, &lrugen->lists[gen][file]);
+	return 1;
+}
+
+/*
+ * Move @page to the tail of the oldest generation, where reclaim looks
+ * next.  Returns 0 if the classic lists are in use.
+ */
+static inline int lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	struct lru_gen *lrugen = &zone->lrugen;
+	int file = !!page_is_file_cache(page);
+	int gen;
+
+	if (!lru_gen_enabled())
+		return 0;
+
+	gen = lru_gen_from_seq(lrugen->min_seq[file]);
+	set_page_lru_gen(page, gen);
+	list_move_tail(&page->lru, &lrugen->lists[gen][file]);
+	return 1;
+}
+
+#else /* !CONFIG_LRU_GEN */
+
+static inline int lru_gen_add_page(struct zone *zone, struct page *page,
+				   enum lru_list l)
+{
+	return 0;
+}
+
+static inline int lru_gen_rotate_page(struct zone *zone, struct page *page)
+{
+	return 0;
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static inline void
 add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
-	list_add(&page->lru, &zone->lru[l].list);
+	if (!lru_gen_add_page(zone, page, l))
+		list_add(&page->lru, &zone->lru[l].list);
 	__inc_zone_state(zone, NR_LRU_BASE + l);
 	mem_cgroup_add_lru_list(page, l);
 }
 
+/*
+ * Move @page from whatever list it is on to the LRU list @l, without
+ * updating any statistics.
+ */
+static inline void
+move_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
+{
+	list_del(&page->lru);
+	if (!lru_gen_add_page(zone, page, l))
+		list_add(&page->lru, &zone->lru[l].list);
+}
+
 static inline void
 del_page_from_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
@@ -187,6 +187,17 @@ struct core_state {
 	struct completion startup;
 };
 
+/*
+ * Reclaim clears ptes without flushing the TLB right away and flushes once
+ * for a batch of pages: the cpus that may still cache translations for
+ * them, and whether any of the ptes was dirty.
+ */
+struct tlbflush_unmap_batch {
+	cpumask_t cpumask;
+	int flush_required;
+	int writable;
+};
+
 struct mm_struct {
 	struct vm_area_struct * mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
@@ -274,6 +285,17 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_LRU_GEN
+	/* On lru_gen_mm_list, for the page table walks of mm/vmscan.c */
+	struct list_head lru_gen_list;
+#endif
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * Non-zero while reclaim has cleared ptes of this mm and not yet
+	 * flushed; bumped on every deferral, see flush_tlb_batched_pending().
+	 */
+	atomic_t tlb_flush_batched;
+#endif
 };
 
 #endif /* _LINUX_MM_TYPES_H */
@@ -107,6 +107,8 @@ enum zone_stat_item {
 	NR_VMSCAN_WRITE,
 	/* Second 128 byte cacheline */
 	NR_WRITEBACK_TEMP,	/* Writeback using temporary buffers */
+	WORKINGSET_REFAULT,	/* evicted page cache pages read back in */
+	WORKINGSET_ACTIVATE,	/* refaulting pages activated right away */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -166,11 +168,22 @@ static inline int is_unevictable_lru(enum lru_list l)
 #endif
 }
 
+/*
+ * Allocations up to PAGE_ALLOC_COSTLY_ORDER (kernel stacks, network buffers,
+ * slab pages) are common enough to be served from the per-cpu lists too,
+ * one list per order.
+ */
+#define PCP_MAX_ORDER	PAGE_ALLOC_COSTLY_ORDER
+#define NR_PCP_LISTS	(PCP_MAX_ORDER + 1)
+
 struct per_cpu_pages {
-	int count;		/* number of pages in the list */
+	int count;		/* number of pages in the lists */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
-	struct list_head list;	/* the list of pages */
+	int free_factor;	/* batch scaling while only freeing */
+
+	/* Lists of pages, one per order */
+	struct list_head lists[NR_PCP_LISTS];
 };
 
 struct per_cpu_pageset {
@@ -276,6 +289,47 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * With the multi-generational LRU, the evictable pages of a zone are not
+ * kept on active and inactive lists but sorted into generations by the
+ * time they were last seen referenced.  Anon and file pages age separately:
+ * each type has a window of sequence numbers from min_seq (oldest) to
+ * max_seq (youngest), and a page of generation seq sits on
+ * lists[seq % MAX_NR_GENS][type].  Reclaim evicts from min_seq; aging
+ * opens a new max_seq and promotes the pages found young in page tables.
+ *
+ * The generation also lives in page->flags, which may run ahead of the
+ * list a page is on: promotion only updates the flags, and the page is
+ * moved lazily when reclaim comes across it.
+ *
+ * MAX_NR_GENS must fit into LRU_GEN_WIDTH bits of page->flags.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+struct lru_gen {
+	/* The anon window is in [0], file in [1], as in zone_reclaim_stat */
+	unsigned long		max_seq[2];
+	unsigned long		min_seq[2];
+	struct list_head	lists[MAX_NR_GENS][2];
+	/* Pages moved to their generation's list by the reclaim scan */
+	unsigned long		nr_sorted;
+};
+
+extern int lru_gen_enable;
+
+static inline int lru_gen_enabled(void)
+{
+	return lru_gen_enable;
+}
+#else
+static inline int lru_gen_enabled(void)
+{
+	return 0;
+}
+#endif
+
 struct zone {
 	/* Fields commonly accessed by the page allocator */
 	unsigned long		pages_min, pages_low, pages_high;
@@ -318,6 +372,15 @@ struct zone {
 	unsigned long		*pageblock_flags;
 #endif /* CONFIG_SPARSEMEM */
 
+#ifdef CONFIG_COMPACTION
+	/*
+	 * On compaction failure, 1<<compact_defer_shift compactions
+	 * are skipped before trying again. The number attempted since
+	 * last failure is tracked with compact_considered.
+	 */
+	unsigned int		compact_considered;
+	unsigned int		compact_defer_shift;
+#endif
 
 	ZONE_PADDING(_pad1_)
 
@@ -329,6 +392,9 @@ struct zone {
 	} lru[NR_LRU_LISTS];
 
 	struct zone_reclaim_stat reclaim_stat;
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen		lrugen;
+#endif
 
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
@@ -357,6 +423,12 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+	/*
+	 * Counts evictions and activations from the inactive file list,
+	 * to measure the refault distance of evicted page cache pages.
+	 * See mm/workingset.c.
+	 */
+	atomic_long_t		inactive_age;
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
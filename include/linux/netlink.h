@@ -103,12 +103,47 @@ struct nlmsgerr
 #define NETLINK_ADD_MEMBERSHIP	1
 #define NETLINK_DROP_MEMBERSHIP	2
 #define NETLINK_PKTINFO		3
+#define NETLINK_RX_RING		4
+#define NETLINK_TX_RING		5
 
 struct nl_pktinfo
 {
 	__u32	group;
 };
 
+/* Memory mapped rings, see Documentation/networking/netlink_mmap.txt */
+struct nl_mmap_req
+{
+	unsigned int	nm_block_size;
+	unsigned int	nm_block_nr;
+	unsigned int	nm_frame_size;
+	unsigned int	nm_frame_nr;
+};
+
+struct nl_mmap_hdr
+{
+	unsigned int	nm_status;
+	unsigned int	nm_len;
+	__u32		nm_group;
+	/* credentials */
+	__u32		nm_pid;
+	__u32		nm_uid;
+	__u32		nm_gid;
+};
+
+enum nl_mmap_status {
+	NL_MMAP_STATUS_UNUSED,		/* owned by the kernel */
+	NL_MMAP_STATUS_RESERVED,	/* being filled by the kernel */
+	NL_MMAP_STATUS_VALID,		/* message in the frame */
+	NL_MMAP_STATUS_COPY,		/* message too large, use recvmsg() */
+	NL_MMAP_STATUS_SKIP,		/* ignore this frame */
+};
+
+#define NL_MMAP_MSG_ALIGNMENT		NLMSG_ALIGNTO
+#define NL_MMAP_MSG_ALIGN(sz)		(((sz) + NL_MMAP_MSG_ALIGNMENT - 1) & \
+					 ~(NL_MMAP_MSG_ALIGNMENT - 1))
+#define NL_MMAP_HDRLEN			NL_MMAP_MSG_ALIGN(sizeof(struct nl_mmap_hdr))
+
 #define NET_MAJOR 36		/* Major 36 is reserved for networking 						*/
 
 enum {
@@ -7,12 +7,22 @@
 #define OOM_ADJUST_MIN (-16)
 #define OOM_ADJUST_MAX 15
 
+/*
+ * /proc/<pid>/oom_score_adj is added to the badness of the task, which is
+ * the share of memory it uses in thousandths.  OOM_SCORE_ADJ_MIN protects
+ * from the oom-killer.
+ */
+#define OOM_SCORE_ADJ_MIN	(-1000)
+#define OOM_SCORE_ADJ_MAX	1000
+
 #ifdef __KERNEL__
 
 #include <linux/types.h>
 
 struct zonelist;
 struct notifier_block;
+struct task_struct;
+struct mem_cgroup;
 
 /*
  * Types of limitations to the nodes from which allocations may occur
@@ -23,6 +33,9 @@ enum oom_constraint {
 	CONSTRAINT_MEMORY_POLICY,
 };
 
+extern unsigned long badness(struct task_struct *p, unsigned long totalpages);
+extern unsigned long oom_total_pages(struct mem_cgroup *mem);
+
 extern int try_set_zone_oom(struct zonelist *zonelist, gfp_t gfp_flags);
 extern void clear_zonelist_oom(struct zonelist *zonelist, gfp_t gfp_flags);
 
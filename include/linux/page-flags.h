@@ -51,6 +51,10 @@
  * PG_buddy is set to indicate that the page is free and in the buddy system
  * (see mm/page_alloc.c).
  *
+ * PG_workingset is set on page cache pages that were evicted recently and
+ * read back in as part of the working set (see mm/workingset.c).  Waiting
+ * for such a page to be read counts as a memory stall.
+ *
  */
 
 /*
@@ -68,7 +72,14 @@
  * The fields area is reserved for fields mapping zone, node (for NUMA) and
  * SPARSEMEM section (for variants of SPARSEMEM that require section ids like
  * SPARSEMEM_EXTREME with !SPARSEMEM_VMEMMAP).
+ *
+ * With CONFIG_LRU_GEN, LRU_GEN_WIDTH flag bits hold the generation of an
+ * evictable page on the LRU (see mm_inline.h).
  */
+#ifdef CONFIG_LRU_GEN
+#define LRU_GEN_WIDTH		2
+#endif
+
 enum pageflags {
 	PG_locked,		/* Page is locked. Don't touch. */
 	PG_error,
@@ -94,12 +105,17 @@ enum pageflags {
 	PG_reclaim,		/* To be reclaimed asap */
 	PG_buddy,		/* Page is free, on buddy lists */
 	PG_swapbacked,		/* Page is backed by RAM/swap */
+	PG_workingset,		/* Refaulted into the working set */
 #ifdef CONFIG_UNEVICTABLE_LRU
 	PG_unevictable,		/* Page is "unevictable"  */
 	PG_mlocked,		/* Page is vma mlocked */
 #endif
 #ifdef CONFIG_IA64_UNCACHED_ALLOCATOR
 	PG_uncached,		/* Page has been mapped as uncached */
+#endif
+#ifdef CONFIG_LRU_GEN
+	PG_lru_gen,		/* First bit of the LRU generation */
+	PG_lru_gen_last = PG_lru_gen + LRU_GEN_WIDTH - 1,
 #endif
 	__NR_PAGEFLAGS,
 
@@ -195,6 +211,7 @@ PAGEFLAG(Reserved, reserved) __CLEARPAGEFLAG(Reserved, reserved)
 PAGEFLAG(Private, private) __CLEARPAGEFLAG(Private, private)
 	__SETPAGEFLAG(Private, private)
 PAGEFLAG(SwapBacked, swapbacked) __CLEARPAGEFLAG(SwapBacked, swapbacked)
+PAGEFLAG(Workingset, workingset)
 
 __PAGEFLAG(SlobPage, slob_page)
 __PAGEFLAG(SlobFree, slob_free)
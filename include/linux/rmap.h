@@ -84,7 +84,7 @@ static inline void page_dup_rmap(struct page *page, struct vm_area_struct *vma,
  * Called from mm/vmscan.c to handle paging out
  */
 int page_referenced(struct page *, int is_locked, struct mem_cgroup *cnt);
-int try_to_unmap(struct page *, int ignore_refs);
+int try_to_unmap(struct page *, int flags);
 
 /*
  * Called from mm/filemap_xip.c to unmap empty zero page
@@ -143,4 +143,10 @@ static inline int page_mkclean(struct page *page)
 #define SWAP_FAIL	2
 #define SWAP_MLOCK	3
 
+/*
+ * Flags for try_to_unmap
+ */
+#define TTU_MIGRATION	1	/* install migration entries */
+#define TTU_BATCH_FLUSH	2	/* defer TLB flushes to try_to_unmap_flush() */
+
 #endif	/* _LINUX_RMAP_H */
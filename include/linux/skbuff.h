@@ -135,6 +135,19 @@ struct skb_frag_struct {
 	__u32 size;
 };
 
+/* Completion state of a MSG_ZEROCOPY send.  Every skb whose frags
+ * point into the pinned user buffer holds a reference, and @callback
+ * runs when the last one is freed.  @id and @len name the range of
+ * send calls covered; @zerocopy is cleared if the data was copied.
+ */
+struct ubuf_info {
+	void		(*callback)(struct ubuf_info *, int zerocopy);
+	u32		id;
+	u16		len;
+	u16		zerocopy:1;
+	atomic_t	refcnt;
+};
+
 /* This data is invariant across clones and lives at
  * the end of the header data, ie. at skb->end.
  */
@@ -150,6 +163,7 @@ struct skb_shared_info {
 	unsigned int	num_dma_maps;
 #endif
 	struct sk_buff	*frag_list;
+	struct ubuf_info *uarg;
 	skb_frag_t	frags[MAX_SKB_FRAGS];
 #ifdef CONFIG_HAS_DMA
 	dma_addr_t	dma_maps[MAX_SKB_FRAGS + 1];
@@ -188,6 +202,9 @@ enum {
 	SKB_GSO_TCP_ECN = 1 << 3,
 
 	SKB_GSO_TCPV6 = 1 << 4,
+
+	/* UDP datagrams of gso_size payload bytes each, not IP fragments. */
+	SKB_GSO_UDP_L4 = 1 << 5,
 };
 
 #if BITS_PER_LONG > 32
@@ -253,10 +270,13 @@ typedef unsigned char *sk_buff_data_t;
  *	@requeue: set to indicate that the wireless core should attempt
  *		a software retry on this frame if we failed to
  *		receive an ACK for it
+ *	@ooo_okay: allow the mapping of a socket to a queue to be changed
+ *	@head_frag: head was carved from a page fragment, not kmalloc()ed
  *	@dma_cookie: a cookie to one of several possible DMA operations
  *		done by skb DMA functions
  *	@secmark: security marking
  *	@vlan_tci: vlan tag control information
+ *	@napi_id: id of the NAPI struct this skb came from
  */
 
 struct sk_buff {
@@ -331,7 +351,9 @@ struct sk_buff {
 	__u8			do_not_encrypt:1;
 	__u8			requeue:1;
 #endif
-	/* 0/13/14 bit hole */
+	__u8			ooo_okay:1;
+	__u8			head_frag:1;
+	/* 0/12/13 bit hole */
 
 #ifdef CONFIG_NET_DMA
 	dma_cookie_t		dma_cookie;
@@ -344,6 +366,10 @@ struct sk_buff {
 
 	__u16			vlan_tci;
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	unsigned int		napi_id;
+#endif
+
 	sk_buff_data_t		transport_header;
 	sk_buff_data_t		network_header;
 	sk_buff_data_t		mac_header;
@@ -376,6 +402,7 @@ extern void kfree_skb(struct sk_buff *skb);
 extern void	       __kfree_skb(struct sk_buff *skb);
 extern struct sk_buff *__alloc_skb(unsigned int size,
 				   gfp_t priority, int fclone, int node);
+extern struct sk_buff *build_skb(void *data, unsigned int frag_size);
 static inline struct sk_buff *alloc_skb(unsigned int size,
 					gfp_t priority)
 {
@@ -468,6 +495,12 @@ static inline unsigned char *skb_end_pointer(const struct sk_buff *skb)
 /* Internal */
 #define skb_shinfo(SKB)	((struct skb_shared_info *)(skb_end_pointer(SKB)))
 
+/* Return the completion state if the frags hold user pages */
+static inline struct ubuf_info *skb_zcopy(struct sk_buff *skb)
+{
+	return skb_shinfo(skb)->uarg;
+}
+
 /**
  *	skb_queue_empty - check if a queue is empty
  *	@list: queue head
@@ -1399,6 +1432,8 @@ static inline struct sk_buff *__dev_alloc_skb(unsigned int length,
 
 extern struct sk_buff *dev_alloc_skb(unsigned int length);
 
+extern void *netdev_alloc_frag(unsigned int fragsz);
+
 extern struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 		unsigned int length, gfp_t gfp_mask);
 
@@ -1676,6 +1711,7 @@ extern __wsum	       skb_copy_and_csum_bits(const struct sk_buff *skb,
 					      int offset, u8 *to, int len,
 					      __wsum csum);
 extern int             skb_splice_bits(struct sk_buff *skb,
+						struct sock *sk,
 						unsigned int offset,
 						struct pipe_inode_info *pipe,
 						unsigned int len,
@@ -1686,6 +1722,15 @@ extern void	       skb_split(struct sk_buff *skb,
 extern int	       skb_shift(struct sk_buff *tgt, struct sk_buff *skb,
 				 int shiftlen);
 
+extern struct ubuf_info *sock_zerocopy_alloc(struct sock *sk);
+extern void	       sock_zerocopy_put(struct ubuf_info *uarg);
+extern void	       sock_zerocopy_put_abort(struct ubuf_info *uarg);
+extern int	       skb_zerocopy_add_frags(struct sock *sk,
+					      struct sk_buff *skb,
+					      unsigned char __user *from,
+					      int len,
+					      struct ubuf_info *uarg);
+
 extern struct sk_buff *skb_segment(struct sk_buff *skb, int features);
 extern int	       skb_gro_receive(struct sk_buff **head,
 				       struct sk_buff *skb);
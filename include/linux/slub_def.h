@@ -30,8 +30,20 @@ enum stat_item {
 	DEACTIVATE_TO_TAIL,	/* Cpu slab was moved to the tail of partials */
 	DEACTIVATE_REMOTE_FREES,/* Slab contained remotely freed objects */
 	ORDER_FALLBACK,		/* Number of times fallback was necessary */
+	ALLOC_CPU_OBJECTS,	/* Allocation from the cpu object array */
+	FREE_CPU_OBJECTS,	/* Free to the cpu object array */
+	CPU_OBJECTS_FLUSH,	/* Cpu object array flushed to the slabs */
 	NR_SLUB_STAT_ITEMS };
 
+/*
+ * Objects freed on a cpu that do not belong to its cpu slab, typically
+ * allocated on another cpu, are kept in a small per cpu array instead of
+ * being returned to their slab right away.  Allocations are served from
+ * it once the cpu slab runs empty, and it is flushed to the slabs half at
+ * a time when it fills up.
+ */
+#define SLUB_CPU_OBJECTS	16
+
 struct kmem_cache_cpu {
 	void **freelist;	/* Pointer to first free per cpu object */
 	struct page *page;	/* The slab from which we are allocating */
@@ -41,6 +53,8 @@ struct kmem_cache_cpu {
 #ifdef CONFIG_SLUB_STATS
 	unsigned stat[NR_SLUB_STAT_ITEMS];
 #endif
+	unsigned int nr_objects;	/* Objects in the array */
+	void *objects[SLUB_CPU_OBJECTS];
 };
 
 struct kmem_cache_node {
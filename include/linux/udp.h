@@ -29,6 +29,7 @@ struct udphdr {
 /* UDP socket options */
 #define UDP_CORK	1	/* Never send partially complete segments */
 #define UDP_ENCAP	100	/* Set the socket to accept encapsulated packets */
+#define UDP_SEGMENT	103	/* Set GSO segmentation size */
 
 /* UDP encapsulation types */
 #define UDP_ENCAP_ESPINUDP_NON_IKE	1 /* draft-ietf-ipsec-nat-t-ike-00/01 */
@@ -47,6 +48,9 @@ static inline struct udphdr *udp_hdr(const struct sk_buff *skb)
 
 #define UDP_HTABLE_SIZE		128
 
+/* Most datagrams a single UDP_SEGMENT send may be split into */
+#define UDP_MAX_SEGMENTS	(1 << 6UL)
+
 static inline int udp_hashfn(struct net *net, const unsigned num)
 {
 	return (num + net_hash_mix(net)) & (UDP_HTABLE_SIZE - 1);
@@ -63,6 +67,7 @@ struct udp_sock {
 	 * when the socket is uncorked.
 	 */
 	__u16		 len;		/* total length of pending frames */
+	__u16		 gso_size;	/* UDP_SEGMENT payload size */
 	/*
 	 * Fields specific to UDP-Lite.
 	 */
@@ -0,0 +1,59 @@
+#ifndef _LINUX_VMPRESSURE_H
+#define _LINUX_VMPRESSURE_H
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+struct mem_cgroup;
+
+enum vmpressure_levels {
+	VMPRESSURE_LOW = 0,
+	VMPRESSURE_MEDIUM,
+	VMPRESSURE_CRITICAL,
+	VMPRESSURE_NUM_LEVELS,
+};
+
+struct vmpressure {
+	/* pages scanned and reclaimed since the last evaluation */
+	unsigned long scanned;
+	unsigned long reclaimed;
+	bool dead;		/* cgroup is going away, no more work */
+	spinlock_t sr_lock;
+
+	/* registered listeners, protected by events_lock */
+	struct list_head events;
+	struct mutex events_lock;
+
+	struct work_struct work;
+};
+
+#ifdef CONFIG_CGROUP_MEM_RES_CTLR
+extern void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		       unsigned long scanned, unsigned long reclaimed);
+extern void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio);
+
+extern void vmpressure_init(struct vmpressure *vmpr);
+extern void vmpressure_cleanup(struct vmpressure *vmpr);
+extern int vmpressure_register_event(struct vmpressure *vmpr,
+				     const char *args);
+
+/* provided by the memory controller */
+extern struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *memcg);
+extern struct vmpressure *vmpressure_parent(struct vmpressure *vmpr);
+#else
+static inline void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+			      unsigned long scanned, unsigned long reclaimed)
+{
+}
+
+static inline void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg,
+				   int prio)
+{
+}
+#endif /* CONFIG_CGROUP_MEM_RES_CTLR */
+
+#endif /* _LINUX_VMPRESSURE_H */
@@ -0,0 +1,106 @@
+/*
+ * Low latency sockets: busy poll the device queue a socket receives
+ * from, instead of sleeping until the interrupt and softirq deliver
+ * the packet.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _LINUX_NET_BUSY_POLL_H
+#define _LINUX_NET_BUSY_POLL_H
+
+#include <linux/netdevice.h>
+#include <linux/sched.h>
+#include <net/sock.h>
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+
+extern unsigned int sysctl_net_busy_read __read_mostly;
+extern unsigned int sysctl_net_busy_poll __read_mostly;
+
+/* Packets processed per ->poll() call from the busy loop. */
+#define BUSY_POLL_BUDGET 8
+
+extern bool sk_busy_loop(struct sock *sk, unsigned int usecs, int nonblock);
+
+static inline bool net_busy_loop_on(void)
+{
+	return sysctl_net_busy_poll;
+}
+
+static inline bool sk_can_busy_loop(struct sock *sk)
+{
+	return sk->sk_ll_usec && sk->sk_napi_id &&
+	       !signal_pending(current);
+}
+
+/*
+ * Spin for up to SO_BUSY_POLL (or net.core.busy_read) microseconds
+ * waiting for data on @sk.  With @nonblock, poll the device once.
+ */
+static inline bool sk_busy_loop_rx(struct sock *sk, int nonblock)
+{
+	return sk_busy_loop(sk, ACCESS_ONCE(sk->sk_ll_usec), nonblock);
+}
+
+/* Spin for up to net.core.busy_poll microseconds, from poll()/select(). */
+static inline bool sk_busy_loop_poll(struct sock *sk)
+{
+	return sk_busy_loop(sk, ACCESS_ONCE(sysctl_net_busy_poll), 0);
+}
+
+/* used in the NIC receive handler to mark the skb */
+static inline void skb_mark_napi_id(struct sk_buff *skb,
+				    struct napi_struct *napi)
+{
+	skb->napi_id = napi->napi_id;
+}
+
+/* used in the protocol handler to propagate the napi_id to the socket */
+static inline void sk_mark_napi_id(struct sock *sk, struct sk_buff *skb)
+{
+	sk->sk_napi_id = skb->napi_id;
+}
+
+#else /* CONFIG_NET_RX_BUSY_POLL */
+
+static inline bool net_busy_loop_on(void)
+{
+	return false;
+}
+
+static inline bool sk_can_busy_loop(struct sock *sk)
+{
+	return false;
+}
+
+static inline bool sk_busy_loop(struct sock *sk, unsigned int usecs,
+				int nonblock)
+{
+	return false;
+}
+
+static inline bool sk_busy_loop_rx(struct sock *sk, int nonblock)
+{
+	return false;
+}
+
+static inline bool sk_busy_loop_poll(struct sock *sk)
+{
+	return false;
+}
+
+static inline void skb_mark_napi_id(struct sk_buff *skb,
+				    struct napi_struct *napi)
+{
+}
+
+static inline void sk_mark_napi_id(struct sock *sk, struct sk_buff *skb)
+{
+}
+
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+#endif /* _LINUX_NET_BUSY_POLL_H */
@@ -103,6 +103,7 @@ struct rtable;
  * @is_icsk - is this an inet_connection_sock?
  * @mc_index - Multicast device index
  * @mc_list - Group array
+ * @rx_dst_ifindex - Input interface of the cached sk_rx_dst
  * @cork - info to build ip hdr on each ip frag while socket is corked
  */
 struct inet_sock {
@@ -134,12 +135,14 @@ struct inet_sock {
 	int			mc_index;
 	__be32			mc_addr;
 	struct ip_mc_socklist	*mc_list;
+	int			rx_dst_ifindex;
 	struct {
 		unsigned int		flags;
 		unsigned int		fragsize;
 		struct ip_options	*opt;
 		struct dst_entry	*dst;
 		int			length; /* Total length of all frames */
+		unsigned int		gso_size; /* Cut into datagrams by GSO */
 		__be32			addr;
 		struct flowi		fl;
 	} cork;
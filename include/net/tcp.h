@@ -421,6 +421,8 @@ extern struct sock *		tcp_v4_syn_recv_sock(struct sock *sk,
 extern int			tcp_v4_do_rcv(struct sock *sk,
 					      struct sk_buff *skb);
 
+extern void			tcp_v4_early_demux(struct sk_buff *skb);
+
 extern int			tcp_v4_connect(struct sock *sk,
 					       struct sockaddr *uaddr,
 					       int addr_len);
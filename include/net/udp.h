@@ -134,13 +134,18 @@ extern void	udp_err(struct sk_buff *, u32);
 
 extern int	udp_sendmsg(struct kiocb *iocb, struct sock *sk,
 			    struct msghdr *msg, size_t len);
+extern int	udp_cmsg_send(struct msghdr *msg, u16 *gso_size);
 extern void	udp_flush_pending_frames(struct sock *sk);
 
 extern int	udp_rcv(struct sk_buff *skb);
+extern struct sk_buff *udp4_gso_segment(struct sk_buff *skb, int features);
 extern int	udp_ioctl(struct sock *sk, int cmd, unsigned long arg);
 extern int	udp_disconnect(struct sock *sk, int flags);
 extern unsigned int udp_poll(struct file *file, struct socket *sock,
 			     poll_table *wait);
+extern ssize_t	udp_splice_read(struct socket *sock, loff_t *ppos,
+				struct pipe_inode_info *pipe, size_t len,
+				unsigned int flags);
 extern int 	udp_lib_getsockopt(struct sock *sk, int level, int optname,
 			           char __user *optval, int __user *optlen);
 extern int 	udp_lib_setsockopt(struct sock *sk, int level, int optname,
@@ -178,8 +183,17 @@ extern struct sock *udp4_lib_lookup(struct net *net, __be32 saddr, __be16 sport,
 		else \
 			UDP6_INC_STATS_BH(sock_net(sk), field, 0); \
 	} while (0);
+#define UDPX_INC_STATS_USER(sk, field, __lite) \
+	do { \
+		if ((sk)->sk_family == AF_INET) \
+			UDP_INC_STATS_USER(sock_net(sk), field, __lite); \
+		else \
+			UDP6_INC_STATS_USER(sock_net(sk), field, __lite); \
+	} while (0)
 #else
 #define UDPX_INC_STATS_BH(sk, field) UDP_INC_STATS_BH(sock_net(sk), field, 0)
+#define UDPX_INC_STATS_USER(sk, field, __lite) \
+	UDP_INC_STATS_USER(sock_net(sk), field, __lite)
 #endif
 
 /* /proc */
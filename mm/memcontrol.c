@@ -28,20 +28,28 @@
 #include <linux/bit_spinlock.h>
 #include <linux/rcupdate.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/spinlock.h>
 #include <linux/fs.h>
 #include <linux/seq_file.h>
 #include <linux/vmalloc.h>
+#include <linux/cpu.h>
+#include <linux/workqueue.h>
 #include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
+#include <linux/vmpressure.h>
+#include <linux/memstall.h>
 #include "internal.h"
 
+#include <asm/div64.h>
 #include <asm/uaccess.h>
 
 struct cgroup_subsys mem_cgroup_subsys __read_mostly;
 #define MEM_CGROUP_RECLAIM_RETRIES	5
+#define SOFTLIMIT_EVENTS_THRESH		1000
+#define MEM_CGROUP_MAX_SOFT_LIMIT_RECLAIM_LOOPS	2
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 /* Turned on only when memory cgroup is enabled && really_do_swap_account = 0 */
@@ -64,6 +72,15 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_RSS,	   /* # of pages charged as rss */
 	MEM_CGROUP_STAT_PGPGIN_COUNT,	/* # of pages paged in */
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
+	MEM_CGROUP_STAT_PGFAULT,	/* # of page faults */
+	MEM_CGROUP_STAT_PGMAJFAULT,	/* # of major page faults */
+	MEM_CGROUP_STAT_PGSCAN,		/* # of pages scanned by reclaim */
+	MEM_CGROUP_STAT_PGSTEAL,	/* # of pages reclaimed */
+	/*
+	 * Charges and uncharges since the soft limit tree was last
+	 * updated; not shown in memory.stat.
+	 */
+	MEM_CGROUP_STAT_EVENTS,
 
 	MEM_CGROUP_STAT_NSTATS,
 };
@@ -85,6 +102,18 @@ static inline void __mem_cgroup_stat_add_safe(struct mem_cgroup_stat_cpu *stat,
 	stat->count[idx] += val;
 }
 
+static inline s64 __mem_cgroup_stat_read_local(struct mem_cgroup_stat_cpu *stat,
+		enum mem_cgroup_stat_index idx)
+{
+	return stat->count[idx];
+}
+
+static inline void __mem_cgroup_stat_reset_safe(struct mem_cgroup_stat_cpu *stat,
+		enum mem_cgroup_stat_index idx)
+{
+	stat->count[idx] = 0;
+}
+
 static s64 mem_cgroup_read_stat(struct mem_cgroup_stat *stat,
 		enum mem_cgroup_stat_index idx)
 {
@@ -106,6 +135,12 @@ struct mem_cgroup_per_zone {
 	unsigned long		count[NR_LRU_LISTS];
 
 	struct zone_reclaim_stat reclaim_stat;
+
+	struct rb_node		tree_node;	/* in the soft limit tree */
+	unsigned long long	usage_in_excess;/* over soft limit by this much */
+	bool			on_tree;
+	struct mem_cgroup	*mem;		/* back pointer, we cannot */
+						/* use container_of	   */
 };
 /* Macro for accessing counter */
 #define MEM_CGROUP_ZSTAT(mz, idx)	((mz)->count[(idx)])
@@ -118,6 +153,29 @@ struct mem_cgroup_lru_info {
 	struct mem_cgroup_per_node *nodeinfo[MAX_NUMNODES];
 };
 
+/*
+ * Cgroups above their soft limit are kept in per-zone RB-trees, sorted
+ * by how far they exceed it, so that kswapd can pick the worst offender
+ * of a zone without walking all cgroups.  Uncharge happens under the
+ * mapping's tree_lock, so the lock is taken with interrupts disabled.
+ */
+struct mem_cgroup_tree_per_zone {
+	struct rb_root rb_root;
+	spinlock_t lock;
+};
+
+struct mem_cgroup_tree_per_node {
+	struct mem_cgroup_tree_per_zone rb_tree_per_zone[MAX_NR_ZONES];
+};
+
+struct mem_cgroup_tree {
+	struct mem_cgroup_tree_per_node *rb_tree_per_node[MAX_NUMNODES];
+};
+
+static struct mem_cgroup_tree soft_limit_tree __read_mostly;
+
+static struct mem_cgroup *root_mem_cgroup __read_mostly;
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -166,6 +224,11 @@ struct mem_cgroup {
 
 	unsigned int	swappiness;
 
+	/* reclaim efficiency, for memory.pressure_level listeners */
+	struct vmpressure vmpressure;
+	/* time tasks in this subtree were stalled on memory */
+	struct memstall_group stall;
+
 	/*
 	 * statistics. This must be placed at the end of memcg.
 	 */
@@ -224,6 +287,7 @@ static void mem_cgroup_charge_statistics(struct mem_cgroup *mem,
 	else
 		__mem_cgroup_stat_add_safe(cpustat,
 				MEM_CGROUP_STAT_PGPGOUT_COUNT, 1);
+	__mem_cgroup_stat_add_safe(cpustat, MEM_CGROUP_STAT_EVENTS, 1);
 	put_cpu();
 }
 
@@ -307,6 +371,42 @@ static bool mem_cgroup_is_obsolete(struct mem_cgroup *mem)
 	return css_is_removed(&mem->css);
 }
 
+/*
+ * Account a page fault of @mm to the cgroup it belongs to.  Only
+ * PGFAULT and PGMAJFAULT are kept per cgroup.
+ */
+void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx)
+{
+	struct mem_cgroup *mem;
+	struct mem_cgroup_stat_cpu *cpustat;
+	int cpu;
+
+	if (mem_cgroup_disabled() || !mm)
+		return;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(rcu_dereference(mm->owner));
+	if (unlikely(!mem))
+		goto out;
+
+	cpu = get_cpu();
+	cpustat = &mem->stat.cpustat[cpu];
+	switch (idx) {
+	case PGFAULT:
+		__mem_cgroup_stat_add_safe(cpustat, MEM_CGROUP_STAT_PGFAULT, 1);
+		break;
+	case PGMAJFAULT:
+		__mem_cgroup_stat_add_safe(cpustat,
+				MEM_CGROUP_STAT_PGMAJFAULT, 1);
+		break;
+	default:
+		BUG();
+	}
+	put_cpu();
+out:
+	rcu_read_unlock();
+}
+
 /*
  * Following LRU functions are allowed to be used without PCG_LOCK.
  * Operations are called by routine of global LRU independently from memcg.
@@ -581,6 +681,23 @@ mem_cgroup_get_reclaim_stat_from_page(struct page *page)
 	return &mz->reclaim_stat;
 }
 
+/*
+ * Called by reclaim on behalf of @mem to account what it scanned and
+ * reclaimed from the cgroup's LRU lists.
+ */
+void mem_cgroup_reclaim_statistics(struct mem_cgroup *mem,
+				   unsigned long scanned,
+				   unsigned long reclaimed)
+{
+	struct mem_cgroup_stat_cpu *cpustat;
+	int cpu = get_cpu();
+
+	cpustat = &mem->stat.cpustat[cpu];
+	__mem_cgroup_stat_add_safe(cpustat, MEM_CGROUP_STAT_PGSCAN, scanned);
+	__mem_cgroup_stat_add_safe(cpustat, MEM_CGROUP_STAT_PGSTEAL, reclaimed);
+	put_cpu();
+}
+
 unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 					struct list_head *dst,
 					unsigned long *scanned, int order,
@@ -628,6 +745,228 @@ unsigned long mem_cgroup_isolate_pages(unsigned long nr_to_scan,
 #define mem_cgroup_from_res_counter(counter, member)	\
 	container_of(counter, struct mem_cgroup, member)
 
+static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem)
+{
+	if (!mem->res.parent)
+		return NULL;
+	return mem_cgroup_from_res_counter(mem->res.parent, res);
+}
+
+/*
+ * Global reclaim is accounted to the root cgroup.
+ */
+struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *memcg)
+{
+	if (mem_cgroup_disabled())
+		return NULL;
+	if (!memcg)
+		memcg = root_mem_cgroup;
+	return memcg ? &memcg->vmpressure : NULL;
+}
+
+struct vmpressure *vmpressure_parent(struct vmpressure *vmpr)
+{
+	struct mem_cgroup *memcg;
+
+	memcg = container_of(vmpr, struct mem_cgroup, vmpressure);
+	memcg = parent_mem_cgroup(memcg);
+	return memcg ? &memcg->vmpressure : NULL;
+}
+
+/*
+ * A cgroup is stalled while any task in it or below it is, whether or
+ * not the hierarchy is used for accounting: the stall time tells how the
+ * whole subtree is doing.
+ */
+static struct mem_cgroup *memstall_parent(struct mem_cgroup *mem)
+{
+	struct cgroup *parent = mem->css.cgroup->parent;
+
+	return parent ? mem_cgroup_from_cont(parent) : NULL;
+}
+
+/*
+ * Start accounting a memory stall of current to its cgroup and all the
+ * ancestors.  Returns the cgroup with a reference held, to be passed to
+ * mem_cgroup_memstall_leave().
+ */
+struct mem_cgroup *mem_cgroup_memstall_enter(u64 now)
+{
+	struct mm_struct *mm = current->mm;
+	struct mem_cgroup *mem, *iter;
+
+	if (mem_cgroup_disabled() || !mm)
+		return NULL;
+
+	mem = try_get_mem_cgroup_from_mm(mm);
+	for (iter = mem; iter; iter = memstall_parent(iter))
+		memstall_group_enter(&iter->stall, now);
+	return mem;
+}
+
+void mem_cgroup_memstall_leave(struct mem_cgroup *mem, u64 now)
+{
+	struct mem_cgroup *iter;
+
+	if (!mem)
+		return;
+
+	for (iter = mem; iter; iter = memstall_parent(iter))
+		memstall_group_leave(&iter->stall, now);
+	css_put(&mem->css);
+}
+
+static struct mem_cgroup_tree_per_zone *
+soft_limit_tree_node_zone(int nid, int zid)
+{
+	return &soft_limit_tree.rb_tree_per_node[nid]->rb_tree_per_zone[zid];
+}
+
+static void
+__mem_cgroup_insert_exceeded(struct mem_cgroup *mem,
+			     struct mem_cgroup_per_zone *mz,
+			     struct mem_cgroup_tree_per_zone *mctz,
+			     unsigned long long new_usage_in_excess)
+{
+	struct rb_node **p = &mctz->rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct mem_cgroup_per_zone *mz_node;
+
+	if (mz->on_tree || !new_usage_in_excess)
+		return;
+
+	mz->usage_in_excess = new_usage_in_excess;
+	while (*p) {
+		parent = *p;
+		mz_node = rb_entry(parent, struct mem_cgroup_per_zone,
+					tree_node);
+		/* cgroups exceeding by the same amount go to the right */
+		if (mz->usage_in_excess < mz_node->usage_in_excess)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&mz->tree_node, parent, p);
+	rb_insert_color(&mz->tree_node, &mctz->rb_root);
+	mz->on_tree = true;
+}
+
+static void
+__mem_cgroup_remove_exceeded(struct mem_cgroup *mem,
+			     struct mem_cgroup_per_zone *mz,
+			     struct mem_cgroup_tree_per_zone *mctz)
+{
+	if (!mz->on_tree)
+		return;
+	rb_erase(&mz->tree_node, &mctz->rb_root);
+	mz->on_tree = false;
+}
+
+static void
+mem_cgroup_insert_exceeded(struct mem_cgroup *mem,
+			   struct mem_cgroup_per_zone *mz,
+			   struct mem_cgroup_tree_per_zone *mctz)
+{
+	unsigned long long excess;
+	unsigned long flags;
+
+	excess = res_counter_soft_limit_excess(&mem->res);
+	spin_lock_irqsave(&mctz->lock, flags);
+	__mem_cgroup_insert_exceeded(mem, mz, mctz, excess);
+	spin_unlock_irqrestore(&mctz->lock, flags);
+}
+
+/*
+ * Reposition @mem and its ancestors in the soft limit tree of the zone
+ * @page belongs to.  Charges to a child are charged to the ancestors
+ * too, but only the child's event counter ticks, so they are updated
+ * here as well.
+ */
+static void mem_cgroup_update_tree(struct mem_cgroup *mem, struct page *page)
+{
+	unsigned long long excess;
+	struct mem_cgroup_per_zone *mz;
+	struct mem_cgroup_tree_per_zone *mctz;
+	int nid = page_to_nid(page);
+	int zid = page_zonenum(page);
+	unsigned long flags;
+
+	mctz = soft_limit_tree_node_zone(nid, zid);
+	for (; mem; mem = parent_mem_cgroup(mem)) {
+		mz = mem_cgroup_zoneinfo(mem, nid, zid);
+		excess = res_counter_soft_limit_excess(&mem->res);
+		if (!excess && !mz->on_tree)
+			continue;
+		spin_lock_irqsave(&mctz->lock, flags);
+		__mem_cgroup_remove_exceeded(mem, mz, mctz);
+		__mem_cgroup_insert_exceeded(mem, mz, mctz, excess);
+		spin_unlock_irqrestore(&mctz->lock, flags);
+	}
+}
+
+static void mem_cgroup_remove_from_trees(struct mem_cgroup *mem)
+{
+	struct mem_cgroup_per_zone *mz;
+	struct mem_cgroup_tree_per_zone *mctz;
+	unsigned long flags;
+	int node, zid;
+
+	for_each_node_state(node, N_POSSIBLE) {
+		if (!mem->info.nodeinfo[node])
+			continue;
+		for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+			mz = mem_cgroup_zoneinfo(mem, node, zid);
+			if (!mz->on_tree)
+				continue;
+			mctz = soft_limit_tree_node_zone(node, zid);
+			spin_lock_irqsave(&mctz->lock, flags);
+			__mem_cgroup_remove_exceeded(mem, mz, mctz);
+			spin_unlock_irqrestore(&mctz->lock, flags);
+		}
+	}
+}
+
+/*
+ * Take the cgroup exceeding its soft limit the most off the tree and
+ * return it with a css reference held.  It is put back by the caller
+ * once reclaim is done.
+ */
+static struct mem_cgroup_per_zone *
+mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_zone *mctz)
+{
+	struct rb_node *rightmost;
+	struct mem_cgroup_per_zone *mz = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mctz->lock, flags);
+	while ((rightmost = rb_last(&mctz->rb_root))) {
+		mz = rb_entry(rightmost, struct mem_cgroup_per_zone, tree_node);
+		__mem_cgroup_remove_exceeded(mz->mem, mz, mctz);
+		if (res_counter_soft_limit_excess(&mz->mem->res) &&
+		    css_tryget(&mz->mem->css))
+			break;
+		mz = NULL;
+	}
+	spin_unlock_irqrestore(&mctz->lock, flags);
+	return mz;
+}
+
+static bool mem_cgroup_soft_limit_check(struct mem_cgroup *mem)
+{
+	struct mem_cgroup_stat_cpu *cpustat;
+	bool ret = false;
+	int cpu = get_cpu();
+
+	cpustat = &mem->stat.cpustat[cpu];
+	if (unlikely(__mem_cgroup_stat_read_local(cpustat,
+			MEM_CGROUP_STAT_EVENTS) > SOFTLIMIT_EVENTS_THRESH)) {
+		__mem_cgroup_stat_reset_safe(cpustat, MEM_CGROUP_STAT_EVENTS);
+		ret = true;
+	}
+	put_cpu();
+	return ret;
+}
+
 /*
  * This routine finds the DFS walk successor. This routine should be
  * called with hierarchy_mutex held
@@ -796,6 +1135,53 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 	return ret;
 }
 
+/*
+ * Called by kswapd before it reclaims from @zone: take pages from the
+ * cgroups that exceed their soft limit the most first.  Only the pages
+ * charged to the victim itself are reclaimed, not those of its children.
+ */
+unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
+					    gfp_t gfp_mask)
+{
+	struct mem_cgroup_per_zone *mz, *failed = NULL;
+	struct mem_cgroup_tree_per_zone *mctz;
+	unsigned long nr_reclaimed = 0;
+	unsigned long reclaimed;
+	int loop = 0;
+
+	if (mem_cgroup_disabled() || order > 0)
+		return 0;
+
+	mctz = soft_limit_tree_node_zone(zone_to_nid(zone), zone_idx(zone));
+	do {
+		mz = mem_cgroup_largest_soft_limit_node(mctz);
+		if (!mz)
+			break;
+
+		reclaimed = mem_cgroup_shrink_zone(mz->mem, zone, gfp_mask,
+						   false,
+						   get_swappiness(mz->mem));
+		nr_reclaimed += reclaimed;
+		/*
+		 * Keep the first cgroup we could not reclaim from off the
+		 * tree until we are done, so the next round picks another.
+		 */
+		if (!reclaimed && !failed) {
+			failed = mz;
+			continue;
+		}
+		mem_cgroup_insert_exceeded(mz->mem, mz, mctz);
+		css_put(&mz->mem->css);
+	} while (!nr_reclaimed &&
+		 ++loop < MEM_CGROUP_MAX_SOFT_LIMIT_RECLAIM_LOOPS);
+
+	if (failed) {
+		mem_cgroup_insert_exceeded(failed->mem, failed, mctz);
+		css_put(&failed->mem->css);
+	}
+	return nr_reclaimed;
+}
+
 bool mem_cgroup_oom_called(struct task_struct *task)
 {
 	bool ret = false;
@@ -812,6 +1198,136 @@ bool mem_cgroup_oom_called(struct task_struct *task)
 	rcu_read_unlock();
 	return ret;
 }
+
+/*
+ * Charging takes the res_counter lock of the cgroup and of all of its
+ * ancestors.  To keep that off the page fault path, charges are made
+ * CHARGE_SIZE at a time and what is not used yet is kept in a per-cpu
+ * stock, from which the next charges to the same cgroup are served and
+ * to which its uncharges go back.  The stock is returned to the counters
+ * when another cgroup's charge replaces it, or when it is drained before
+ * reclaim, limit changes and rmdir.
+ */
+#define CHARGE_SIZE	(32 * PAGE_SIZE)
+struct memcg_stock_pcp {
+	struct mem_cgroup *cached;
+	int charge;
+	struct work_struct work;
+};
+static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
+
+/*
+ * Try to take a page worth of charge for @mem from the local stock.
+ */
+static bool consume_stock(struct mem_cgroup *mem)
+{
+	struct memcg_stock_pcp *stock;
+	bool ret = false;
+
+	stock = &get_cpu_var(memcg_stock);
+	if (mem == stock->cached && stock->charge) {
+		stock->charge -= PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
+/*
+ * Give an uncharged page of @mem back to the local stock, if that
+ * stock is @mem's and not yet full.
+ */
+static bool uncharge_to_stock(struct mem_cgroup *mem)
+{
+	struct memcg_stock_pcp *stock;
+	bool ret = false;
+
+	stock = &get_cpu_var(memcg_stock);
+	if (mem == stock->cached && stock->charge < CHARGE_SIZE) {
+		stock->charge += PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
+/*
+ * Return the charges held by a stock to the res_counters.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	struct mem_cgroup *old = stock->cached;
+
+	if (stock->charge) {
+		res_counter_uncharge(&old->res, stock->charge);
+		if (do_swap_account)
+			res_counter_uncharge(&old->memsw, stock->charge);
+	}
+	stock->cached = NULL;
+	stock->charge = 0;
+}
+
+static void drain_local_stock(struct work_struct *dummy)
+{
+	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+
+	drain_stock(stock);
+	put_cpu_var(memcg_stock);
+}
+
+/*
+ * Put the leftover of a batched charge to @mem into the local stock.
+ */
+static void refill_stock(struct mem_cgroup *mem, int val)
+{
+	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+
+	if (stock->cached != mem) {
+		drain_stock(stock);
+		stock->cached = mem;
+	}
+	stock->charge += val;
+	put_cpu_var(memcg_stock);
+}
+
+/*
+ * Ask all cpus to drain their stocks, without waiting for them.  Used
+ * before reclaim: the charges come back while we reclaim.
+ */
+static void drain_all_stock_async(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
+
+		if (stock->cached)
+			schedule_work_on(cpu, &stock->work);
+	}
+	put_online_cpus();
+}
+
+/*
+ * Drain all stocks and wait for it, for callers that need the counters
+ * to be exact.
+ */
+static void drain_all_stock_sync(void)
+{
+	schedule_on_each_cpu(drain_local_stock);
+}
+
+static int __cpuinit memcg_stock_cpu_callback(struct notifier_block *nb,
+					      unsigned long action,
+					      void *hcpu)
+{
+	int cpu = (unsigned long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		drain_stock(&per_cpu(memcg_stock, cpu));
+	return NOTIFY_OK;
+}
+
 /*
  * Unlike exported interface, "oom" parameter is added. if oom==true,
  * oom-killer can be invoked.
@@ -823,6 +1339,7 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 	struct mem_cgroup *mem, *mem_over_limit;
 	int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
 	struct res_counter *fail_res;
+	int csize = CHARGE_SIZE;
 
 	if (unlikely(test_thread_flag(TIF_MEMDIE))) {
 		/* Don't account this! */
@@ -848,20 +1365,23 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 
 	VM_BUG_ON(mem_cgroup_is_obsolete(mem));
 
+	if (consume_stock(mem))
+		return 0;
+
 	while (1) {
 		int ret;
 		bool noswap = false;
 
-		ret = res_counter_charge(&mem->res, PAGE_SIZE, &fail_res);
+		ret = res_counter_charge(&mem->res, csize, &fail_res);
 		if (likely(!ret)) {
 			if (!do_swap_account)
 				break;
-			ret = res_counter_charge(&mem->memsw, PAGE_SIZE,
+			ret = res_counter_charge(&mem->memsw, csize,
 							&fail_res);
 			if (likely(!ret))
 				break;
 			/* mem+swap counter fails */
-			res_counter_uncharge(&mem->res, PAGE_SIZE);
+			res_counter_uncharge(&mem->res, csize);
 			noswap = true;
 			mem_over_limit = mem_cgroup_from_res_counter(fail_res,
 									memsw);
@@ -870,9 +1390,16 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 			mem_over_limit = mem_cgroup_from_res_counter(fail_res,
 									res);
 
+		/* Near the limit: charge a single page before reclaiming */
+		if (csize > PAGE_SIZE) {
+			csize = PAGE_SIZE;
+			continue;
+		}
+
 		if (!(gfp_mask & __GFP_WAIT))
 			goto nomem;
 
+		drain_all_stock_async();
 		ret = mem_cgroup_hierarchical_reclaim(mem_over_limit, gfp_mask,
 							noswap);
 		if (ret)
@@ -899,6 +1426,8 @@ static int __mem_cgroup_try_charge(struct mm_struct *mm,
 			goto nomem;
 		}
 	}
+	if (csize > PAGE_SIZE)
+		refill_stock(mem, csize - PAGE_SIZE);
 	return 0;
 nomem:
 	css_put(&mem->css);
@@ -951,6 +1480,9 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 	mem_cgroup_charge_statistics(mem, pc, true);
 
 	unlock_page_cgroup(pc);
+
+	if (mem_cgroup_soft_limit_check(mem))
+		mem_cgroup_update_tree(mem, pc->page);
 }
 
 /**
@@ -1320,9 +1852,13 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 		break;
 	}
 
-	res_counter_uncharge(&mem->res, PAGE_SIZE);
-	if (do_swap_account && (ctype != MEM_CGROUP_CHARGE_TYPE_SWAPOUT))
-		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
+	if (ctype == MEM_CGROUP_CHARGE_TYPE_SWAPOUT)
+		res_counter_uncharge(&mem->res, PAGE_SIZE);
+	else if (!uncharge_to_stock(mem)) {
+		res_counter_uncharge(&mem->res, PAGE_SIZE);
+		if (do_swap_account)
+			res_counter_uncharge(&mem->memsw, PAGE_SIZE);
+	}
 
 	mem_cgroup_charge_statistics(mem, pc, false);
 	ClearPageCgroupUsed(pc);
@@ -1336,6 +1872,9 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 	mz = page_cgroup_zoneinfo(pc);
 	unlock_page_cgroup(pc);
 
+	if (mem_cgroup_soft_limit_check(mem))
+		mem_cgroup_update_tree(mem, page);
+
 	/* at swapout, this memcg will be accessed to record to swap */
 	if (ctype != MEM_CGROUP_CHARGE_TYPE_SWAPOUT)
 		css_put(&mem->css);
@@ -1551,6 +2090,7 @@ static int mem_cgroup_resize_limit(struct mem_cgroup *memcg,
 		if (!ret)
 			break;
 
+		drain_all_stock_sync();
 		progress = mem_cgroup_hierarchical_reclaim(memcg, GFP_KERNEL,
 							   false);
   		if (!progress)			retry_count--;
@@ -1592,6 +2132,7 @@ int mem_cgroup_resize_memsw_limit(struct mem_cgroup *memcg,
 		if (!ret)
 			break;
 
+		drain_all_stock_sync();
 		oldusage = res_counter_read_u64(&memcg->memsw, RES_USAGE);
 		mem_cgroup_hierarchical_reclaim(memcg, GFP_KERNEL, true);
 		curusage = res_counter_read_u64(&memcg->memsw, RES_USAGE);
@@ -1683,6 +2224,7 @@ move_account:
 			goto out;
 		/* This is for making all *used* pages to be on LRU. */
 		lru_add_drain_all();
+		drain_all_stock_sync();
 		ret = 0;
 		for_each_node_state(node, N_POSSIBLE) {
 			for (zid = 0; !ret && zid < MAX_NR_ZONES; zid++) {
@@ -1715,6 +2257,7 @@ try_to_free:
 	}
 	/* we call try-to-free pages for make this cgroup empty */
 	lru_add_drain_all();
+	drain_all_stock_sync();
 	/* try to free all pages in this cgroup */
 	shrink = 1;
 	while (nr_retries && mem->res.usage > 0) {
@@ -1730,6 +2273,7 @@ try_to_free:
 			nr_retries--;
 			/* maybe some writeback is necessary */
 			congestion_wait(WRITE, HZ/10);
+			drain_all_stock_sync();
 		}
 
 	}
@@ -1809,7 +2353,7 @@ static u64 mem_cgroup_read(struct cgroup *cont, struct cftype *cft)
 }
 /*
  * The user of this function is...
- * RES_LIMIT.
+ * RES_LIMIT, RES_SOFT_LIMIT.
  */
 static int mem_cgroup_write(struct cgroup *cont, struct cftype *cft,
 			    const char *buffer)
@@ -1832,6 +2376,16 @@ static int mem_cgroup_write(struct cgroup *cont, struct cftype *cft,
 		else
 			ret = mem_cgroup_resize_memsw_limit(memcg, val);
 		break;
+	case RES_SOFT_LIMIT:
+		ret = res_counter_memparse_write_strategy(buffer, &val);
+		if (ret)
+			break;
+		/* There is no soft limit for mem+swap */
+		if (type == _MEM)
+			res_counter_set_soft_limit(&memcg->res, val);
+		else
+			ret = -EINVAL;
+		break;
 	default:
 		ret = -EINVAL; /* should be BUG() ? */
 		break;
@@ -1867,6 +2421,21 @@ out:
 	return;
 }
 
+/*
+ * The most memory the tasks of @mem can use, in bytes: the smallest limit
+ * up the hierarchy, including swap when it is accounted.  Used to scale
+ * the OOM badness of those tasks.
+ */
+u64 mem_cgroup_get_limit(struct mem_cgroup *mem)
+{
+	unsigned long long limit, memsw_limit;
+
+	memcg_get_hierarchical_limit(mem, &limit, &memsw_limit);
+	if (do_swap_account)
+		limit = memsw_limit;
+	return limit;
+}
+
 static int mem_cgroup_reset(struct cgroup *cont, unsigned int event)
 {
 	struct mem_cgroup *mem;
@@ -1900,6 +2469,10 @@ static const struct mem_cgroup_stat_desc {
 	[MEM_CGROUP_STAT_RSS] = { "rss", PAGE_SIZE, },
 	[MEM_CGROUP_STAT_PGPGIN_COUNT] = {"pgpgin", 1, },
 	[MEM_CGROUP_STAT_PGPGOUT_COUNT] = {"pgpgout", 1, },
+	[MEM_CGROUP_STAT_PGFAULT] = {"pgfault", 1, },
+	[MEM_CGROUP_STAT_PGMAJFAULT] = {"pgmajfault", 1, },
+	[MEM_CGROUP_STAT_PGSCAN] = {"pgscan", 1, },
+	[MEM_CGROUP_STAT_PGSTEAL] = {"pgsteal", 1, },
 };
 
 static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
@@ -1909,7 +2482,7 @@ static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
 	struct mem_cgroup_stat *stat = &mem_cont->stat;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(stat->cpustat[0].count); i++) {
+	for (i = 0; i < ARRAY_SIZE(mem_cgroup_stat_desc); i++) {
 		s64 val;
 
 		val = mem_cgroup_read_stat(stat, i);
@@ -1980,6 +2553,32 @@ static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
 	return 0;
 }
 
+static int mem_cgroup_pressure_level_write(struct cgroup *cgrp,
+					   struct cftype *cft,
+					   const char *buffer)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	return vmpressure_register_event(&memcg->vmpressure, buffer);
+}
+
+static u64 mem_cgroup_stall_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	u64 total = memstall_group_total(&memcg->stall);
+
+	do_div(total, NSEC_PER_USEC);
+	return total;
+}
+
+static int mem_cgroup_stall_write(struct cgroup *cgrp, struct cftype *cft,
+				  const char *buffer)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	return memstall_register_trigger(&memcg->stall, buffer);
+}
+
 static u64 mem_cgroup_swappiness_read(struct cgroup *cgrp, struct cftype *cft)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
@@ -2038,6 +2637,12 @@ static struct cftype mem_cgroup_files[] = {
 		.write_string = mem_cgroup_write,
 		.read_u64 = mem_cgroup_read,
 	},
+	{
+		.name = "soft_limit_in_bytes",
+		.private = MEMFILE_PRIVATE(_MEM, RES_SOFT_LIMIT),
+		.write_string = mem_cgroup_write,
+		.read_u64 = mem_cgroup_read,
+	},
 	{
 		.name = "failcnt",
 		.private = MEMFILE_PRIVATE(_MEM, RES_FAILCNT),
@@ -2062,6 +2667,15 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "pressure_level",
+		.write_string = mem_cgroup_pressure_level_write,
+	},
+	{
+		.name = "stall",
+		.read_u64 = mem_cgroup_stall_read,
+		.write_string = mem_cgroup_stall_write,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -2132,6 +2746,7 @@ static int alloc_mem_cgroup_per_zone_info(struct mem_cgroup *mem, int node)
 		mz = &pn->zoneinfo[zone];
 		for_each_lru(l)
 			INIT_LIST_HEAD(&mz->lists[l]);
+		mz->mem = mem;
 	}
 	return 0;
 }
@@ -2177,6 +2792,8 @@ static void __mem_cgroup_free(struct mem_cgroup *mem)
 {
 	int node;
 
+	mem_cgroup_remove_from_trees(mem);
+
 	for_each_node_state(node, N_POSSIBLE)
 		free_mem_cgroup_per_zone_info(mem, node);
 
@@ -2210,6 +2827,39 @@ static void __init enable_swap_cgroup(void)
 }
 #endif
 
+static int mem_cgroup_soft_limit_tree_init(void)
+{
+	struct mem_cgroup_tree_per_node *rtpn;
+	struct mem_cgroup_tree_per_zone *rtpz;
+	int tmp, node, zone;
+
+	for_each_node_state(node, N_POSSIBLE) {
+		tmp = node;
+		if (!node_state(node, N_NORMAL_MEMORY))
+			tmp = -1;
+		rtpn = kmalloc_node(sizeof(*rtpn), GFP_KERNEL, tmp);
+		if (!rtpn)
+			goto err_cleanup;
+
+		soft_limit_tree.rb_tree_per_node[node] = rtpn;
+		for (zone = 0; zone < MAX_NR_ZONES; zone++) {
+			rtpz = &rtpn->rb_tree_per_zone[zone];
+			rtpz->rb_root = RB_ROOT;
+			spin_lock_init(&rtpz->lock);
+		}
+	}
+	return 0;
+
+err_cleanup:
+	for_each_node_state(node, N_POSSIBLE) {
+		if (!soft_limit_tree.rb_tree_per_node[node])
+			break;
+		kfree(soft_limit_tree.rb_tree_per_node[node]);
+		soft_limit_tree.rb_tree_per_node[node] = NULL;
+	}
+	return 1;
+}
+
 static struct cgroup_subsys_state * __ref
 mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 {
@@ -2225,8 +2875,17 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 			goto free_out;
 	/* root ? */
 	if (cont->parent == NULL) {
+		int cpu;
+
 		enable_swap_cgroup();
 		parent = NULL;
+		if (mem_cgroup_soft_limit_tree_init())
+			goto free_out;
+		for_each_possible_cpu(cpu)
+			INIT_WORK(&per_cpu(memcg_stock, cpu).work,
+				  drain_local_stock);
+		hotcpu_notifier(memcg_stock_cpu_callback, 0);
+		root_mem_cgroup = mem;
 	} else {
 		parent = mem_cgroup_from_cont(cont->parent);
 		mem->use_hierarchy = parent->use_hierarchy;
@@ -2241,6 +2900,8 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	}
 	mem->last_scanned_child = NULL;
 	spin_lock_init(&mem->reclaim_param_lock);
+	vmpressure_init(&mem->vmpressure);
+	memstall_group_init(&mem->stall);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -2264,6 +2925,9 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 	struct mem_cgroup *last_scanned_child = mem->last_scanned_child;
 
+	vmpressure_cleanup(&mem->vmpressure);
+	memstall_group_cleanup(&mem->stall);
+
 	if (last_scanned_child) {
 		VM_BUG_ON(!mem_cgroup_is_obsolete(last_scanned_child));
 		mem_cgroup_put(last_scanned_child);
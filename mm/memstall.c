@@ -0,0 +1,362 @@
+/*
+ * mm/memstall.c - memory stall accounting
+ *
+ * Allocation failures are a late sign of memory shortage: long before
+ * the OOM killer runs, tasks spend more and more of their time in direct
+ * reclaim and compaction, and waiting for pages of their working set that
+ * were just evicted to be read back in.  This accounts that time.
+ *
+ * A group is stalled while at least one of its tasks is, so its stall
+ * time is the wall clock time during which some of its work could not
+ * make progress for lack of memory.  It is kept for the whole system,
+ * exported in /proc/pressure/memory, and for every memory cgroup, in
+ * memory.stall, a cgroup also counting the stalls of its descendants.
+ *
+ * Userspace can register an eventfd with a threshold and a window: it is
+ * signalled once per window in which the group was stalled for at least
+ * the threshold, which lets a node agent act before the machine locks up
+ * in reclaim.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/eventfd.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/memcontrol.h>
+#include <linux/memstall.h>
+#include <asm/div64.h>
+#include <asm/uaccess.h>
+
+/* Trigger windows, in us */
+#define MEMSTALL_WINDOW_MIN	(500 * USEC_PER_MSEC)
+#define MEMSTALL_WINDOW_MAX	(10 * USEC_PER_SEC)
+
+/* Triggers per group */
+#define MEMSTALL_MAX_TRIGGERS	64
+
+struct memstall_trigger {
+	struct file *efile;
+	u64 threshold;		/* ns of stall per window to fire */
+	u64 window;		/* ns */
+	u64 win_start;
+	u64 win_total;		/* ns of stall in the current window */
+	int fired;		/* already signalled in this window */
+	struct list_head node;
+};
+
+static struct memstall_group memstall_global = {
+	.lock		= __SPIN_LOCK_UNLOCKED(memstall_global.lock),
+	.triggers	= LIST_HEAD_INIT(memstall_global.triggers),
+};
+
+void memstall_group_init(struct memstall_group *grp)
+{
+	spin_lock_init(&grp->lock);
+	grp->nr_stalled = 0;
+	grp->start = 0;
+	grp->total = 0;
+	INIT_LIST_HEAD(&grp->triggers);
+}
+
+/*
+ * Add a finished stall period of @delta ns to the trigger windows and
+ * signal the triggers that crossed their threshold.  Called with the
+ * group lock held.
+ */
+static void memstall_update_triggers(struct memstall_group *grp,
+				     u64 now, u64 delta)
+{
+	struct memstall_trigger *t;
+
+	list_for_each_entry(t, &grp->triggers, node) {
+		if (now - t->win_start >= t->window) {
+			t->win_start = now;
+			t->win_total = 0;
+			t->fired = 0;
+		}
+		t->win_total += delta;
+		if (!t->fired && t->win_total >= t->threshold) {
+			eventfd_signal(t->efile, 1);
+			t->fired = 1;
+		}
+	}
+}
+
+void memstall_group_enter(struct memstall_group *grp, u64 now)
+{
+	spin_lock(&grp->lock);
+	if (!grp->nr_stalled++)
+		grp->start = now;
+	spin_unlock(&grp->lock);
+}
+
+void memstall_group_leave(struct memstall_group *grp, u64 now)
+{
+	u64 delta;
+
+	spin_lock(&grp->lock);
+	if (!--grp->nr_stalled) {
+		delta = now - grp->start;
+		grp->total += delta;
+		memstall_update_triggers(grp, now, delta);
+	}
+	spin_unlock(&grp->lock);
+}
+
+/*
+ * Stall time of the group in ns, including the stall that is still
+ * going on.
+ */
+u64 memstall_group_total(struct memstall_group *grp)
+{
+	u64 now = ktime_to_ns(ktime_get());
+	u64 total;
+
+	spin_lock(&grp->lock);
+	total = grp->total;
+	if (grp->nr_stalled)
+		total += now - grp->start;
+	spin_unlock(&grp->lock);
+
+	return total;
+}
+
+/*
+ * Unlink the triggers whose eventfd was closed: once userspace closed it,
+ * we hold the only reference left.  An eventfd that other groups watch
+ * as well stays until it is unregistered with "none".  Called with the
+ * group lock held, the files are put by the caller.
+ */
+static void memstall_reap_triggers(struct memstall_group *grp,
+				   struct list_head *dead)
+{
+	struct memstall_trigger *t, *tmp;
+
+	list_for_each_entry_safe(t, tmp, &grp->triggers, node)
+		if (file_count(t->efile) == 1)
+			list_move(&t->node, dead);
+}
+
+/*
+ * Return the trigger of @efile, if any, and count all triggers in @nr.
+ * Called with the group lock held.
+ */
+static struct memstall_trigger *
+memstall_find_trigger(struct memstall_group *grp, struct file *efile,
+		      unsigned int *nr)
+{
+	struct memstall_trigger *t, *found = NULL;
+
+	*nr = 0;
+	list_for_each_entry(t, &grp->triggers, node) {
+		if (t->efile == efile)
+			found = t;
+		(*nr)++;
+	}
+	return found;
+}
+
+static void memstall_free_triggers(struct list_head *list)
+{
+	struct memstall_trigger *t, *tmp;
+
+	list_for_each_entry_safe(t, tmp, list, node) {
+		list_del(&t->node);
+		fput(t->efile);
+		kfree(t);
+	}
+}
+
+/**
+ * memstall_register_trigger - register a stall listener
+ * @grp: stall group to watch
+ * @args: "<eventfd> <stall us> <window us>" or "<eventfd> none"
+ *
+ * The eventfd is signalled once in every window during which the group
+ * was stalled for at least the given time.  The window has to be between
+ * 500ms and 10s.  An eventfd has at most one trigger per group: writing
+ * it again replaces the trigger, "none" removes it.  Otherwise it goes
+ * away when the eventfd is closed and no other group watches it.
+ */
+int memstall_register_trigger(struct memstall_group *grp, const char *args)
+{
+	struct memstall_trigger *t, *new = NULL;
+	unsigned long long threshold, window;
+	struct file *efile;
+	unsigned int nr;
+	LIST_HEAD(dead);
+	char *end;
+	int efd;
+	int ret = 0;
+
+	efd = simple_strtol(args, &end, 10);
+	if (end == args || *end != ' ')
+		return -EINVAL;
+	while (*end == ' ')
+		end++;
+
+	if (strcmp(end, "none")) {
+		if (sscanf(end, "%llu %llu", &threshold, &window) != 2)
+			return -EINVAL;
+		if (window < MEMSTALL_WINDOW_MIN ||
+		    window > MEMSTALL_WINDOW_MAX)
+			return -EINVAL;
+		if (!threshold || threshold > window)
+			return -EINVAL;
+	}
+
+	efile = eventfd_fget(efd);
+	if (IS_ERR(efile))
+		return PTR_ERR(efile);
+
+	if (strcmp(end, "none")) {
+		new = kmalloc(sizeof(*new), GFP_KERNEL);
+		if (!new) {
+			fput(efile);
+			return -ENOMEM;
+		}
+		new->efile = efile;
+		new->threshold = threshold * NSEC_PER_USEC;
+		new->window = window * NSEC_PER_USEC;
+		new->win_start = ktime_to_ns(ktime_get());
+		new->win_total = 0;
+		new->fired = 0;
+	}
+
+	spin_lock(&grp->lock);
+	memstall_reap_triggers(grp, &dead);
+	t = memstall_find_trigger(grp, efile, &nr);
+	if (t) {
+		/* the old trigger's reference is put with the dead ones */
+		list_move(&t->node, &dead);
+		nr--;
+	}
+	if (!new) {
+		if (!t)
+			ret = -ENOENT;
+	} else if (nr >= MEMSTALL_MAX_TRIGGERS) {
+		ret = -ENOSPC;
+	} else {
+		list_add(&new->node, &grp->triggers);
+		new = NULL;
+		efile = NULL;
+	}
+	spin_unlock(&grp->lock);
+
+	memstall_free_triggers(&dead);
+	kfree(new);
+	if (efile)
+		fput(efile);
+	return ret;
+}
+
+/* Called when the group goes away: drop all listeners. */
+void memstall_group_cleanup(struct memstall_group *grp)
+{
+	LIST_HEAD(dead);
+
+	spin_lock(&grp->lock);
+	list_splice_init(&grp->triggers, &dead);
+	spin_unlock(&grp->lock);
+
+	memstall_free_triggers(&dead);
+}
+
+/**
+ * memstall_enter - mark the beginning of a memory stall
+ * @ms: cookie to hand to memstall_leave()
+ *
+ * The time until the matching memstall_leave() is accounted as stall
+ * time of the system and of the memory cgroup of the current task.
+ * Sections may nest, only the outermost one counts.
+ */
+void memstall_enter(struct memstall *ms)
+{
+	u64 now;
+
+	ms->nested = current->flags & PF_MEMSTALL;
+	if (ms->nested)
+		return;
+	current->flags |= PF_MEMSTALL;
+
+	now = ktime_to_ns(ktime_get());
+	memstall_group_enter(&memstall_global, now);
+	ms->memcg = mem_cgroup_memstall_enter(now);
+}
+
+/**
+ * memstall_leave - mark the end of a memory stall
+ * @ms: cookie that was passed to memstall_enter()
+ */
+void memstall_leave(struct memstall *ms)
+{
+	u64 now;
+
+	if (ms->nested)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	mem_cgroup_memstall_leave(ms->memcg, now);
+	memstall_group_leave(&memstall_global, now);
+
+	current->flags &= ~PF_MEMSTALL;
+}
+
+#ifdef CONFIG_PROC_FS
+static int memstall_proc_show(struct seq_file *m, void *v)
+{
+	u64 total = memstall_group_total(&memstall_global);
+
+	do_div(total, NSEC_PER_USEC);
+	seq_printf(m, "some total=%llu\n", (unsigned long long)total);
+	return 0;
+}
+
+static int memstall_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, memstall_proc_show, NULL);
+}
+
+static ssize_t memstall_proc_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	char buf[64];
+	int ret;
+
+	if (!count || count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	ret = memstall_register_trigger(&memstall_global, strstrip(buf));
+	return ret ? ret : count;
+}
+
+static const struct file_operations memstall_proc_fops = {
+	.open		= memstall_proc_open,
+	.read		= seq_read,
+	.write		= memstall_proc_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init memstall_proc_init(void)
+{
+	struct proc_dir_entry *dir;
+
+	dir = proc_mkdir("pressure", NULL);
+	if (dir)
+		proc_create("memory", S_IRUGO | S_IWUSR, dir,
+			    &memstall_proc_fops);
+	return 0;
+}
+module_init(memstall_proc_init);
+#endif /* CONFIG_PROC_FS */
@@ -27,6 +27,7 @@
 #include <linux/notifier.h>
 #include <linux/memcontrol.h>
 #include <linux/security.h>
+#include <linux/math64.h>
 
 int sysctl_panic_on_oom;
 int sysctl_oom_kill_allocating_task;
@@ -37,27 +38,31 @@ static DEFINE_SPINLOCK(zone_scan_lock);
 /**
  * badness - calculate a numeric value for how bad this task has been
  * @p: task struct of which task we should calculate
- * @uptime: current uptime in seconds
+ * @totalpages: the memory @p competes for, see oom_total_pages()
  *
- * The formula used is relatively simple and documented inline in the
- * function. The main rationale is that we want to select a good task
- * to kill when we run out of memory.
+ * The badness is the share of @totalpages that killing the task would
+ * free, its resident set and page tables, in thousandths.  It is then
+ * adjusted by the task's oom_score_adj, which is in the same unit: an
+ * oom_score_adj of 500 makes the task look as if it used half of the
+ * memory more than it does, one of -500 as if it used half of it less.
  *
- * Good in this context means that:
- * 1) we lose the minimum amount of work done
- * 2) we recover a large amount of memory
- * 3) we don't kill anything innocent of eating tons of memory
- * 4) we want to kill the minimum amount of processes (one)
- * 5) we try to kill the process the user expects us to kill, this
- *    algorithm has been meticulously tuned to meet the principle
- *    of least surprise ... (be careful when you change it)
+ * Keeping the score linear in the memory used lets userspace reason about
+ * it: the kill order it sets up through oom_score_adj holds no matter how
+ * large the machine or the cgroup is, and the same score can be computed
+ * from /proc to kill proactively, before the kernel runs out of memory.
+ *
+ * A task with an oom_score_adj of OOM_SCORE_ADJ_MIN scores 0 and is never
+ * killed, every other task scores at least 1.
  */
-
-unsigned long badness(struct task_struct *p, unsigned long uptime)
+unsigned long badness(struct task_struct *p, unsigned long totalpages)
 {
-	unsigned long points, cpu_time, run_time, s;
+	long points;
+	u64 pages;
+	int adj = p->oom_score_adj;
 	struct mm_struct *mm;
-	struct task_struct *child;
+
+	if (adj == OOM_SCORE_ADJ_MIN)
+		return 0;
 
 	task_lock(p);
 	mm = p->mm;
@@ -67,9 +72,10 @@ unsigned long badness(struct task_struct *p, unsigned long uptime)
 	}
 
 	/*
-	 * The memory size of the process is the basis for the badness.
+	 * The memory killing the task gives back is the basis for the
+	 * badness.
 	 */
-	points = mm->total_vm;
+	pages = get_mm_rss(mm) + mm->nr_ptes;
 
 	/*
 	 * After this unlock we can no longer dereference local variable `mm'
@@ -82,90 +88,39 @@ unsigned long badness(struct task_struct *p, unsigned long uptime)
 	if (p->flags & PF_SWAPOFF)
 		return ULONG_MAX;
 
-	/*
-	 * Processes which fork a lot of child processes are likely
-	 * a good choice. We add half the vmsize of the children if they
-	 * have an own mm. This prevents forking servers to flood the
-	 * machine with an endless amount of children. In case a single
-	 * child is eating the vast majority of memory, adding only half
-	 * to the parents will make the child our kill candidate of choice.
-	 */
-	list_for_each_entry(child, &p->children, sibling) {
-		task_lock(child);
-		if (child->mm != mm && child->mm)
-			points += child->mm->total_vm/2 + 1;
-		task_unlock(child);
-	}
-
-	/*
-	 * CPU time is in tens of seconds and run time is in thousands
-         * of seconds. There is no particular reason for this other than
-         * that it turned out to work very well in practice.
-	 */
-	cpu_time = (cputime_to_jiffies(p->utime) + cputime_to_jiffies(p->stime))
-		>> (SHIFT_HZ + 3);
-
-	if (uptime >= p->start_time.tv_sec)
-		run_time = (uptime - p->start_time.tv_sec) >> 10;
-	else
-		run_time = 0;
-
-	s = int_sqrt(cpu_time);
-	if (s)
-		points /= s;
-	s = int_sqrt(int_sqrt(run_time));
-	if (s)
-		points /= s;
-
-	/*
-	 * Niced processes are most likely less important, so double
-	 * their badness points.
-	 */
-	if (task_nice(p) > 0)
-		points *= 2;
-
-	/*
-	 * Superuser processes are usually more important, so we make it
-	 * less likely that we kill those.
-	 */
-	if (has_capability_noaudit(p, CAP_SYS_ADMIN) ||
-	    has_capability_noaudit(p, CAP_SYS_RESOURCE))
-		points /= 4;
-
-	/*
-	 * We don't want to kill a process with direct hardware access.
-	 * Not only could that mess up the hardware, but usually users
-	 * tend to only have this flag set on applications they think
-	 * of as important.
-	 */
-	if (has_capability_noaudit(p, CAP_SYS_RAWIO))
-		points /= 4;
+	points = div64_u64(pages * 1000, max(totalpages, 1UL));
 
 	/*
-	 * If p's nodes don't overlap ours, it may still help to kill p
-	 * because p may have allocated or otherwise mapped memory on
-	 * this node before. However it will be less likely.
+	 * Superuser processes are usually more important, so they get a
+	 * bonus of 3% of the memory.
 	 */
-	if (!cpuset_mems_allowed_intersects(current, p))
-		points /= 8;
+	if (has_capability_noaudit(p, CAP_SYS_ADMIN))
+		points -= 30;
 
-	/*
-	 * Adjust the score by oomkilladj.
-	 */
-	if (p->oomkilladj) {
-		if (p->oomkilladj > 0) {
-			if (!points)
-				points = 1;
-			points <<= p->oomkilladj;
-		} else
-			points >>= -(p->oomkilladj);
-	}
+	points += adj;
 
 #ifdef DEBUG
-	printk(KERN_DEBUG "OOMkill: task %d (%s) got %lu points\n",
+	printk(KERN_DEBUG "OOMkill: task %d (%s) got %ld points\n",
 	p->pid, p->comm, points);
 #endif
-	return points;
+	return points > 0 ? points : 1;
+}
+
+/*
+ * The memory tasks compete for when it runs out: RAM and swap for the
+ * whole system, or the limit of the memory cgroup @mem.
+ */
+unsigned long oom_total_pages(struct mem_cgroup *mem)
+{
+	unsigned long totalpages = totalram_pages + total_swap_pages;
+	u64 limit;
+
+	if (mem) {
+		limit = mem_cgroup_get_limit(mem) >> PAGE_SHIFT;
+		if (limit < totalpages)
+			totalpages = limit;
+	}
+	return totalpages;
 }
 
 /*
@@ -204,10 +159,9 @@ static struct task_struct *select_bad_process(unsigned long *ppoints,
 {
 	struct task_struct *g, *p;
 	struct task_struct *chosen = NULL;
-	struct timespec uptime;
+	unsigned long totalpages = oom_total_pages(mem);
 	*ppoints = 0;
 
-	do_posix_clock_monotonic_gettime(&uptime);
 	do_each_thread(g, p) {
 		unsigned long points;
 
@@ -222,6 +176,13 @@ static struct task_struct *select_bad_process(unsigned long *ppoints,
 			continue;
 		if (mem && !task_in_mem_cgroup(p, mem))
 			continue;
+		/*
+		 * badness() only looks at how much memory a task uses, not
+		 * where: a task whose memory is on nodes we cannot allocate
+		 * from would not help.
+		 */
+		if (!mem && !cpuset_mems_allowed_intersects(current, p))
+			continue;
 
 		/*
 		 * This task already has access to memory reserves and is
@@ -253,10 +214,10 @@ static struct task_struct *select_bad_process(unsigned long *ppoints,
 			*ppoints = ULONG_MAX;
 		}
 
-		if (p->oomkilladj == OOM_DISABLE)
+		if (p->oom_score_adj == OOM_SCORE_ADJ_MIN)
 			continue;
 
-		points = badness(p, uptime.tv_sec);
+		points = badness(p, totalpages);
 		if (points > *ppoints || !chosen) {
 			chosen = p;
 			*ppoints = points;
@@ -272,7 +233,7 @@ static struct task_struct *select_bad_process(unsigned long *ppoints,
  *
  * Dumps the current memory state of all system tasks, excluding kernel threads.
  * State information includes task's pid, uid, tgid, vm size, rss, cpu, oom_adj
- * score, and name.
+ * and oom_score_adj scores, and name.
  *
  * If the actual is non-NULL, only tasks that are a member of the mem_cgroup are
  * shown.
@@ -284,7 +245,7 @@ static void dump_tasks(const struct mem_cgroup *mem)
 	struct task_struct *g, *p;
 
 	printk(KERN_INFO "[ pid ]   uid  tgid total_vm      rss cpu oom_adj "
-	       "name\n");
+	       "oom_score_adj name\n");
 	do_each_thread(g, p) {
 		/*
 		 * total_vm and rss sizes do not exist for tasks with a
@@ -298,10 +259,10 @@ static void dump_tasks(const struct mem_cgroup *mem)
 			continue;
 
 		task_lock(p);
-		printk(KERN_INFO "[%5d] %5d %5d %8lu %8lu %3d     %3d %s\n",
+		printk(KERN_INFO "[%5d] %5d %5d %8lu %8lu %3d     %3d         %5d %s\n",
 		       p->pid, __task_cred(p)->uid, p->tgid,
 		       p->mm->total_vm, get_mm_rss(p->mm), (int)task_cpu(p),
-		       p->oomkilladj, p->comm);
+		       p->oomkilladj, p->oom_score_adj, p->comm);
 		task_unlock(p);
 	} while_each_thread(g, p);
 }
@@ -360,10 +321,10 @@ static int oom_kill_task(struct task_struct *p)
 		return 1;
 
 	/*
-	 * Don't kill the process if any threads are set to OOM_DISABLE
+	 * Don't kill the process if any threads are set to OOM_SCORE_ADJ_MIN
 	 */
 	do_each_thread(g, q) {
-		if (q->mm == mm && q->oomkilladj == OOM_DISABLE)
+		if (q->mm == mm && q->oom_score_adj == OOM_SCORE_ADJ_MIN)
 			return 1;
 	} while_each_thread(g, q);
 
@@ -390,8 +351,8 @@ static int oom_kill_process(struct task_struct *p, gfp_t gfp_mask, int order,
 
 	if (printk_ratelimit()) {
 		printk(KERN_WARNING "%s invoked oom-killer: "
-			"gfp_mask=0x%x, order=%d, oomkilladj=%d\n",
-			current->comm, gfp_mask, order, current->oomkilladj);
+			"gfp_mask=0x%x, order=%d, oom_score_adj=%d\n",
+			current->comm, gfp_mask, order, current->oom_score_adj);
 		task_lock(current);
 		cpuset_print_task_mems_allowed(current);
 		task_unlock(current);
@@ -46,6 +46,8 @@
 #include <linux/page-isolation.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
+#include <linux/compaction.h>
+#include <linux/memstall.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -77,6 +79,7 @@ int pageblock_order __read_mostly;
 #endif
 
 static void __free_pages_ok(struct page *page, unsigned int order);
+static void free_hot_cold_page(struct page *page, unsigned int order, int cold);
 
 /*
  * results with 256, 32 in the lowmem_reserve sysctl:
@@ -278,7 +281,12 @@ out:
 
 static void free_compound_page(struct page *page)
 {
-	__free_pages_ok(page, compound_order(page));
+	unsigned int order = compound_order(page);
+
+	if (order <= PCP_MAX_ORDER)
+		free_hot_cold_page(page, order, 0);
+	else
+		__free_pages_ok(page, order);
 }
 
 void prep_compound_page(struct page *page, unsigned long order)
@@ -506,9 +514,11 @@ static inline int free_pages_check(struct page *page)
 }
 
 /*
- * Frees a list of pages. 
- * Assumes all pages on list are in same zone, and of same order.
- * count is the number of pages to free.
+ * Frees pages from the per-cpu lists of a zone.
+ * count is the number of base pages to free; the lists are emptied
+ * round-robin, one block of each order at a time, so that no order is
+ * starved of pages the others hoard.  Higher order blocks may free a
+ * few pages more than asked for.
  *
  * If the zone was previously in an "all pages pinned" state then look to
  * see if this freeing clears that state.
@@ -516,20 +526,30 @@ static inline int free_pages_check(struct page *page)
  * And clear the zone's pages_scanned counter, to hold off the "all pages are
  * pinned" detection logic.
  */
-static void free_pages_bulk(struct zone *zone, int count,
-					struct list_head *list, int order)
+static void free_pcppages_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
 {
+	int order = 0;
+
 	spin_lock(&zone->lock);
 	zone_clear_flag(zone, ZONE_ALL_UNRECLAIMABLE);
 	zone->pages_scanned = 0;
-	while (count--) {
+	while (count > 0 && pcp->count > 0) {
 		struct page *page;
+		struct list_head *list;
+
+		do {
+			if (++order == NR_PCP_LISTS)
+				order = 0;
+			list = &pcp->lists[order];
+		} while (list_empty(list));
 
-		VM_BUG_ON(list_empty(list));
 		page = list_entry(list->prev, struct page, lru);
 		/* have to delete it as __free_one_page list manipulates */
 		list_del(&page->lru);
 		__free_one_page(page, zone, order);
+		pcp->count -= 1 << order;
+		count -= 1 << order;
 	}
 	spin_unlock(&zone->lock);
 }
@@ -897,15 +917,9 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 {
 	unsigned long flags;
-	int to_drain;
 
 	local_irq_save(flags);
-	if (pcp->count >= pcp->batch)
-		to_drain = pcp->batch;
-	else
-		to_drain = pcp->count;
-	free_pages_bulk(zone, to_drain, &pcp->list, 0);
-	pcp->count -= to_drain;
+	free_pcppages_bulk(zone, pcp->batch, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -933,8 +947,7 @@ static void drain_pages(unsigned int cpu)
 
 		pcp = &pset->pcp;
 		local_irq_save(flags);
-		free_pages_bulk(zone, pcp->count, &pcp->list, 0);
-		pcp->count = 0;
+		free_pcppages_bulk(zone, pcp->count, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -992,51 +1005,99 @@ void mark_free_pages(struct zone *zone)
 #endif /* CONFIG_PM */
 
 /*
- * Free a 0-order page
+ * While the zone is short of free pages, pages sitting on the per-cpu
+ * lists are better off in the buddy allocator, where reclaim and
+ * high-order allocations can see them: keep no more than a few batches.
  */
-static void free_hot_cold_page(struct page *page, int cold)
+static int nr_pcp_high(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	if (zone_page_state(zone, NR_FREE_PAGES) < zone->pages_low)
+		return min(pcp->high, pcp->batch << 2);
+	return pcp->high;
+}
+
+/*
+ * Number of pages to hand back to the buddy allocator once the lists
+ * are above @high.  A CPU that keeps freeing without allocating, like
+ * one tearing down a large process, is not going to reuse the pages:
+ * double the batch on every such round so it takes zone->lock less
+ * often, but always leave a batch on the lists.
+ */
+static int nr_pcp_free(struct per_cpu_pages *pcp, int high)
+{
+	int max_nr_free = high - pcp->batch;
+	int batch;
+
+	if (max_nr_free <= pcp->batch)
+		return pcp->batch;
+
+	batch = min(pcp->batch << pcp->free_factor, max_nr_free);
+	if (batch < max_nr_free)
+		pcp->free_factor++;
+	return batch;
+}
+
+/*
+ * Free a page of order up to PCP_MAX_ORDER to the per-cpu lists
+ */
+static void free_hot_cold_page(struct page *page, unsigned int order, int cold)
 {
 	struct zone *zone = page_zone(page);
 	struct per_cpu_pages *pcp;
+	struct list_head *list;
 	unsigned long flags;
+	int i, bad = 0;
+	int high;
+
+	/*
+	 * The block sits on the pcp list until it is handed out again,
+	 * so it must not carry head/tail state into prep_new_page().
+	 */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
 
 	if (PageAnon(page))
 		page->mapping = NULL;
-	if (free_pages_check(page))
+	for (i = 0; i < (1 << order); i++)
+		bad += free_pages_check(page + i);
+	if (bad)
 		return;
 
 	if (!PageHighMem(page)) {
-		debug_check_no_locks_freed(page_address(page), PAGE_SIZE);
-		debug_check_no_obj_freed(page_address(page), PAGE_SIZE);
+		debug_check_no_locks_freed(page_address(page),
+					   PAGE_SIZE << order);
+		debug_check_no_obj_freed(page_address(page),
+					 PAGE_SIZE << order);
 	}
-	arch_free_page(page, 0);
-	kernel_map_pages(page, 1, 0);
+	arch_free_page(page, order);
+	kernel_map_pages(page, 1 << order, 0);
 
 	pcp = &zone_pcp(zone, get_cpu())->pcp;
+	list = &pcp->lists[order];
 	local_irq_save(flags);
-	__count_vm_event(PGFREE);
+	__count_vm_events(PGFREE, 1 << order);
 	if (cold)
-		list_add_tail(&page->lru, &pcp->list);
+		list_add_tail(&page->lru, list);
 	else
-		list_add(&page->lru, &pcp->list);
+		list_add(&page->lru, list);
 	set_page_private(page, get_pageblock_migratetype(page));
-	pcp->count++;
-	if (pcp->count >= pcp->high) {
-		free_pages_bulk(zone, pcp->batch, &pcp->list, 0);
-		pcp->count -= pcp->batch;
-	}
+	pcp->count += 1 << order;
+	high = nr_pcp_high(zone, pcp);
+	if (pcp->count >= high)
+		free_pcppages_bulk(zone, nr_pcp_free(pcp, high), pcp);
 	local_irq_restore(flags);
 	put_cpu();
 }
 
 void free_hot_page(struct page *page)
 {
-	free_hot_cold_page(page, 0);
+	free_hot_cold_page(page, 0, 0);
 }
 	
 void free_cold_page(struct page *page)
 {
-	free_hot_cold_page(page, 1);
+	free_hot_cold_page(page, 0, 1);
 }
 
 /*
@@ -1057,6 +1118,60 @@ void split_page(struct page *page, unsigned int order)
 		set_page_refcounted(page + i);
 }
 
+/*
+ * Similar to split_page except the page is already free. As this is only
+ * being used for migration, the migratetype of the block also changes.
+ * As this is called with interrupts disabled, the caller is responsible
+ * for calling arch_alloc_page() and kernel_map_page() after interrupts
+ * are enabled.
+ *
+ * Note: this is probably too low level an operation for use in drivers.
+ * Please consult with lkml before using this in your driver.
+ */
+int split_free_page(struct page *page)
+{
+	unsigned int order;
+	unsigned long watermark;
+	struct zone *zone;
+
+	BUG_ON(!PageBuddy(page));
+
+	zone = page_zone(page);
+	order = page_order(page);
+
+	/* Obey watermarks as if the page was being allocated */
+	watermark = zone->pages_low + (1 << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return 0;
+
+	/* Remove page from free list */
+	list_del(&page->lru);
+	zone->free_area[order].nr_free--;
+	rmv_page_order(page);
+	__mod_zone_page_state(zone, NR_FREE_PAGES, -(1UL << order));
+
+	/* Split into individual pages */
+	set_page_refcounted(page);
+	split_page(page, order);
+
+	if (order >= pageblock_order - 1) {
+		struct page *endpage = page + (1 << order) - 1;
+		for (; page < endpage; page += pageblock_nr_pages)
+			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+	}
+
+	return 1 << order;
+}
+
+/*
+ * Number of blocks of @order to move from the buddy allocator to the
+ * per-cpu lists when they run empty: a batch worth of pages.
+ */
+static inline int nr_pcp_alloc(struct per_cpu_pages *pcp, int order)
+{
+	return max(pcp->batch >> order, 1);
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1073,38 +1188,44 @@ static struct page *buffered_rmqueue(struct zone *preferred_zone,
 
 again:
 	cpu  = get_cpu();
-	if (likely(order == 0)) {
+	if (likely(order <= PCP_MAX_ORDER)) {
 		struct per_cpu_pages *pcp;
+		struct list_head *list;
 
 		pcp = &zone_pcp(zone, cpu)->pcp;
+		list = &pcp->lists[order];
 		local_irq_save(flags);
-		if (!pcp->count) {
-			pcp->count = rmqueue_bulk(zone, 0,
-					pcp->batch, &pcp->list, migratetype);
-			if (unlikely(!pcp->count))
+		if (list_empty(list)) {
+			pcp->count += rmqueue_bulk(zone, order,
+					nr_pcp_alloc(pcp, order), list,
+					migratetype) << order;
+			if (unlikely(list_empty(list)))
 				goto failed;
 		}
 
 		/* Find a page of the appropriate migrate type */
 		if (cold) {
-			list_for_each_entry_reverse(page, &pcp->list, lru)
+			list_for_each_entry_reverse(page, list, lru)
 				if (page_private(page) == migratetype)
 					break;
 		} else {
-			list_for_each_entry(page, &pcp->list, lru)
+			list_for_each_entry(page, list, lru)
 				if (page_private(page) == migratetype)
 					break;
 		}
 
 		/* Allocate more to the pcp list if necessary */
-		if (unlikely(&page->lru == &pcp->list)) {
-			pcp->count += rmqueue_bulk(zone, 0,
-					pcp->batch, &pcp->list, migratetype);
-			page = list_entry(pcp->list.next, struct page, lru);
+		if (unlikely(&page->lru == list)) {
+			pcp->count += rmqueue_bulk(zone, order,
+					nr_pcp_alloc(pcp, order), list,
+					migratetype) << order;
+			page = list_entry(list->next, struct page, lru);
 		}
 
 		list_del(&page->lru);
-		pcp->count--;
+		pcp->count -= 1 << order;
+		/* The CPU allocates again: freed pages are likely reused */
+		pcp->free_factor >>= 1;
 	} else {
 		spin_lock_irqsave(&zone->lock, flags);
 		page = __rmqueue(zone, order, migratetype);
@@ -1460,6 +1581,71 @@ try_next_zone:
 	return page;
 }
 
+#ifdef CONFIG_COMPACTION
+/* Try memory compaction for high-order allocations before reclaim */
+static struct page *
+__alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
+	struct zonelist *zonelist, enum zone_type high_zoneidx,
+	nodemask_t *nodemask, int alloc_flags)
+{
+	struct task_struct *p = current;
+	struct zone *preferred_zone;
+	struct page *page;
+	unsigned long compact_result;
+	struct memstall ms;
+
+	if (!order)
+		return NULL;
+
+	(void)first_zones_zonelist(zonelist, high_zoneidx, nodemask,
+							&preferred_zone);
+	if (!preferred_zone || compaction_deferred(preferred_zone))
+		return NULL;
+
+	memstall_enter(&ms);
+	p->flags |= PF_MEMALLOC;
+	compact_result = try_to_compact_pages(zonelist, order, gfp_mask,
+						nodemask);
+	p->flags &= ~PF_MEMALLOC;
+	memstall_leave(&ms);
+	if (compact_result == COMPACT_SKIPPED)
+		return NULL;
+
+	/* Pages migrated to this cpu's free lists are not merged yet */
+	drain_pages(get_cpu());
+	put_cpu();
+
+	page = get_page_from_freelist(gfp_mask, nodemask, order, zonelist,
+					high_zoneidx, alloc_flags);
+	if (page) {
+		preferred_zone->compact_considered = 0;
+		preferred_zone->compact_defer_shift = 0;
+		count_vm_event(COMPACTSUCCESS);
+		return page;
+	}
+
+	/*
+	 * It's bad if compaction run occurs and fails.
+	 * The most likely reason is that pages exist,
+	 * but not enough to satisfy watermarks.
+	 */
+	count_vm_event(COMPACTFAIL);
+	defer_compaction(preferred_zone);
+
+	cond_resched();
+
+	return NULL;
+}
+#else
+static inline struct page *
+__alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
+	struct zonelist *zonelist, enum zone_type high_zoneidx,
+	nodemask_t *nodemask, int alloc_flags)
+{
+	return NULL;
+}
+#endif /* CONFIG_COMPACTION */
+
 /*
  * This is the 'heart' of the zoned buddy allocator.
  */
@@ -1571,6 +1757,15 @@ nofail_alloc:
 
 	cond_resched();
 
+	/*
+	 * Try direct compaction first: moving pages together may produce
+	 * the high-order block without evicting any of the working set.
+	 */
+	page = __alloc_pages_direct_compact(gfp_mask, order, zonelist,
+					high_zoneidx, nodemask, alloc_flags);
+	if (page)
+		goto got_pg;
+
 	/* We now go into synchronous reclaim */
 	cpuset_memory_pressure_bump();
 	/*
@@ -1709,14 +1904,14 @@ void __pagevec_free(struct pagevec *pvec)
 	int i = pagevec_count(pvec);
 
 	while (--i >= 0)
-		free_hot_cold_page(pvec->pages[i], pvec->cold);
+		free_hot_cold_page(pvec->pages[i], 0, pvec->cold);
 }
 
 void __free_pages(struct page *page, unsigned int order)
 {
 	if (put_page_testzero(page)) {
-		if (order == 0)
-			free_hot_page(page);
+		if (order <= PCP_MAX_ORDER)
+			free_hot_cold_page(page, order, 0);
 		else
 			__free_pages_ok(page, order);
 	}
@@ -2720,6 +2915,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
+	int order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -2727,7 +2923,8 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
-	INIT_LIST_HEAD(&pcp->list);
+	for (order = 0; order < NR_PCP_LISTS; order++)
+		INIT_LIST_HEAD(&pcp->lists[order]);
 }
 
 /*
@@ -3527,6 +3724,7 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 		zone->reclaim_stat.recent_rotated[1] = 0;
 		zone->reclaim_stat.recent_scanned[0] = 0;
 		zone->reclaim_stat.recent_scanned[1] = 0;
+		lru_gen_init_zone(zone);
 		zap_zone_vm_stats(zone);
 		zone->flags = 0;
 		if (!size)
@@ -750,12 +750,121 @@ void page_remove_rmap(struct page *page)
 	}
 }
 
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+/**
+ * try_to_unmap_flush - flush the TLB entries reclaim left behind
+ *
+ * try_to_unmap() with TTU_BATCH_FLUSH clears ptes without flushing the
+ * TLB: instead of an IPI for every page, the cpus that may still cache
+ * the translations are collected in current->tlb_ubc and flushed here,
+ * once for the whole batch.  Must be called before the unmapped pages
+ * are freed.
+ */
+void try_to_unmap_flush(void)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+
+	if (!tlb_ubc->flush_required)
+		return;
+
+	flush_tlb_batched(&tlb_ubc->cpumask);
+	tlb_ubc->flush_required = 0;
+	tlb_ubc->writable = 0;
+}
+
+/*
+ * Flush before a page is written back if any pte of the batch was dirty:
+ * a cpu could otherwise go on writing to the page through a stale TLB
+ * entry after it was cleaned.
+ */
+void try_to_unmap_flush_dirty(void)
+{
+	if (current->tlb_ubc.writable)
+		try_to_unmap_flush();
+}
+
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, int writable)
+{
+	struct tlbflush_unmap_batch *tlb_ubc = &current->tlb_ubc;
+
+	cpus_or(tlb_ubc->cpumask, tlb_ubc->cpumask, mm->cpu_vm_mask);
+	tlb_ubc->flush_required = 1;
+
+	/*
+	 * Tell the paths that change or zap ptes of this mm under the pte
+	 * lock, which we hold, that they have to flush first: see
+	 * flush_tlb_batched_pending().  Each deferral gets a new value, so
+	 * a flush that started before it cannot clear it; skip zero, which
+	 * means nothing is pending.
+	 */
+	smp_mb__before_atomic_inc();
+	if (unlikely(atomic_inc_return(&mm->tlb_flush_batched) == 0))
+		atomic_inc(&mm->tlb_flush_batched);
+
+	if (writable)
+		tlb_ubc->writable = 1;
+}
+
+/*
+ * Only defer the flush if other cpus would have to be interrupted,
+ * flushing just the local TLB is cheap.
+ */
+static int should_defer_flush(struct mm_struct *mm, int flags)
+{
+	int defer = 0;
+	int cpu;
+
+	if (!(flags & TTU_BATCH_FLUSH))
+		return 0;
+
+	cpu = get_cpu();
+	if (cpumask_any_but(&mm->cpu_vm_mask, cpu) < nr_cpu_ids)
+		defer = 1;
+	put_cpu();
+
+	return defer;
+}
+
+/**
+ * flush_tlb_batched_pending - flush a deferred reclaim flush of an mm
+ * @mm: address space whose ptes are about to be changed
+ *
+ * Reclaim may have cleared ptes of @mm and deferred the flush.  Whoever
+ * then finds those ptes clear, and relies on that to change or zap the
+ * mapping, e.g. munmap() or mprotect(), has to flush first: there may
+ * still be TLB entries for the old ptes around.  Called with the pte
+ * lock held.
+ *
+ * Reclaim may defer another flush, under a different pte lock, while we
+ * flush; only the value seen before flushing is cleared, so that one
+ * stays pending.
+ */
+void flush_tlb_batched_pending(struct mm_struct *mm)
+{
+	int batched = atomic_read(&mm->tlb_flush_batched);
+
+	if (batched) {
+		flush_tlb_mm(mm);
+		(void)atomic_cmpxchg(&mm->tlb_flush_batched, batched, 0);
+	}
+}
+#else
+static void set_tlb_ubc_flush_pending(struct mm_struct *mm, int writable)
+{
+}
+
+static int should_defer_flush(struct mm_struct *mm, int flags)
+{
+	return 0;
+}
+#endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
+
 /*
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from either try_to_unmap_anon or try_to_unmap_file.
  */
 static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
-				int migration)
+				int flags)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	unsigned long address;
@@ -777,7 +886,7 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	 * If it's recently referenced (perhaps page_referenced
 	 * skipped over this mm) then we should reactivate it.
 	 */
-	if (!migration) {
+	if (!(flags & TTU_MIGRATION)) {
 		if (vma->vm_flags & VM_LOCKED) {
 			ret = SWAP_MLOCK;
 			goto out_unmap;
@@ -790,7 +899,16 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
-	pteval = ptep_clear_flush_notify(vma, address, pte);
+	if (should_defer_flush(mm, flags)) {
+		/*
+		 * The page stays isolated and is only freed after
+		 * try_to_unmap_flush(), so the flush can wait.
+		 */
+		pteval = ptep_get_and_clear(mm, address, pte);
+		mmu_notifier_invalidate_page(mm, address);
+		set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+	} else
+		pteval = ptep_clear_flush_notify(vma, address, pte);
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -821,12 +939,12 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 			 * pte. do_swap_page() will wait until the migration
 			 * pte is removed and then restart fault handling.
 			 */
-			BUG_ON(!migration);
+			BUG_ON(!(flags & TTU_MIGRATION));
 			entry = make_migration_entry(page, pte_write(pteval));
 		}
 		set_pte_at(mm, address, pte, swp_entry_to_pte(entry));
 		BUG_ON(pte_file(*pte));
-	} else if (PAGE_MIGRATION && migration) {
+	} else if (PAGE_MIGRATION && (flags & TTU_MIGRATION)) {
 		/* Establish migration entry for a file page */
 		swp_entry_t entry;
 		entry = make_migration_entry(page, pte_write(pteval));
@@ -983,7 +1101,7 @@ static int try_to_mlock_page(struct page *page, struct vm_area_struct *vma)
  * rmap method
  * @page: the page to unmap/unlock
  * @unlock:  request for unlock rather than unmap [unlikely]
- * @migration:  unmapping for migration - ignored if @unlock
+ * @flags:  TTU_* flags of the unmap - ignored if @unlock
  *
  * Find all the mappings of a page using the mapping pointer and the vma chains
  * contained in the anon_vma struct it points to.
@@ -995,7 +1113,7 @@ static int try_to_mlock_page(struct page *page, struct vm_area_struct *vma)
  * vm_flags for that VMA.  That should be OK, because that vma shouldn't be
  * 'LOCKED.
  */
-static int try_to_unmap_anon(struct page *page, int unlock, int migration)
+static int try_to_unmap_anon(struct page *page, int unlock, int flags)
 {
 	struct anon_vma *anon_vma;
 	struct vm_area_struct *vma;
@@ -1016,7 +1134,7 @@ static int try_to_unmap_anon(struct page *page, int unlock, int migration)
 				continue;  /* must visit all unlocked vmas */
 			ret = SWAP_MLOCK;  /* saw at least one mlocked vma */
 		} else {
-			ret = try_to_unmap_one(page, vma, migration);
+			ret = try_to_unmap_one(page, vma, flags);
 			if (ret == SWAP_FAIL || !page_mapped(page))
 				break;
 		}
@@ -1041,7 +1159,7 @@ static int try_to_unmap_anon(struct page *page, int unlock, int migration)
  * try_to_unmap_file - unmap/unlock file page using the object-based rmap method
  * @page: the page to unmap/unlock
  * @unlock:  request for unlock rather than unmap [unlikely]
- * @migration:  unmapping for migration - ignored if @unlock
+ * @flags:  TTU_* flags of the unmap - ignored if @unlock
  *
  * Find all the mappings of a page using the mapping pointer and the vma chains
  * contained in the address_space struct it points to.
@@ -1053,7 +1171,7 @@ static int try_to_unmap_anon(struct page *page, int unlock, int migration)
  * vm_flags for that VMA.  That should be OK, because that vma shouldn't be
  * 'LOCKED.
  */
-static int try_to_unmap_file(struct page *page, int unlock, int migration)
+static int try_to_unmap_file(struct page *page, int unlock, int flags)
 {
 	struct address_space *mapping = page->mapping;
 	pgoff_t pgoff = page->index << (PAGE_CACHE_SHIFT - PAGE_SHIFT);
@@ -1076,7 +1194,7 @@ static int try_to_unmap_file(struct page *page, int unlock, int migration)
 				continue;	/* must visit all vmas */
 			ret = SWAP_MLOCK;
 		} else {
-			ret = try_to_unmap_one(page, vma, migration);
+			ret = try_to_unmap_one(page, vma, flags);
 			if (ret == SWAP_FAIL || !page_mapped(page))
 				goto out;
 		}
@@ -1101,7 +1219,7 @@ static int try_to_unmap_file(struct page *page, int unlock, int migration)
 			ret = SWAP_MLOCK;	/* leave mlocked == 0 */
 			goto out;		/* no need to look further */
 		}
-		if (!MLOCK_PAGES && !migration && (vma->vm_flags & VM_LOCKED))
+		if (!MLOCK_PAGES && !(flags & TTU_MIGRATION) && (vma->vm_flags & VM_LOCKED))
 			continue;
 		cursor = (unsigned long) vma->vm_private_data;
 		if (cursor > max_nl_cursor)
@@ -1135,7 +1253,7 @@ static int try_to_unmap_file(struct page *page, int unlock, int migration)
 	do {
 		list_for_each_entry(vma, &mapping->i_mmap_nonlinear,
 						shared.vm_set.list) {
-			if (!MLOCK_PAGES && !migration &&
+			if (!MLOCK_PAGES && !(flags & TTU_MIGRATION) &&
 			    (vma->vm_flags & VM_LOCKED))
 				continue;
 			cursor = (unsigned long) vma->vm_private_data;
@@ -1175,7 +1293,8 @@ out:
 /**
  * try_to_unmap - try to remove all page table mappings to a page
  * @page: the page to get unmapped
- * @migration: migration flag
+ * @flags: TTU_MIGRATION to install migration entries, TTU_BATCH_FLUSH
+ *	to defer the TLB flushes to try_to_unmap_flush()
  *
  * Tries to remove all the page table entries which are mapping this
  * page, used in the pageout path.  Caller must hold the page lock.
@@ -1186,16 +1305,16 @@ out:
  * SWAP_FAIL	- the page is unswappable
  * SWAP_MLOCK	- page is mlocked.
  */
-int try_to_unmap(struct page *page, int migration)
+int try_to_unmap(struct page *page, int flags)
 {
 	int ret;
 
 	BUG_ON(!PageLocked(page));
 
 	if (PageAnon(page))
-		ret = try_to_unmap_anon(page, 0, migration);
+		ret = try_to_unmap_anon(page, 0, flags);
 	else
-		ret = try_to_unmap_file(page, 0, migration);
+		ret = try_to_unmap_file(page, 0, flags);
 	if (ret != SWAP_MLOCK && !page_mapped(page))
 		ret = SWAP_SUCCESS;
 	return ret;
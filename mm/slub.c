@@ -1448,6 +1448,30 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	deactivate_slab(s, c);
 }
 
+static void __slab_free(struct kmem_cache *s, struct page *page,
+			void *x, unsigned long addr, unsigned int offset);
+
+/*
+ * Return the @nr oldest objects of the cpu object array to their slabs.
+ *
+ * Interrupts are disabled.
+ */
+static void flush_cpu_objects(struct kmem_cache *s, struct kmem_cache_cpu *c,
+			      unsigned int nr)
+{
+	unsigned int i;
+
+	stat(c, CPU_OBJECTS_FLUSH);
+	for (i = 0; i < nr; i++) {
+		void *object = c->objects[i];
+
+		__slab_free(s, virt_to_head_page(object), object, _RET_IP_,
+			    c->offset);
+	}
+	c->nr_objects -= nr;
+	memmove(c->objects, c->objects + nr, c->nr_objects * sizeof(void *));
+}
+
 /*
  * Flush cpu slab.
  *
@@ -1457,7 +1481,11 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
 
-	if (likely(c && c->page))
+	if (unlikely(!c))
+		return;
+	if (c->nr_objects)
+		flush_cpu_objects(s, c, c->nr_objects);
+	if (likely(c->page))
 		flush_slab(s, c);
 }
 
@@ -1604,11 +1632,15 @@ static __always_inline void *slab_alloc(struct kmem_cache *s,
 	local_irq_save(flags);
 	c = get_cpu_slab(s, smp_processor_id());
 	objsize = c->objsize;
-	if (unlikely(!c->freelist || !node_match(c, node)))
+	if (unlikely(!c->freelist || !node_match(c, node))) {
 
-		object = __slab_alloc(s, gfpflags, node, addr, c);
+		if (c->nr_objects && node == -1) {
+			object = c->objects[--c->nr_objects];
+			stat(c, ALLOC_CPU_OBJECTS);
+		} else
+			object = __slab_alloc(s, gfpflags, node, addr, c);
 
-	else {
+	} else {
 		object = c->freelist;
 		c->freelist = object[c->offset];
 		stat(c, ALLOC_FASTPATH);
@@ -1635,6 +1667,68 @@ void *kmem_cache_alloc_node(struct kmem_cache *s, gfp_t gfpflags, int node)
 EXPORT_SYMBOL(kmem_cache_alloc_node);
 #endif
 
+/**
+ * kmem_cache_alloc_bulk - allocate several objects at once
+ * @s: the cache to allocate from
+ * @gfpflags: allocation flags
+ * @nr: number of objects to allocate
+ * @p: array receiving the objects
+ *
+ * Fills @p with @nr objects, taking them from the cpu slab and the cpu
+ * object array with interrupts disabled only once.
+ *
+ * Returns @nr, or 0 if not all objects could be allocated, in which case
+ * none are.
+ */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t gfpflags, size_t nr,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	unsigned int objsize;
+	size_t i;
+
+	might_sleep_if(gfpflags & __GFP_WAIT);
+
+	if (should_failslab(s->objsize, gfpflags))
+		return 0;
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	for (i = 0; i < nr; i++) {
+		void **object = c->freelist;
+
+		if (likely(object)) {
+			c->freelist = object[c->offset];
+			stat(c, ALLOC_FASTPATH);
+		} else if (c->nr_objects) {
+			object = c->objects[--c->nr_objects];
+			stat(c, ALLOC_CPU_OBJECTS);
+		} else {
+			object = __slab_alloc(s, gfpflags, -1, _RET_IP_, c);
+			if (unlikely(!object))
+				goto error;
+			/* We may have been migrated while allocating a slab */
+			c = get_cpu_slab(s, smp_processor_id());
+		}
+		p[i] = object;
+	}
+	objsize = c->objsize;
+	local_irq_restore(flags);
+
+	if (unlikely(gfpflags & __GFP_ZERO))
+		for (i = 0; i < nr; i++)
+			memset(p[i], 0, objsize);
+
+	return nr;
+
+error:
+	local_irq_restore(flags);
+	kmem_cache_free_bulk(s, i, p);
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 /*
  * Slow patch handling. This may still be called frequently since objects
  * have a longer lifetime than the cpu slabs in most processing loads.
@@ -1710,18 +1804,21 @@ debug:
  * of this processor. This typically the case if we have just allocated
  * the item before.
  *
- * If fastpath is not possible then fall back to __slab_free where we deal
+ * Objects of other slabs on the local node, typically allocated on
+ * another processor, go to the cpu object array, which is flushed in
+ * batches when it is full.
+ *
+ * If neither is possible then fall back to __slab_free where we deal
  * with all sorts of special processing.
+ *
+ * Interrupts are disabled.
  */
-static __always_inline void slab_free(struct kmem_cache *s,
-			struct page *page, void *x, unsigned long addr)
+static __always_inline void __do_slab_free(struct kmem_cache *s,
+			struct kmem_cache_cpu *c, struct page *page, void *x,
+			unsigned long addr)
 {
 	void **object = (void *)x;
-	struct kmem_cache_cpu *c;
-	unsigned long flags;
 
-	local_irq_save(flags);
-	c = get_cpu_slab(s, smp_processor_id());
 	debug_check_no_locks_freed(object, c->objsize);
 	if (!(s->flags & SLAB_DEBUG_OBJECTS))
 		debug_check_no_obj_freed(object, s->objsize);
@@ -1729,9 +1826,23 @@ static __always_inline void slab_free(struct kmem_cache *s,
 		object[c->offset] = c->freelist;
 		c->freelist = object;
 		stat(c, FREE_FASTPATH);
+	} else if (likely(!(SLABDEBUG && PageSlubDebug(page)) &&
+			  page_to_nid(page) == numa_node_id())) {
+		if (unlikely(c->nr_objects == SLUB_CPU_OBJECTS))
+			flush_cpu_objects(s, c, SLUB_CPU_OBJECTS / 2);
+		c->objects[c->nr_objects++] = object;
+		stat(c, FREE_CPU_OBJECTS);
 	} else
 		__slab_free(s, page, x, addr, c->offset);
+}
 
+static __always_inline void slab_free(struct kmem_cache *s,
+			struct page *page, void *x, unsigned long addr)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	__do_slab_free(s, get_cpu_slab(s, smp_processor_id()), page, x, addr);
 	local_irq_restore(flags);
 }
 
@@ -1745,6 +1856,28 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/**
+ * kmem_cache_free_bulk - free several objects at once
+ * @s: the cache the objects belong to
+ * @nr: number of objects to free
+ * @p: array of the objects
+ *
+ * Frees the @nr objects in @p with interrupts disabled only once.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t nr, void **p)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	size_t i;
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	for (i = 0; i < nr; i++)
+		__do_slab_free(s, c, virt_to_head_page(p[i]), p[i], _RET_IP_);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
 /* Figure out on which slab page the object resides */
 static struct page *get_object_page(const void *x)
 {
@@ -1919,6 +2052,7 @@ static void init_kmem_cache_cpu(struct kmem_cache *s,
 	c->node = 0;
 	c->offset = s->offset / sizeof(void *);
 	c->objsize = s->objsize;
+	c->nr_objects = 0;
 #ifdef CONFIG_SLUB_STATS
 	memset(c->stat, 0, NR_SLUB_STAT_ITEMS * sizeof(unsigned));
 #endif
@@ -4143,6 +4277,9 @@ STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
 STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
 STAT_ATTR(DEACTIVATE_REMOTE_FREES, deactivate_remote_frees);
 STAT_ATTR(ORDER_FALLBACK, order_fallback);
+STAT_ATTR(ALLOC_CPU_OBJECTS, alloc_cpu_objects);
+STAT_ATTR(FREE_CPU_OBJECTS, free_cpu_objects);
+STAT_ATTR(CPU_OBJECTS_FLUSH, cpu_objects_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -4196,6 +4333,9 @@ static struct attribute *slab_attrs[] = {
 	&deactivate_to_tail_attr.attr,
 	&deactivate_remote_frees_attr.attr,
 	&order_fallback_attr.attr,
+	&alloc_cpu_objects_attr.attr,
+	&free_cpu_objects_attr.attr,
+	&cpu_objects_flush_attr.attr,
 #endif
 	NULL
 };
@@ -0,0 +1,318 @@
+/*
+ * mm/vmpressure.c - memory pressure notifications
+ *
+ * Reclaim reports how many pages it scanned and how many of those it
+ * could reclaim.  The share of scanned pages that could not be reclaimed
+ * tells how hard it is to find memory, long before allocations start to
+ * fail: a low share means reclaim is just recycling cache, a high one
+ * that it is digging through the working set.
+ *
+ * Once a window of pages has been scanned, the ratio is turned into a
+ * level (low, medium or critical) and every eventfd registered for that
+ * level or a lower one is signalled.  Listeners register per memory
+ * cgroup through memory.pressure_level.  Global reclaim is reported to
+ * the root cgroup; reclaim in a cgroup is reported to that cgroup and,
+ * if nobody listens there, to its ancestors.
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/eventfd.h>
+#include <linux/vmpressure.h>
+
+/*
+ * The pressure is evaluated every this many scanned pages, which
+ * averages it over a few reclaim passes and rate limits the events.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+/* Share of scanned pages that were not reclaimed, in percent */
+static const unsigned int vmpressure_level_med = 60;
+static const unsigned int vmpressure_level_critical = 95;
+
+/*
+ * When reclaim has to go down to this priority, it scanned a good part
+ * of the LRU without getting enough back: report critical right away.
+ */
+static const int vmpressure_level_critical_prio = ilog2(100 / 10);
+
+/* Listeners per cgroup */
+#define VMPRESSURE_MAX_EVENTS	64
+
+static const char *vmpressure_str_levels[] = {
+	[VMPRESSURE_LOW] = "low",
+	[VMPRESSURE_MEDIUM] = "medium",
+	[VMPRESSURE_CRITICAL] = "critical",
+};
+
+struct vmpressure_event {
+	struct file *efile;
+	enum vmpressure_levels level;
+	struct list_head node;
+};
+
+static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
+						    unsigned long reclaimed)
+{
+	unsigned long pressure;
+
+	if (reclaimed >= scanned)
+		return VMPRESSURE_LOW;
+
+	pressure = (scanned - reclaimed) * 100 / scanned;
+	if (pressure >= vmpressure_level_critical)
+		return VMPRESSURE_CRITICAL;
+	if (pressure >= vmpressure_level_med)
+		return VMPRESSURE_MEDIUM;
+	return VMPRESSURE_LOW;
+}
+
+/*
+ * Drop the listeners whose eventfd was closed: once userspace closed
+ * it, we hold the only reference left.  An eventfd that other cgroups
+ * listen on as well stays until it is unregistered with "none".
+ * Called with events_lock held.
+ */
+static void vmpressure_reap_events(struct vmpressure *vmpr)
+{
+	struct vmpressure_event *ev, *tmp;
+
+	list_for_each_entry_safe(ev, tmp, &vmpr->events, node) {
+		if (file_count(ev->efile) > 1)
+			continue;
+		list_del(&ev->node);
+		fput(ev->efile);
+		kfree(ev);
+	}
+}
+
+/*
+ * Return the listener of @efile, if any, and count all listeners in
+ * @nr.  Called with events_lock held.
+ */
+static struct vmpressure_event *
+vmpressure_find_event(struct vmpressure *vmpr, struct file *efile,
+		      unsigned int *nr)
+{
+	struct vmpressure_event *ev, *found = NULL;
+
+	*nr = 0;
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (ev->efile == efile)
+			found = ev;
+		(*nr)++;
+	}
+	return found;
+}
+
+static bool vmpressure_event(struct vmpressure *vmpr,
+			     enum vmpressure_levels level)
+{
+	struct vmpressure_event *ev;
+	bool signalled = false;
+
+	mutex_lock(&vmpr->events_lock);
+	vmpressure_reap_events(vmpr);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (level < ev->level)
+			continue;
+		eventfd_signal(ev->efile, 1);
+		signalled = true;
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return signalled;
+}
+
+static void vmpressure_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = container_of(work, struct vmpressure, work);
+	unsigned long scanned, reclaimed;
+	enum vmpressure_levels level;
+
+	spin_lock(&vmpr->sr_lock);
+	scanned = vmpr->scanned;
+	reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	spin_unlock(&vmpr->sr_lock);
+
+	/* another instance of the work took care of it */
+	if (!scanned)
+		return;
+
+	level = vmpressure_calc_level(scanned, reclaimed);
+	do {
+		if (vmpressure_event(vmpr, level))
+			break;
+	} while ((vmpr = vmpressure_parent(vmpr)));
+}
+
+/**
+ * vmpressure - account memory pressure through scanned/reclaimed ratio
+ * @gfp: reclaimer's gfp mask
+ * @memcg: cgroup that is under pressure, NULL for global reclaim
+ * @scanned: number of pages scanned
+ * @reclaimed: number of pages reclaimed
+ *
+ * Called by reclaim after each pass over a zone.  The listeners are
+ * notified from a work item once enough pages have been scanned.
+ */
+void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+		unsigned long scanned, unsigned long reclaimed)
+{
+	struct vmpressure *vmpr = memcg_to_vmpressure(memcg);
+
+	/*
+	 * Only account reclaim for memory userspace can give back: there
+	 * is no point in having it drop caches because the DMA zone, or an
+	 * allocation that cannot do I/O, is in trouble.
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+	if (!vmpr || !scanned)
+		return;
+
+	/*
+	 * Reclaim may still hold a reference to a cgroup that is being
+	 * destroyed; the check and the scheduling of the work are under
+	 * sr_lock so that vmpressure_cleanup() cannot miss it.
+	 */
+	spin_lock(&vmpr->sr_lock);
+	if (!vmpr->dead) {
+		vmpr->scanned += scanned;
+		vmpr->reclaimed += reclaimed;
+		if (vmpr->scanned >= vmpressure_win)
+			schedule_work(&vmpr->work);
+	}
+	spin_unlock(&vmpr->sr_lock);
+}
+
+/**
+ * vmpressure_prio - account memory pressure through reclaimer priority
+ * @gfp: reclaimer's gfp mask
+ * @memcg: cgroup that is under pressure, NULL for global reclaim
+ * @prio: reclaimer's priority
+ *
+ * Reclaim that has to raise its priority this far is in trouble, no
+ * matter how the pages it scanned so far turned out.
+ */
+void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
+{
+	if (prio > vmpressure_level_critical_prio)
+		return;
+
+	/* a full window of scanned pages, none of them reclaimed */
+	vmpressure(gfp, memcg, vmpressure_win, 0);
+}
+
+/**
+ * vmpressure_register_event - register a pressure listener
+ * @vmpr: vmpressure of the cgroup
+ * @args: "<eventfd> <level>", level being low, medium, critical or none
+ *
+ * The eventfd is signalled every time the pressure reaches @level or a
+ * higher one.  An eventfd has at most one listener per cgroup: writing
+ * it again changes the level, "none" removes the listener.  Otherwise
+ * it goes away when the eventfd is closed and no other cgroup listens
+ * on it.
+ */
+int vmpressure_register_event(struct vmpressure *vmpr, const char *args)
+{
+	struct vmpressure_event *ev, *new = NULL;
+	struct file *efile;
+	unsigned int nr;
+	char *end;
+	int efd, level;
+	int ret = 0;
+
+	efd = simple_strtol(args, &end, 10);
+	if (end == args || *end != ' ')
+		return -EINVAL;
+	while (*end == ' ')
+		end++;
+
+	/* level VMPRESSURE_NUM_LEVELS stands for "none" */
+	for (level = 0; level < VMPRESSURE_NUM_LEVELS; level++)
+		if (!strcmp(end, vmpressure_str_levels[level]))
+			break;
+	if (level == VMPRESSURE_NUM_LEVELS && strcmp(end, "none"))
+		return -EINVAL;
+
+	efile = eventfd_fget(efd);
+	if (IS_ERR(efile))
+		return PTR_ERR(efile);
+
+	if (level != VMPRESSURE_NUM_LEVELS) {
+		new = kmalloc(sizeof(*new), GFP_KERNEL);
+		if (!new) {
+			fput(efile);
+			return -ENOMEM;
+		}
+		new->efile = efile;
+		new->level = level;
+	}
+
+	mutex_lock(&vmpr->events_lock);
+	vmpressure_reap_events(vmpr);
+	ev = vmpressure_find_event(vmpr, efile, &nr);
+	if (ev && new) {
+		ev->level = level;
+	} else if (ev) {
+		list_del(&ev->node);
+		fput(ev->efile);
+		kfree(ev);
+	} else if (!new) {
+		ret = -ENOENT;
+	} else if (nr >= VMPRESSURE_MAX_EVENTS) {
+		ret = -ENOSPC;
+	} else {
+		list_add(&new->node, &vmpr->events);
+		new = NULL;
+		efile = NULL;
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	kfree(new);
+	if (efile)
+		fput(efile);
+	return ret;
+}
+
+void vmpressure_init(struct vmpressure *vmpr)
+{
+	vmpr->dead = false;
+	spin_lock_init(&vmpr->sr_lock);
+	mutex_init(&vmpr->events_lock);
+	INIT_LIST_HEAD(&vmpr->events);
+	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+}
+
+/*
+ * Called when the cgroup goes away: stop further evaluations, wait for
+ * a pending one and drop all listeners.  This cannot wait until the
+ * memcg is freed, which may happen in atomic context on swap uncharge.
+ */
+void vmpressure_cleanup(struct vmpressure *vmpr)
+{
+	struct vmpressure_event *ev, *tmp;
+
+	spin_lock(&vmpr->sr_lock);
+	vmpr->dead = true;
+	spin_unlock(&vmpr->sr_lock);
+
+	cancel_work_sync(&vmpr->work);
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry_safe(ev, tmp, &vmpr->events, node) {
+		list_del(&ev->node);
+		fput(ev->efile);
+		kfree(ev);
+	}
+	mutex_unlock(&vmpr->events_lock);
+}
@@ -38,8 +38,13 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/memcontrol.h>
+#include <linux/vmpressure.h>
+#include <linux/memstall.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/hugetlb.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -415,9 +420,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  A page cache page that is being
+ * @reclaimed leaves a shadow entry behind for refault detection.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -462,7 +469,11 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swap_free(swap);
 	} else {
-		__remove_from_page_cache(page);
+		void *shadow = NULL;
+
+		if (reclaimed && page_is_file_cache(page))
+			shadow = workingset_eviction(mapping, page);
+		__remove_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 	}
 
@@ -481,7 +492,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -656,7 +667,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page, 0)) {
+			switch (try_to_unmap(page, TTU_BATCH_FLUSH)) {
 			case SWAP_FAIL:
 				goto activate_locked;
 			case SWAP_AGAIN:
@@ -676,6 +687,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			if (!sc->may_writepage)
 				goto keep_locked;
 
+			/*
+			 * A cpu must not write to the page through a stale
+			 * TLB entry once it is under writeback.
+			 */
+			try_to_unmap_flush_dirty();
+
 			/* Page is dirty, try to write it out here */
 			switch (pageout(page, mapping, sync_writeback)) {
 			case PAGE_KEEP:
@@ -741,7 +758,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -755,6 +772,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 free_it:
 		nr_reclaimed++;
 		if (!pagevec_add(&freed_pvec, page)) {
+			try_to_unmap_flush();
 			__pagevec_free(&freed_pvec);
 			pagevec_reinit(&freed_pvec);
 		}
@@ -781,17 +799,13 @@ keep:
 		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
 	}
 	list_splice(&ret_pages, page_list);
+	try_to_unmap_flush();
 	if (pagevec_count(&freed_pvec))
 		__pagevec_free(&freed_pvec);
 	count_vm_events(PGACTIVATE, pgactivate);
 	return nr_reclaimed;
 }
 
-/* LRU Isolation modes. */
-#define ISOLATE_INACTIVE 0	/* Isolate inactive pages. */
-#define ISOLATE_ACTIVE 1	/* Isolate active pages. */
-#define ISOLATE_BOTH 2		/* Isolate both active and inactive pages. */
-
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1036,6 +1050,44 @@ int isolate_lru_page(struct page *page)
 	return ret;
 }
 
+/*
+ * Put back any unfreeable pages left on @page_list by shrink_page_list().
+ * Called with the lru_lock held and interrupts disabled; the lock may be
+ * dropped in between.
+ */
+static void putback_inactive_pages(struct zone *zone,
+				   struct zone_reclaim_stat *reclaim_stat,
+				   struct list_head *page_list,
+				   struct pagevec *pvec)
+{
+	struct page *page;
+
+	while (!list_empty(page_list)) {
+		int lru;
+		page = lru_to_page(page_list);
+		VM_BUG_ON(PageLRU(page));
+		list_del(&page->lru);
+		if (unlikely(!page_evictable(page, NULL))) {
+			spin_unlock_irq(&zone->lru_lock);
+			putback_lru_page(page);
+			spin_lock_irq(&zone->lru_lock);
+			continue;
+		}
+		SetPageLRU(page);
+		lru = page_lru(page);
+		add_page_to_lru_list(zone, page, lru);
+		if (PageActive(page)) {
+			int file = !!page_is_file_cache(page);
+			reclaim_stat->recent_rotated[file]++;
+		}
+		if (!pagevec_add(pvec, page)) {
+			spin_unlock_irq(&zone->lru_lock);
+			__pagevec_release(pvec);
+			spin_lock_irq(&zone->lru_lock);
+		}
+	}
+}
+
 /*
  * shrink_inactive_list() is a helper for shrink_zone().  It returns the number
  * of reclaimed pages
@@ -1055,7 +1107,6 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 	lru_add_drain();
 	spin_lock_irq(&zone->lru_lock);
 	do {
-		struct page *page;
 		unsigned long nr_taken;
 		unsigned long nr_scan;
 		unsigned long nr_freed;
@@ -1125,6 +1176,9 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		}
 
 		nr_reclaimed += nr_freed;
+		if (!scanning_global_lru(sc))
+			mem_cgroup_reclaim_statistics(sc->mem_cgroup,
+						      nr_scan, nr_freed);
 		local_irq_disable();
 		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scan);
@@ -1138,33 +1192,7 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 			goto done;
 
 		spin_lock(&zone->lru_lock);
-		/*
-		 * Put back any unfreeable pages.
-		 */
-		while (!list_empty(&page_list)) {
-			int lru;
-			page = lru_to_page(&page_list);
-			VM_BUG_ON(PageLRU(page));
-			list_del(&page->lru);
-			if (unlikely(!page_evictable(page, NULL))) {
-				spin_unlock_irq(&zone->lru_lock);
-				putback_lru_page(page);
-				spin_lock_irq(&zone->lru_lock);
-				continue;
-			}
-			SetPageLRU(page);
-			lru = page_lru(page);
-			add_page_to_lru_list(zone, page, lru);
-			if (PageActive(page)) {
-				int file = !!page_is_file_cache(page);
-				reclaim_stat->recent_rotated[file]++;
-			}
-			if (!pagevec_add(&pvec, page)) {
-				spin_unlock_irq(&zone->lru_lock);
-				__pagevec_release(&pvec);
-				spin_lock_irq(&zone->lru_lock);
-			}
-		}
+		putback_inactive_pages(zone, reclaim_stat, &page_list, &pvec);
   	} while (nr_scanned < max_scan);
 	spin_unlock(&zone->lru_lock);
 done:
@@ -1212,6 +1240,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	unsigned long pgmoved;
 	int pgdeactivate = 0;
 	unsigned long pgscanned;
+	unsigned long nr_rotated = 0;
 	LIST_HEAD(l_hold);	/* The pages which were snipped off */
 	LIST_HEAD(l_inactive);
 	struct page *page;
@@ -1239,7 +1268,6 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 		__mod_zone_page_state(zone, NR_ACTIVE_ANON, -pgmoved);
 	spin_unlock_irq(&zone->lru_lock);
 
-	pgmoved = 0;
 	while (!list_empty(&l_hold)) {
 		cond_resched();
 		page = lru_to_page(&l_hold);
@@ -1253,7 +1281,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 		/* page_referenced clears PageReferenced */
 		if (page_mapping_inuse(page) &&
 		    page_referenced(page, 0, sc->mem_cgroup))
-			pgmoved++;
+			nr_rotated++;
 
 		list_add(&page->lru, &l_inactive);
 	}
@@ -1272,7 +1300,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	 * This helps balance scan pressure between file and anonymous
 	 * pages in get_scan_ratio.
 	 */
-	reclaim_stat->recent_rotated[!!file] += pgmoved;
+	reclaim_stat->recent_rotated[!!file] += nr_rotated;
 
 	while (!list_empty(&l_inactive)) {
 		page = lru_to_page(&l_inactive);
@@ -1282,7 +1310,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 		VM_BUG_ON(!PageActive(page));
 		ClearPageActive(page);
 
-		list_move(&page->lru, &zone->lru[lru].list);
+		move_page_to_lru_list(zone, page, lru);
 		mem_cgroup_add_lru_list(page, lru);
 		pgmoved++;
 		if (!pagevec_add(&pvec, page)) {
@@ -1312,6 +1340,474 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	pagevec_release(&pvec);
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU.  Instead of moving pages between an active
+ * and an inactive list, evictable pages are sorted into generations (see
+ * struct lru_gen).  Reclaim isolates pages from the oldest generation of
+ * a type; once that is down to MIN_NR_GENS generations and the oldest is
+ * exhausted, a new youngest generation is opened.  kswapd then walks the
+ * page tables of all mm_structs and promotes the pages it finds young
+ * into it, instead of asking rmap about every page it looks at.  Pages
+ * that are still mapped when evicted get checked through page_referenced()
+ * in shrink_page_list() as usual, which catches the references of direct
+ * reclaim and of mms the walk had to skip.
+ */
+int lru_gen_enable __read_mostly;
+
+static int __init setup_lru_gen(char *str)
+{
+	if (!str)
+		lru_gen_enable = 1;
+	else
+		lru_gen_enable = !!simple_strtoul(str, NULL, 0);
+	return 0;
+}
+early_param("lru_gen", setup_lru_gen);
+
+void __meminit lru_gen_init_zone(struct zone *zone)
+{
+	struct lru_gen *lrugen = &zone->lrugen;
+	int gen, file;
+
+	for (file = 0; file < 2; file++) {
+		lrugen->min_seq[file] = 0;
+		lrugen->max_seq[file] = MIN_NR_GENS - 1;
+		for (gen = 0; gen < MAX_NR_GENS; gen++)
+			INIT_LIST_HEAD(&lrugen->lists[gen][file]);
+	}
+	lrugen->nr_sorted = 0;
+}
+
+static int lru_gen_nr_gens(struct lru_gen *lrugen, int file)
+{
+	return lrugen->max_seq[file] - lrugen->min_seq[file] + 1;
+}
+
+/*
+ * Is @gen one of the generations after the oldest?  The generation in
+ * page->flags may be stale when it was set from an old max_seq.
+ */
+static int lru_gen_is_younger(struct lru_gen *lrugen, int file, int gen)
+{
+	int oldest = lru_gen_from_seq(lrugen->min_seq[file]);
+	int age = (gen - oldest + MAX_NR_GENS) % MAX_NR_GENS;
+
+	return age && age < lru_gen_nr_gens(lrugen, file);
+}
+
+/*
+ * Isolate pages of type @file from the tail of the oldest generation of
+ * @zone onto @dst, looking at no more than @nr_to_scan pages.  Pages that
+ * were promoted since they were put on the list are moved to the list of
+ * their generation instead, and the oldest generation is retired when it
+ * runs empty.  Called with the lru_lock held.
+ *
+ * Returns the number of pages isolated; *@scanned is 0 only if the oldest
+ * generation is empty and there are no more than MIN_NR_GENS left, in
+ * which case the caller has to age the zone.
+ */
+static unsigned long lru_gen_isolate_pages(struct zone *zone, int file,
+		unsigned long nr_to_scan, struct list_head *dst,
+		unsigned long *scanned)
+{
+	struct lru_gen *lrugen = &zone->lrugen;
+	unsigned long nr_taken = 0;
+	unsigned long scan = 0;
+
+	while (scan < nr_to_scan) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[file]);
+		struct list_head *src = &lrugen->lists[gen][file];
+		struct page *page;
+		int new_gen;
+
+		if (list_empty(src)) {
+			if (lru_gen_nr_gens(lrugen, file) <= MIN_NR_GENS)
+				break;
+			lrugen->min_seq[file]++;
+			continue;
+		}
+
+		page = lru_to_page(src);
+		prefetchw_prev_lru_page(page, src, flags);
+
+		VM_BUG_ON(!PageLRU(page));
+		scan++;
+
+		new_gen = page_lru_gen(page);
+		if (new_gen != gen && lru_gen_is_younger(lrugen, file, new_gen)) {
+			list_move(&page->lru, &lrugen->lists[new_gen][file]);
+			lrugen->nr_sorted++;
+			continue;
+		}
+
+		switch (__isolate_lru_page(page, ISOLATE_BOTH, file)) {
+		case 0:
+			list_move(&page->lru, dst);
+			nr_taken++;
+			break;
+
+		case -EBUSY:
+			/* else it is being freed elsewhere */
+			list_move(&page->lru, src);
+			break;
+
+		default:
+			BUG();
+		}
+	}
+
+	*scanned = scan;
+	return nr_taken;
+}
+
+/*
+ * The mm_structs whose page tables are walked for aging.  An mm is on the
+ * list from mm_init() until its last user is gone in mmput(), so holding
+ * mm_users keeps it, and therefore the walker's position, on the list.
+ */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+/* Serializes the walks; the statistics are protected by it as well */
+static DEFINE_MUTEX(lru_gen_walk_mutex);
+
+static struct {
+	unsigned long walks;	/* walks of lru_gen_mm_list */
+	unsigned long mms;	/* mm_structs walked */
+	unsigned long ptes;	/* present ptes looked at */
+	unsigned long young;	/* young ptes found and cleared */
+} lru_gen_walk_stats;
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	if (!lru_gen_enabled())
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	if (!lru_gen_enabled())
+		return;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_del(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+/*
+ * Promote @page, found young in a page table, to the youngest generation
+ * of its zone.  Only page->flags is updated: the page is moved to its new
+ * list when reclaim comes across it in the oldest generation.
+ */
+static void lru_gen_promote_page(struct page *page)
+{
+	struct lru_gen *lrugen = &page_zone(page)->lrugen;
+	int file = !!page_is_file_cache(page);
+	int gen = lru_gen_from_seq(ACCESS_ONCE(lrugen->max_seq[file]));
+
+	if (page_lru_gen(page) != gen)
+		set_page_lru_gen(page, gen);
+}
+
+/*
+ * The accessed bits are cleared without flushing the TLB, as in
+ * clear_refs: a stale TLB entry only means the next access of the page
+ * is not noticed until the entry is evicted.
+ */
+static void lru_gen_walk_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
+				   unsigned long addr, unsigned long end)
+{
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct page *page;
+
+		if (!pte_present(ptent))
+			continue;
+		lru_gen_walk_stats.ptes++;
+		if (!pte_young(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || !PageLRU(page) || PageUnevictable(page))
+			continue;
+		if (!ptep_test_and_clear_young(vma, addr, pte))
+			continue;
+
+		lru_gen_walk_stats.young++;
+		lru_gen_promote_page(page);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+}
+
+static void lru_gen_walk_pmd_range(struct vm_area_struct *vma, pud_t *pud,
+				   unsigned long addr, unsigned long end)
+{
+	pmd_t *pmd;
+	unsigned long next;
+
+	pmd = pmd_offset(pud, addr);
+	do {
+		next = pmd_addr_end(addr, end);
+		if (pmd_none_or_clear_bad(pmd))
+			continue;
+		lru_gen_walk_pte_range(vma, pmd, addr, next);
+		cond_resched();
+	} while (pmd++, addr = next, addr != end);
+}
+
+static void lru_gen_walk_pud_range(struct vm_area_struct *vma, pgd_t *pgd,
+				   unsigned long addr, unsigned long end)
+{
+	pud_t *pud;
+	unsigned long next;
+
+	pud = pud_offset(pgd, addr);
+	do {
+		next = pud_addr_end(addr, end);
+		if (pud_none_or_clear_bad(pud))
+			continue;
+		lru_gen_walk_pmd_range(vma, pud, addr, next);
+	} while (pud++, addr = next, addr != end);
+}
+
+static void lru_gen_walk_vma(struct vm_area_struct *vma)
+{
+	unsigned long addr = vma->vm_start;
+	unsigned long end = vma->vm_end;
+	unsigned long next;
+	pgd_t *pgd;
+
+	pgd = pgd_offset(vma->vm_mm, addr);
+	do {
+		next = pgd_addr_end(addr, end);
+		if (pgd_none_or_clear_bad(pgd))
+			continue;
+		lru_gen_walk_pud_range(vma, pgd, addr, next);
+	} while (pgd++, addr = next, addr != end);
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+
+	/* Do not wait behind a page fault or an munmap, just skip the mm */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_IO | VM_PFNMAP | VM_LOCKED |
+				     VM_RESERVED))
+			continue;
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		lru_gen_walk_vma(vma);
+	}
+	up_read(&mm->mmap_sem);
+
+	lru_gen_walk_stats.mms++;
+}
+
+/* Called with lru_gen_walk_mutex held */
+static void lru_gen_walk_mm_list(void)
+{
+	struct mm_struct *prev_mm = NULL;
+	struct list_head *p = &lru_gen_mm_list;
+
+	spin_lock(&lru_gen_mm_lock);
+	while ((p = p->next) != &lru_gen_mm_list) {
+		struct mm_struct *mm;
+
+		mm = list_entry(p, struct mm_struct, lru_gen_list);
+		if (!atomic_inc_not_zero(&mm->mm_users))
+			continue;
+		spin_unlock(&lru_gen_mm_lock);
+
+		if (prev_mm)
+			mmput(prev_mm);
+		prev_mm = mm;
+
+		lru_gen_walk_mm(mm);
+		cond_resched();
+
+		spin_lock(&lru_gen_mm_lock);
+	}
+	spin_unlock(&lru_gen_mm_lock);
+
+	if (prev_mm)
+		mmput(prev_mm);
+	lru_gen_walk_stats.walks++;
+}
+
+/*
+ * Open a new youngest generation of type @file in @zone.  kswapd then
+ * promotes the pages that were referenced through a page table into it.
+ */
+static void lru_gen_age(struct zone *zone, int file)
+{
+	struct lru_gen *lrugen = &zone->lrugen;
+
+	spin_lock_irq(&zone->lru_lock);
+	if (lru_gen_nr_gens(lrugen, file) <= MIN_NR_GENS)
+		lrugen->max_seq[file]++;
+	spin_unlock_irq(&zone->lru_lock);
+
+	/*
+	 * Direct reclaimers do not wait for the walk, nor start another
+	 * one while kswapd is at it.
+	 */
+	if (current_is_kswapd() && mutex_trylock(&lru_gen_walk_mutex)) {
+		lru_gen_walk_mm_list();
+		mutex_unlock(&lru_gen_walk_mutex);
+	}
+}
+
+/*
+ * The multi-generational counterpart of shrink_inactive_list(): evict up
+ * to @max_scan pages of type @file from the oldest generations of @zone.
+ */
+static unsigned long lru_gen_shrink_list(unsigned long max_scan,
+			struct zone *zone, struct scan_control *sc,
+			int priority, int file)
+{
+	LIST_HEAD(page_list);
+	struct pagevec pvec;
+	unsigned long nr_scanned = 0;
+	unsigned long nr_reclaimed = 0;
+	struct zone_reclaim_stat *reclaim_stat = &zone->reclaim_stat;
+	int lru = LRU_BASE + file * LRU_FILE;
+	int aged = 0;
+
+	pagevec_init(&pvec, 1);
+
+	lru_add_drain();
+	spin_lock_irq(&zone->lru_lock);
+	do {
+		unsigned long nr_taken;
+		unsigned long nr_scan;
+		unsigned long nr_freed;
+		unsigned long nr_active;
+		unsigned int count[NR_LRU_LISTS] = { 0, };
+
+		nr_taken = lru_gen_isolate_pages(zone, file,
+				sc->swap_cluster_max, &page_list, &nr_scan);
+		if (!nr_scan) {
+			if (aged || !(zone_page_state(zone, NR_LRU_BASE + lru) +
+				      zone_page_state(zone, NR_LRU_BASE + lru +
+						      LRU_ACTIVE)))
+				break;
+			spin_unlock_irq(&zone->lru_lock);
+			lru_gen_age(zone, file);
+			aged = 1;
+			spin_lock_irq(&zone->lru_lock);
+			continue;
+		}
+
+		nr_active = clear_active_flags(&page_list, count);
+		__count_vm_events(PGDEACTIVATE, nr_active);
+
+		__mod_zone_page_state(zone, NR_ACTIVE_FILE,
+						-count[LRU_ACTIVE_FILE]);
+		__mod_zone_page_state(zone, NR_INACTIVE_FILE,
+						-count[LRU_INACTIVE_FILE]);
+		__mod_zone_page_state(zone, NR_ACTIVE_ANON,
+						-count[LRU_ACTIVE_ANON]);
+		__mod_zone_page_state(zone, NR_INACTIVE_ANON,
+						-count[LRU_INACTIVE_ANON]);
+
+		zone->pages_scanned += nr_scan;
+		reclaim_stat->recent_scanned[file] += nr_taken;
+
+		spin_unlock_irq(&zone->lru_lock);
+
+		nr_scanned += nr_scan;
+		nr_freed = shrink_page_list(&page_list, sc, PAGEOUT_IO_ASYNC);
+		nr_reclaimed += nr_freed;
+
+		local_irq_disable();
+		if (current_is_kswapd()) {
+			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scan);
+			__count_vm_events(KSWAPD_STEAL, nr_freed);
+		} else
+			__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scan);
+
+		__count_zone_vm_events(PGSTEAL, zone, nr_freed);
+
+		spin_lock(&zone->lru_lock);
+		putback_inactive_pages(zone, reclaim_stat, &page_list, &pvec);
+	} while (nr_scanned < max_scan);
+	spin_unlock_irq(&zone->lru_lock);
+	pagevec_release(&pvec);
+	return nr_reclaimed;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int lru_gen_debugfs_show(struct seq_file *m, void *v)
+{
+	struct zone *zone;
+
+	for_each_zone(zone) {
+		struct lru_gen *lrugen = &zone->lrugen;
+
+		if (!populated_zone(zone))
+			continue;
+
+		seq_printf(m, "Node %d, zone %8s\n",
+			   zone->zone_pgdat->node_id, zone->name);
+		seq_printf(m, "  anon   min_seq %lu max_seq %lu\n",
+			   lrugen->min_seq[0], lrugen->max_seq[0]);
+		seq_printf(m, "  file   min_seq %lu max_seq %lu\n",
+			   lrugen->min_seq[1], lrugen->max_seq[1]);
+		seq_printf(m, "  sorted %lu\n", lrugen->nr_sorted);
+	}
+
+	seq_printf(m, "walks %lu\nmms   %lu\nptes  %lu\nyoung %lu\n",
+		   lru_gen_walk_stats.walks, lru_gen_walk_stats.mms,
+		   lru_gen_walk_stats.ptes, lru_gen_walk_stats.young);
+	return 0;
+}
+
+static int lru_gen_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_debugfs_show, NULL);
+}
+
+static const struct file_operations lru_gen_debugfs_fops = {
+	.open		= lru_gen_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lru_gen_debugfs_init(void)
+{
+	if (lru_gen_enabled())
+		debugfs_create_file("lru_gen", 0444, NULL, NULL,
+				    &lru_gen_debugfs_fops);
+	return 0;
+}
+late_initcall(lru_gen_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+
+#else /* !CONFIG_LRU_GEN */
+
+static unsigned long lru_gen_shrink_list(unsigned long max_scan,
+			struct zone *zone, struct scan_control *sc,
+			int priority, int file)
+{
+	return 0;
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static int inactive_anon_is_low_global(struct zone *zone)
 {
 	unsigned long active, inactive;
@@ -1337,6 +1833,10 @@ static int inactive_anon_is_low(struct zone *zone, struct scan_control *sc)
 {
 	int low;
 
+	/* Generations take the place of the active/inactive balance */
+	if (lru_gen_enabled() && scanning_global_lru(sc))
+		return 0;
+
 	if (scanning_global_lru(sc))
 		low = inactive_anon_is_low_global(zone);
 	else
@@ -1349,6 +1849,14 @@ static unsigned long shrink_list(enum lru_list lru, unsigned long nr_to_scan,
 {
 	int file = is_file_lru(lru);
 
+	/*
+	 * With generations, each type is one set of lists and the scan
+	 * budgets of its active and inactive lists go to evicting it.
+	 */
+	if (lru_gen_enabled() && scanning_global_lru(sc))
+		return lru_gen_shrink_list(nr_to_scan, zone, sc, priority,
+					   file);
+
 	if (lru == LRU_ACTIVE_FILE) {
 		shrink_active_list(nr_to_scan, zone, sc, priority, file);
 		return 0;
@@ -1461,7 +1969,9 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long percent[2];	/* anon @ 0; file @ 1 */
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
+	unsigned long nr_scanned = sc->nr_scanned;
 	unsigned long swap_cluster_max = sc->swap_cluster_max;
+	unsigned long reclaimed_before = nr_reclaimed;
 
 	get_scan_ratio(zone, sc, percent);
 
@@ -1518,6 +2028,10 @@ static void shrink_zone(int priority, struct zone *zone,
 	if (inactive_anon_is_low(zone, sc))
 		shrink_active_list(SWAP_CLUSTER_MAX, zone, sc, priority, 0);
 
+	vmpressure(sc->gfp_mask, sc->mem_cgroup,
+		   sc->nr_scanned - nr_scanned,
+		   sc->nr_reclaimed - reclaimed_before);
+
 	throttle_vm_writeout(sc->gfp_mask);
 }
 
@@ -1600,8 +2114,10 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 	enum zone_type high_zoneidx = gfp_zone(sc->gfp_mask);
+	struct memstall ms;
 
 	delayacct_freepages_start();
+	memstall_enter(&ms);
 
 	if (scanning_global_lru(sc))
 		count_vm_event(ALLOCSTALL);
@@ -1622,6 +2138,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token();
+		vmpressure_prio(sc->gfp_mask, sc->mem_cgroup, priority);
 		shrink_zones(priority, zonelist, sc);
 		/*
 		 * Don't shrink slabs when reclaiming memory from
@@ -1682,6 +2199,7 @@ out:
 	} else
 		mem_cgroup_record_reclaim_priority(sc->mem_cgroup, priority);
 
+	memstall_leave(&ms);
 	delayacct_freepages_end();
 
 	return ret;
@@ -1730,6 +2248,37 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
 	zonelist = NODE_DATA(numa_node_id())->node_zonelists;
 	return do_try_to_free_pages(zonelist, &sc);
 }
+
+/*
+ * Reclaim from the pages @mem has in @zone only.  Used by kswapd to
+ * push cgroups back towards their soft limit before it reclaims from
+ * the zone as a whole.
+ */
+unsigned long mem_cgroup_shrink_zone(struct mem_cgroup *mem,
+				     struct zone *zone, gfp_t gfp_mask,
+				     bool noswap, unsigned int swappiness)
+{
+	struct scan_control sc = {
+		.may_writepage = !laptop_mode,
+		.may_swap = !noswap,
+		.swap_cluster_max = SWAP_CLUSTER_MAX,
+		.swappiness = swappiness,
+		.order = 0,
+		.mem_cgroup = mem,
+		.isolate_pages = mem_cgroup_isolate_pages,
+	};
+	int priority;
+
+	sc.gfp_mask = (gfp_mask & GFP_RECLAIM_MASK) |
+			(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK);
+
+	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
+		shrink_zone(priority, zone, &sc);
+		if (sc.nr_reclaimed >= sc.swap_cluster_max)
+			break;
+	}
+	return sc.nr_reclaimed;
+}
 #endif
 
 /*
@@ -1857,6 +2406,12 @@ loop_again:
 			temp_priority[i] = priority;
 			sc.nr_scanned = 0;
 			note_zone_scanning_priority(zone, priority);
+			/*
+			 * Cgroups above their soft limit give back memory
+			 * before everybody else is made to.
+			 */
+			sc.nr_reclaimed += mem_cgroup_soft_limit_reclaim(zone,
+							order, sc.gfp_mask);
 			/*
 			 * We put equal pressure on every zone, unless one
 			 * zone has way too many pages free already.
@@ -2454,7 +3009,7 @@ retry:
 		enum lru_list l = LRU_INACTIVE_ANON + page_is_file_cache(page);
 
 		__dec_zone_state(zone, NR_UNEVICTABLE);
-		list_move(&page->lru, &zone->lru[l].list);
+		move_page_to_lru_list(zone, page, l);
 		mem_cgroup_move_lists(page, LRU_UNEVICTABLE, l);
 		__inc_zone_state(zone, NR_INACTIVE_ANON + l);
 		__count_vm_event(UNEVICTABLE_PGRESCUED);
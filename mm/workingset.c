@@ -0,0 +1,343 @@
+/*
+ * mm/workingset.c - workingset detection for the page cache
+ *
+ * The file LRU is split into an inactive and an active list.  New pages
+ * start out on the inactive list and are promoted to the active list
+ * when they are referenced a second time while still cached.  A page
+ * that is used over and over, but whose reuse distance is longer than
+ * the inactive list, never gets that second reference in: it is evicted
+ * and read back in again and again, while a single streaming read of a
+ * large file keeps the active list full of pages that will never be
+ * used again.
+ *
+ * To tell those two apart, every zone keeps a counter of inactive list
+ * "ages" (inactive_age), bumped on every eviction and every activation
+ * from the inactive list.  When a page cache page is reclaimed, the
+ * current counter is stored in the page's slot in the mapping's radix
+ * tree, as an exceptional shadow entry.  When the page is faulted back
+ * in, the difference between the counter then and the one remembered
+ * in the shadow is the number of pages that left the inactive list in
+ * between: the refault distance.
+ *
+ * Had the inactive list been refault distance pages larger, the page
+ * would still have been cached.  Since the active list is the only
+ * place that room could have come from, a refault distance smaller
+ * than the active list means the page belongs to a working set that
+ * is being thrashed: it is activated straight away, to compete with
+ * the existing active pages.  Pages refaulting from further away are
+ * treated as new pages and start out inactive, so a streaming read
+ * cannot push out the working set.
+ *
+ * Shadow entries are only worth keeping while their refault distance
+ * can still be smaller than the active list, so a shrinker trims them
+ * once there are more shadow entries than file LRU pages.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
+#include <linux/radix-tree.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zonep,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction, refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zonep = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zonep)->inactive_age);
+	/*
+	 * The counter may have wrapped since the eviction; as long as
+	 * it did not go around entirely, the masked difference is still
+	 * the distance.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/*
+ * Mappings that have shadow entries in their page tree are kept on a
+ * list for the shrinker.  The list lock nests inside the tree_lock.
+ */
+static LIST_HEAD(shadow_mappings);
+static DEFINE_SPINLOCK(shadow_lock);
+static atomic_long_t nr_shadow_entries = ATOMIC_LONG_INIT(0);
+
+/*
+ * Account a shadow entry stored in @mapping.  Caller holds the
+ * mapping's tree_lock with interrupts disabled.
+ */
+void workingset_shadow_added(struct address_space *mapping)
+{
+	if (!mapping->nrshadows++) {
+		spin_lock(&shadow_lock);
+		list_add_tail(&mapping->shadow_list, &shadow_mappings);
+		spin_unlock(&shadow_lock);
+	}
+	atomic_long_inc(&nr_shadow_entries);
+}
+
+/*
+ * Account a shadow entry removed from @mapping.  Caller holds the
+ * mapping's tree_lock with interrupts disabled.
+ */
+void workingset_shadow_removed(struct address_space *mapping)
+{
+	VM_BUG_ON(!mapping->nrshadows);
+	if (!--mapping->nrshadows) {
+		spin_lock(&shadow_lock);
+		list_del_init(&mapping->shadow_list);
+		spin_unlock(&shadow_lock);
+	}
+	atomic_long_dec(&nr_shadow_entries);
+}
+
+/*
+ * Delete the shadow entries between *@index and @end with the tree_lock
+ * held, looking at no more than *@nr_to_scan slots.  Both are advanced
+ * past the slots that were looked at; returns false once there is
+ * nothing left to scan.
+ */
+static bool __clear_shadow_entries(struct address_space *mapping,
+		pgoff_t *index, pgoff_t end, long *nr_to_scan)
+{
+	void **slots[PAGEVEC_SIZE];
+	unsigned long indices[PAGEVEC_SIZE];
+
+	while (*nr_to_scan > 0) {
+		unsigned int i, nr_found, nr = 0;
+		unsigned long last;
+
+		if (!mapping->nrshadows || *index > end)
+			return false;
+		nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+				slots, indices, *index,
+				min_t(long, *nr_to_scan, PAGEVEC_SIZE));
+		if (!nr_found)
+			return false;
+		*nr_to_scan -= nr_found;
+		last = indices[nr_found - 1];
+
+		/*
+		 * Collect the shadows before deleting any: a deletion may
+		 * free tree nodes and invalidate the other slot pointers.
+		 */
+		for (i = 0; i < nr_found; i++) {
+			if (indices[i] > end)
+				break;
+			if (radix_tree_exceptional_entry(
+					radix_tree_deref_slot(slots[i])))
+				indices[nr++] = indices[i];
+		}
+		for (i = 0; i < nr; i++) {
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			workingset_shadow_removed(mapping);
+		}
+		if (last >= end)
+			return false;
+		*index = last + 1;
+	}
+	return true;
+}
+
+/**
+ * clear_shadow_entries - remove shadow entries from a mapping
+ * @mapping: the address_space
+ * @start: first page index
+ * @end: last page index, inclusive
+ *
+ * Removes the shadow entries of evicted pages between @start and @end
+ * from @mapping, after its pages have been truncated.  The tree_lock
+ * is dropped every SWAP_CLUSTER_MAX slots.
+ */
+void clear_shadow_entries(struct address_space *mapping,
+			  pgoff_t start, pgoff_t end)
+{
+	pgoff_t index = start;
+	bool more;
+
+	do {
+		long nr_to_scan = SWAP_CLUSTER_MAX;
+
+		spin_lock_irq(&mapping->tree_lock);
+		more = __clear_shadow_entries(mapping, &index, end,
+					      &nr_to_scan);
+		spin_unlock_irq(&mapping->tree_lock);
+		cond_resched();
+	} while (more);
+}
+
+/*
+ * A shadow entry is only useful while its refault distance can still
+ * be smaller than the active file list.  Allow as many of them as
+ * there are file LRU pages and reclaim the excess.
+ */
+static long shadow_entries_excess(void)
+{
+	long max = global_page_state(NR_ACTIVE_FILE) +
+		   global_page_state(NR_INACTIVE_FILE);
+
+	return atomic_long_read(&nr_shadow_entries) - max;
+}
+
+/*
+ * The shrinker works on the mapping at the head of shadow_mappings
+ * until it has no shadow entries left, then rotates it to the tail.
+ * shadow_cursor remembers how far it got; protected by shadow_lock.
+ */
+static struct {
+	struct address_space *mapping;
+	pgoff_t index;
+} shadow_cursor;
+
+static int shrink_shadow_entries(int nr_to_scan, gfp_t gfp_mask)
+{
+	long nr = nr_to_scan;
+	long excess;
+
+	while (nr > 0 && shadow_entries_excess() > 0) {
+		struct address_space *mapping;
+		pgoff_t index;
+		bool more;
+
+		spin_lock_irq(&shadow_lock);
+		if (list_empty(&shadow_mappings)) {
+			spin_unlock_irq(&shadow_lock);
+			break;
+		}
+		mapping = list_first_entry(&shadow_mappings,
+					   struct address_space, shadow_list);
+		/*
+		 * The tree_lock nests outside of the shadow_lock.  Once it
+		 * is held the mapping cannot go away: clear_inode() takes
+		 * it to drop the remaining shadow entries.
+		 */
+		if (!spin_trylock(&mapping->tree_lock)) {
+			list_move_tail(&mapping->shadow_list, &shadow_mappings);
+			spin_unlock_irq(&shadow_lock);
+			nr--;
+			continue;
+		}
+		if (shadow_cursor.mapping != mapping) {
+			shadow_cursor.mapping = mapping;
+			shadow_cursor.index = 0;
+		}
+		index = shadow_cursor.index;
+		spin_unlock(&shadow_lock);
+
+		more = __clear_shadow_entries(mapping, &index, ~0UL, &nr);
+		spin_unlock(&mapping->tree_lock);
+
+		/*
+		 * The mapping may be gone by now; it is only touched again
+		 * if it is still on the list.
+		 */
+		spin_lock(&shadow_lock);
+		if (shadow_cursor.mapping == mapping &&
+		    !list_empty(&shadow_mappings) &&
+		    list_first_entry(&shadow_mappings, struct address_space,
+				     shadow_list) == mapping) {
+			if (more)
+				shadow_cursor.index = index;
+			else {
+				list_move_tail(&mapping->shadow_list,
+					       &shadow_mappings);
+				shadow_cursor.mapping = NULL;
+			}
+		}
+		spin_unlock_irq(&shadow_lock);
+	}
+
+	excess = shadow_entries_excess();
+	if (excess <= 0)
+		return 0;
+	return min_t(long, excess, INT_MAX);
+}
+
+static struct shrinker workingset_shadow_shrinker = {
+	.shrink = shrink_shadow_entries,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&workingset_shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
@@ -99,6 +99,9 @@ static void __exit br_deinit(void)
 	br_fdb_put_hook = NULL;
 
 	br_handle_frame_hook = NULL;
+
+	/* wait for the forwarding and multicast entries freed via RCU */
+	rcu_barrier();
 	br_fdb_fini();
 }
 
@@ -20,6 +20,9 @@
 #include <linux/etherdevice.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <asm/atomic.h>
 #include <asm/unaligned.h>
 #include "br_private.h"
@@ -48,6 +51,58 @@ void br_fdb_fini(void)
 	kmem_cache_destroy(br_fdb_cache);
 }
 
+static struct hlist_head *fdb_alloc_buckets(unsigned int size)
+{
+	struct hlist_head *buckets;
+	size_t bytes = size * sizeof(struct hlist_head);
+
+	if (bytes <= PAGE_SIZE)
+		buckets = kmalloc(bytes, GFP_KERNEL);
+	else
+		buckets = vmalloc(bytes);
+
+	if (buckets) {
+		unsigned int i;
+
+		for (i = 0; i < size; i++)
+			INIT_HLIST_HEAD(&buckets[i]);
+	}
+	return buckets;
+}
+
+static void fdb_free_buckets(struct hlist_head *buckets, unsigned int size)
+{
+	if (size * sizeof(struct hlist_head) <= PAGE_SIZE)
+		kfree(buckets);
+	else
+		vfree(buckets);
+}
+
+static struct net_bridge_fdb_htable *fdb_htable_alloc(unsigned int size,
+						      unsigned int ver)
+{
+	struct net_bridge_fdb_htable *tbl;
+
+	tbl = kmalloc(sizeof(*tbl), GFP_KERNEL);
+	if (!tbl)
+		return NULL;
+
+	tbl->buckets = fdb_alloc_buckets(size);
+	if (!tbl->buckets) {
+		kfree(tbl);
+		return NULL;
+	}
+	tbl->size = size;
+	tbl->ver = ver;
+	return tbl;
+}
+
+static void fdb_htable_free(struct net_bridge_fdb_htable *tbl)
+{
+	fdb_free_buckets(tbl->buckets, tbl->size);
+	kfree(tbl);
+}
+
 
 /* if topology_changing then use forward_delay (default 15 sec)
  * otherwise keep longer (default 5 minutes)
@@ -64,33 +119,104 @@ static inline int has_expired(const struct net_bridge *br,
 		&& time_before_eq(fdb->ageing_timer + hold_time(br), jiffies);
 }
 
-static inline int br_mac_hash(const unsigned char *mac)
+static inline int br_mac_hash(const struct net_bridge_fdb_htable *tbl,
+			      const unsigned char *mac)
 {
 	/* use 1 byte of OUI cnd 3 bytes of NIC */
 	u32 key = get_unaligned((u32 *)(mac + 2));
-	return jhash_1word(key, fdb_salt) & (BR_HASH_SIZE - 1);
+	return jhash_1word(key, fdb_salt) & (tbl->size - 1);
 }
 
-static inline void fdb_delete(struct net_bridge_fdb_entry *f)
+/* Caller holds hash_lock, so the table cannot be swapped under us. */
+static inline void fdb_delete(struct net_bridge *br,
+			      struct net_bridge_fdb_entry *f)
 {
-	hlist_del_rcu(&f->hlist);
+	hlist_del_rcu(&f->hlist[br->fdb_table->ver]);
+	br->fdb_count--;
 	br_fdb_put(f);
 }
 
+/*
+ * Grow the hash table once it holds more entries than buckets.  Every
+ * entry has a hash node for each of two table versions: the entries are
+ * linked into the new table through the node the current table does not
+ * use, so readers walking the old table under RCU are not disturbed.
+ * The old table can only be freed, and its nodes reused by the next
+ * resize, after a grace period.
+ */
+static void br_fdb_resize(struct work_struct *work)
+{
+	struct net_bridge *br = container_of(work, struct net_bridge,
+					     fdb_resize_work);
+	struct net_bridge_fdb_htable *old, *new;
+	struct net_bridge_fdb_entry *f;
+	struct hlist_node *h;
+	unsigned int size, i;
+
+	spin_lock_bh(&br->hash_lock);
+	size = br->fdb_table->size * 2;
+	while (size < br->fdb_count && size < BR_HASH_MAX)
+		size *= 2;
+	spin_unlock_bh(&br->hash_lock);
+
+	new = fdb_htable_alloc(size, !br->fdb_table->ver);
+	if (!new)
+		goto out;
+
+	spin_lock_bh(&br->hash_lock);
+	old = br->fdb_table;
+	for (i = 0; i < old->size; i++) {
+		hlist_for_each_entry(f, h, &old->buckets[i], hlist[old->ver])
+			hlist_add_head_rcu(&f->hlist[new->ver],
+					   &new->buckets[br_mac_hash(new, f->addr.addr)]);
+	}
+	rcu_assign_pointer(br->fdb_table, new);
+	spin_unlock_bh(&br->hash_lock);
+
+	synchronize_rcu();
+	fdb_htable_free(old);
+out:
+	spin_lock_bh(&br->hash_lock);
+	br->fdb_resizing = 0;
+	spin_unlock_bh(&br->hash_lock);
+}
+
+int br_fdb_hash_init(struct net_bridge *br)
+{
+	br->fdb_table = fdb_htable_alloc(BR_HASH_SIZE, 0);
+	if (!br->fdb_table)
+		return -ENOMEM;
+
+	br->fdb_count = 0;
+	br->fdb_resizing = 0;
+	INIT_WORK(&br->fdb_resize_work, br_fdb_resize);
+	return 0;
+}
+
+/* Called once the bridge device is unregistered and has no ports left. */
+void br_fdb_hash_fini(struct net_bridge *br)
+{
+	cancel_work_sync(&br->fdb_resize_work);
+	fdb_htable_free(br->fdb_table);
+}
+
 void br_fdb_changeaddr(struct net_bridge_port *p, const unsigned char *newaddr)
 {
 	struct net_bridge *br = p->br;
+	struct net_bridge_fdb_htable *tbl;
 	int i;
 
 	spin_lock_bh(&br->hash_lock);
 
 	/* Search all chains since old address/hash is unknown */
-	for (i = 0; i < BR_HASH_SIZE; i++) {
+	tbl = br->fdb_table;
+	for (i = 0; i < tbl->size; i++) {
 		struct hlist_node *h;
-		hlist_for_each(h, &br->hash[i]) {
+		hlist_for_each(h, &tbl->buckets[i]) {
 			struct net_bridge_fdb_entry *f;
 
-			f = hlist_entry(h, struct net_bridge_fdb_entry, hlist);
+			f = hlist_entry(h, struct net_bridge_fdb_entry,
+					hlist[tbl->ver]);
 			if (f->dst == p && f->is_local) {
 				/* maybe another port has same hw addr? */
 				struct net_bridge_port *op;
@@ -104,7 +230,7 @@ void br_fdb_changeaddr(struct net_bridge_port *p, const unsigned char *newaddr)
 				}
 
 				/* delete old one */
-				fdb_delete(f);
+				fdb_delete(br, f);
 				goto insert;
 			}
 		}
@@ -121,20 +247,23 @@ void br_fdb_cleanup(unsigned long _data)
 	struct net_bridge *br = (struct net_bridge *)_data;
 	unsigned long delay = hold_time(br);
 	unsigned long next_timer = jiffies + br->forward_delay;
+	struct net_bridge_fdb_htable *tbl;
 	int i;
 
 	spin_lock_bh(&br->hash_lock);
-	for (i = 0; i < BR_HASH_SIZE; i++) {
+	tbl = br->fdb_table;
+	for (i = 0; i < tbl->size; i++) {
 		struct net_bridge_fdb_entry *f;
 		struct hlist_node *h, *n;
 
-		hlist_for_each_entry_safe(f, h, n, &br->hash[i], hlist) {
+		hlist_for_each_entry_safe(f, h, n, &tbl->buckets[i],
+					  hlist[tbl->ver]) {
 			unsigned long this_timer;
 			if (f->is_static)
 				continue;
 			this_timer = f->ageing_timer + delay;
 			if (time_before_eq(this_timer, jiffies))
-				fdb_delete(f);
+				fdb_delete(br, f);
 			else if (time_before(this_timer, next_timer))
 				next_timer = this_timer;
 		}
@@ -149,15 +278,18 @@ void br_fdb_cleanup(unsigned long _data)
 /* Completely flush all dynamic entries in forwarding database.*/
 void br_fdb_flush(struct net_bridge *br)
 {
+	struct net_bridge_fdb_htable *tbl;
 	int i;
 
 	spin_lock_bh(&br->hash_lock);
-	for (i = 0; i < BR_HASH_SIZE; i++) {
+	tbl = br->fdb_table;
+	for (i = 0; i < tbl->size; i++) {
 		struct net_bridge_fdb_entry *f;
 		struct hlist_node *h, *n;
-		hlist_for_each_entry_safe(f, h, n, &br->hash[i], hlist) {
+		hlist_for_each_entry_safe(f, h, n, &tbl->buckets[i],
+					  hlist[tbl->ver]) {
 			if (!f->is_static)
-				fdb_delete(f);
+				fdb_delete(br, f);
 		}
 	}
 	spin_unlock_bh(&br->hash_lock);
@@ -170,15 +302,18 @@ void br_fdb_delete_by_port(struct net_bridge *br,
 			   const struct net_bridge_port *p,
 			   int do_all)
 {
+	struct net_bridge_fdb_htable *tbl;
 	int i;
 
 	spin_lock_bh(&br->hash_lock);
-	for (i = 0; i < BR_HASH_SIZE; i++) {
+	tbl = br->fdb_table;
+	for (i = 0; i < tbl->size; i++) {
 		struct hlist_node *h, *g;
 
-		hlist_for_each_safe(h, g, &br->hash[i]) {
+		hlist_for_each_safe(h, g, &tbl->buckets[i]) {
 			struct net_bridge_fdb_entry *f
-				= hlist_entry(h, struct net_bridge_fdb_entry, hlist);
+				= hlist_entry(h, struct net_bridge_fdb_entry,
+					      hlist[tbl->ver]);
 			if (f->dst != p)
 				continue;
 
@@ -201,7 +336,7 @@ void br_fdb_delete_by_port(struct net_bridge *br,
 				}
 			}
 
-			fdb_delete(f);
+			fdb_delete(br, f);
 		skip_delete: ;
 		}
 	}
@@ -212,10 +347,12 @@ void br_fdb_delete_by_port(struct net_bridge *br,
 struct net_bridge_fdb_entry *__br_fdb_get(struct net_bridge *br,
 					  const unsigned char *addr)
 {
+	struct net_bridge_fdb_htable *tbl = rcu_dereference(br->fdb_table);
 	struct hlist_node *h;
 	struct net_bridge_fdb_entry *fdb;
 
-	hlist_for_each_entry_rcu(fdb, h, &br->hash[br_mac_hash(addr)], hlist) {
+	hlist_for_each_entry_rcu(fdb, h, &tbl->buckets[br_mac_hash(tbl, addr)],
+				 hlist[tbl->ver]) {
 		if (!compare_ether_addr(fdb->addr.addr, addr)) {
 			if (unlikely(has_expired(br, fdb)))
 				break;
@@ -263,14 +400,17 @@ int br_fdb_fillbuf(struct net_bridge *br, void *buf,
 {
 	struct __fdb_entry *fe = buf;
 	int i, num = 0;
+	struct net_bridge_fdb_htable *tbl;
 	struct hlist_node *h;
 	struct net_bridge_fdb_entry *f;
 
 	memset(buf, 0, maxnum*sizeof(struct __fdb_entry));
 
 	rcu_read_lock();
-	for (i = 0; i < BR_HASH_SIZE; i++) {
-		hlist_for_each_entry_rcu(f, h, &br->hash[i], hlist) {
+	tbl = rcu_dereference(br->fdb_table);
+	for (i = 0; i < tbl->size; i++) {
+		hlist_for_each_entry_rcu(f, h, &tbl->buckets[i],
+					 hlist[tbl->ver]) {
 			if (num >= maxnum)
 				goto out;
 
@@ -303,36 +443,46 @@ int br_fdb_fillbuf(struct net_bridge *br, void *buf,
 	return num;
 }
 
-static inline struct net_bridge_fdb_entry *fdb_find(struct hlist_head *head,
+static inline struct net_bridge_fdb_entry *fdb_find(struct net_bridge_fdb_htable *tbl,
 						    const unsigned char *addr)
 {
+	struct hlist_head *head = &tbl->buckets[br_mac_hash(tbl, addr)];
 	struct hlist_node *h;
 	struct net_bridge_fdb_entry *fdb;
 
-	hlist_for_each_entry_rcu(fdb, h, head, hlist) {
+	hlist_for_each_entry_rcu(fdb, h, head, hlist[tbl->ver]) {
 		if (!compare_ether_addr(fdb->addr.addr, addr))
 			return fdb;
 	}
 	return NULL;
 }
 
-static struct net_bridge_fdb_entry *fdb_create(struct hlist_head *head,
+/* Caller holds hash_lock */
+static struct net_bridge_fdb_entry *fdb_create(struct net_bridge *br,
 					       struct net_bridge_port *source,
 					       const unsigned char *addr,
 					       int is_local)
 {
+	struct net_bridge_fdb_htable *tbl = br->fdb_table;
 	struct net_bridge_fdb_entry *fdb;
 
 	fdb = kmem_cache_alloc(br_fdb_cache, GFP_ATOMIC);
 	if (fdb) {
 		memcpy(fdb->addr.addr, addr, ETH_ALEN);
 		atomic_set(&fdb->use_count, 1);
-		hlist_add_head_rcu(&fdb->hlist, head);
-
 		fdb->dst = source;
 		fdb->is_local = is_local;
 		fdb->is_static = is_local;
 		fdb->ageing_timer = jiffies;
+
+		hlist_add_head_rcu(&fdb->hlist[tbl->ver],
+				   &tbl->buckets[br_mac_hash(tbl, addr)]);
+
+		if (++br->fdb_count > tbl->size && tbl->size < BR_HASH_MAX &&
+		    !br->fdb_resizing) {
+			br->fdb_resizing = 1;
+			schedule_work(&br->fdb_resize_work);
+		}
 	}
 	return fdb;
 }
@@ -340,13 +490,12 @@ static struct net_bridge_fdb_entry *fdb_create(struct hlist_head *head,
 static int fdb_insert(struct net_bridge *br, struct net_bridge_port *source,
 		  const unsigned char *addr)
 {
-	struct hlist_head *head = &br->hash[br_mac_hash(addr)];
 	struct net_bridge_fdb_entry *fdb;
 
 	if (!is_valid_ether_addr(addr))
 		return -EINVAL;
 
-	fdb = fdb_find(head, addr);
+	fdb = fdb_find(br->fdb_table, addr);
 	if (fdb) {
 		/* it is okay to have multiple ports with same
 		 * address, just use the first one.
@@ -357,10 +506,10 @@ static int fdb_insert(struct net_bridge *br, struct net_bridge_port *source,
 		printk(KERN_WARNING "%s adding interface with same address "
 		       "as a received packet\n",
 		       source->dev->name);
-		fdb_delete(fdb);
+		fdb_delete(br, fdb);
 	}
 
-	if (!fdb_create(head, source, addr, 1))
+	if (!fdb_create(br, source, addr, 1))
 		return -ENOMEM;
 
 	return 0;
@@ -380,7 +529,6 @@ int br_fdb_insert(struct net_bridge *br, struct net_bridge_port *source,
 void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 		   const unsigned char *addr)
 {
-	struct hlist_head *head = &br->hash[br_mac_hash(addr)];
 	struct net_bridge_fdb_entry *fdb;
 
 	/* some users want to always flood. */
@@ -392,7 +540,7 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 	      source->state == BR_STATE_FORWARDING))
 		return;
 
-	fdb = fdb_find(head, addr);
+	fdb = fdb_find(rcu_dereference(br->fdb_table), addr);
 	if (likely(fdb)) {
 		/* attempt to update an entry for a local interface */
 		if (unlikely(fdb->is_local)) {
@@ -401,14 +549,19 @@ void br_fdb_update(struct net_bridge *br, struct net_bridge_port *source,
 				       " own address as source address\n",
 				       source->dev->name);
 		} else {
-			/* fastpath: update of existing entry */
-			fdb->dst = source;
-			fdb->ageing_timer = jiffies;
+			/* fastpath: update of existing entry, without the
+			 * hash lock.  Only write when something changed so
+			 * that a busy entry's cache line stays shared.
+			 */
+			if (unlikely(fdb->dst != source))
+				fdb->dst = source;
+			if (fdb->ageing_timer != jiffies)
+				fdb->ageing_timer = jiffies;
 		}
 	} else {
 		spin_lock(&br->hash_lock);
-		if (!fdb_find(head, addr))
-			fdb_create(head, source, addr, 0);
+		if (!fdb_find(br->fdb_table, addr))
+			fdb_create(br, source, addr, 0);
 		/* else  we lose race and someone else inserts
 		 * it first, don't bother updating
 		 */
@@ -11,6 +11,7 @@
  *	2 of the License, or (at your option) any later version.
  */
 
+#include <linux/err.h>
 #include <linux/kernel.h>
 #include <linux/netdevice.h>
 #include <linux/skbuff.h>
@@ -97,6 +98,46 @@ void br_forward(const struct net_bridge_port *to, struct sk_buff *skb)
 	kfree_skb(skb);
 }
 
+static int deliver_clone(const struct net_bridge_port *prev,
+			 struct sk_buff *skb,
+			 void (*__packet_hook)(const struct net_bridge_port *p,
+					       struct sk_buff *skb))
+{
+	skb = skb_clone(skb, GFP_ATOMIC);
+	if (!skb) {
+		prev->br->dev->stats.tx_dropped++;
+		return -ENOMEM;
+	}
+
+	__packet_hook(prev, skb);
+	return 0;
+}
+
+/*
+ * Hand the previous candidate port a clone, so that the last port can be
+ * given the original skb.  Returns the new candidate or an ERR_PTR.
+ */
+static struct net_bridge_port *maybe_deliver(
+	struct net_bridge_port *prev, struct net_bridge_port *p,
+	struct sk_buff *skb,
+	void (*__packet_hook)(const struct net_bridge_port *p,
+			      struct sk_buff *skb))
+{
+	int err;
+
+	if (!should_deliver(p, skb))
+		return prev;
+
+	if (!prev)
+		return p;
+
+	err = deliver_clone(prev, skb, __packet_hook);
+	if (err)
+		return ERR_PTR(err);
+
+	return p;
+}
+
 /* called under bridge lock */
 static void br_flood(struct net_bridge *br, struct sk_buff *skb,
 	void (*__packet_hook)(const struct net_bridge_port *p,
@@ -108,21 +149,9 @@ static void br_flood(struct net_bridge *br, struct sk_buff *skb,
 	prev = NULL;
 
 	list_for_each_entry_rcu(p, &br->port_list, list) {
-		if (should_deliver(p, skb)) {
-			if (prev != NULL) {
-				struct sk_buff *skb2;
-
-				if ((skb2 = skb_clone(skb, GFP_ATOMIC)) == NULL) {
-					br->dev->stats.tx_dropped++;
-					kfree_skb(skb);
-					return;
-				}
-
-				__packet_hook(prev, skb2);
-			}
-
-			prev = p;
-		}
+		prev = maybe_deliver(prev, p, skb, __packet_hook);
+		if (IS_ERR(prev))
+			goto out;
 	}
 
 	if (prev != NULL) {
@@ -130,10 +159,10 @@ static void br_flood(struct net_bridge *br, struct sk_buff *skb,
 		return;
 	}
 
+out:
 	kfree_skb(skb);
 }
 
-
 /* called with rcu_read_lock */
 void br_flood_deliver(struct net_bridge *br, struct sk_buff *skb)
 {
@@ -145,3 +174,74 @@ void br_flood_forward(struct net_bridge *br, struct sk_buff *skb)
 {
 	br_flood(br, skb, __br_forward);
 }
+
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+static inline int br_port_group_has(struct net_bridge_port_group *pg,
+				    const struct net_bridge_port *port)
+{
+	for (; pg; pg = rcu_dereference(pg->next))
+		if (pg->port == port)
+			return 1;
+	return 0;
+}
+
+/*
+ * Send a multicast frame to the ports that have members of its group
+ * and to the ports behind which multicast routers were seen.  With a
+ * NULL mdst only the router ports get it.
+ *
+ * called with rcu_read_lock
+ */
+static void br_multicast_flood(struct net_bridge *br,
+			       struct net_bridge_mdb_entry *mdst,
+			       struct sk_buff *skb,
+			       void (*__packet_hook)(const struct net_bridge_port *p,
+						     struct sk_buff *skb))
+{
+	struct net_bridge_port_group *ports, *pg;
+	struct net_bridge_port *p, *prev;
+	struct hlist_node *h;
+
+	prev = NULL;
+	ports = mdst ? rcu_dereference(mdst->ports) : NULL;
+
+	for (pg = ports; pg; pg = rcu_dereference(pg->next)) {
+		prev = maybe_deliver(prev, pg->port, skb, __packet_hook);
+		if (IS_ERR(prev))
+			goto out;
+	}
+
+	hlist_for_each_entry_rcu(p, h, &br->router_list, rlist) {
+		if (br_port_group_has(ports, p))
+			continue;
+
+		prev = maybe_deliver(prev, p, skb, __packet_hook);
+		if (IS_ERR(prev))
+			goto out;
+	}
+
+	if (prev != NULL) {
+		__packet_hook(prev, skb);
+		return;
+	}
+
+out:
+	kfree_skb(skb);
+}
+
+/* called with rcu_read_lock */
+void br_multicast_deliver(struct net_bridge *br,
+			  struct net_bridge_mdb_entry *mdst,
+			  struct sk_buff *skb)
+{
+	br_multicast_flood(br, mdst, skb, __br_deliver);
+}
+
+/* called with rcu_read_lock */
+void br_multicast_forward(struct net_bridge *br,
+			  struct net_bridge_mdb_entry *mdst,
+			  struct sk_buff *skb)
+{
+	br_multicast_flood(br, mdst, skb, __br_forward);
+}
+#endif
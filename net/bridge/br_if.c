@@ -142,6 +142,7 @@ static void del_nbp(struct net_bridge_port *p)
 	br_ifinfo_notify(RTM_DELLINK, p);
 
 	br_fdb_delete_by_port(br, p, 1);
+	br_multicast_del_port(p);
 
 	list_del_rcu(&p->list);
 
@@ -183,6 +184,11 @@ static struct net_device *new_bridge_dev(struct net *net, const char *name)
 	br = netdev_priv(dev);
 	br->dev = dev;
 
+	if (br_fdb_hash_init(br)) {
+		free_netdev(dev);
+		return NULL;
+	}
+
 	spin_lock_init(&br->lock);
 	INIT_LIST_HEAD(&br->port_list);
 	spin_lock_init(&br->hash_lock);
@@ -209,6 +215,7 @@ static struct net_device *new_bridge_dev(struct net *net, const char *name)
 	INIT_LIST_HEAD(&br->age_list);
 
 	br_stp_timer_init(br);
+	br_multicast_init(br);
 
 	return dev;
 }
@@ -291,7 +298,7 @@ int br_add_bridge(struct net *net, const char *name)
 	return ret;
 
 out_free:
-	free_netdev(dev);
+	br_dev_free(dev);
 	goto out;
 }
 
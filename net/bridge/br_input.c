@@ -41,7 +41,9 @@ int br_handle_frame_finish(struct sk_buff *skb)
 	struct net_bridge_port *p = rcu_dereference(skb->dev->br_port);
 	struct net_bridge *br;
 	struct net_bridge_fdb_entry *dst;
+	struct net_bridge_mdb_entry *mdst;
 	struct sk_buff *skb2;
+	int mrouters_only;
 
 	if (!p || p->state == BR_STATE_DISABLED)
 		goto drop;
@@ -60,10 +62,17 @@ int br_handle_frame_finish(struct sk_buff *skb)
 		skb2 = skb;
 
 	dst = NULL;
+	mdst = NULL;
+	mrouters_only = 0;
 
 	if (is_multicast_ether_addr(dest)) {
 		br->dev->stats.multicast++;
 		skb2 = skb;
+
+		/* IGMP snooping may have to pull the headers in */
+		mrouters_only = br_multicast_rcv(br, p, skb);
+		if (!mrouters_only)
+			mdst = br_mdb_get(br, skb);
 	} else if ((dst = __br_fdb_get(br, dest)) && dst->is_local) {
 		skb2 = skb;
 		/* Do not forward the packet since it's local. */
@@ -79,6 +88,8 @@ int br_handle_frame_finish(struct sk_buff *skb)
 	if (skb) {
 		if (dst)
 			br_forward(dst->dst, skb);
+		else if (mdst || mrouters_only)
+			br_multicast_forward(br, mdst, skb);
 		else
 			br_flood_forward(br, skb);
 	}
@@ -0,0 +1,502 @@
+/*
+ *	IGMP snooping
+ *	Linux ethernet bridge
+ *
+ *	Without snooping the bridge floods every multicast frame to all
+ *	ports.  Here it listens to the IGMP reports of the hosts behind
+ *	each port and to the queries of multicast routers, and forwards a
+ *	group's traffic only to the ports with members and to the router
+ *	ports.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/igmp.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <net/checksum.h>
+#include <net/ip.h>
+#include "br_private.h"
+
+/* RFC 2236 defaults: 2 * query interval + query response interval */
+#define BR_MULTICAST_MEMBERSHIP_INTERVAL	(260 * HZ)
+/* other querier present interval */
+#define BR_MULTICAST_QUERIER_INTERVAL		(255 * HZ)
+/* last member query count * last member query interval */
+#define BR_MULTICAST_LEAVE_DELAY		(2 * HZ)
+#define BR_MULTICAST_GC_INTERVAL		(10 * HZ)
+
+static inline int br_ip_hash(const struct net_bridge *br, __be32 group)
+{
+	return jhash_1word((__force u32)group, br->multicast_salt) &
+		(BR_MDB_HASH_SIZE - 1);
+}
+
+static inline int br_multicast_querier_present(const struct net_bridge *br)
+{
+	return time_before(jiffies, br->multicast_querier_expires);
+}
+
+/* called with rcu_read_lock or multicast_lock */
+static struct net_bridge_mdb_entry *br_mdb_find(struct net_bridge *br,
+						__be32 group)
+{
+	struct net_bridge_mdb_entry *mp;
+	struct hlist_node *h;
+
+	hlist_for_each_entry_rcu(mp, h, &br->mdb[br_ip_hash(br, group)],
+				 hlist) {
+		if (mp->addr == group)
+			return mp;
+	}
+	return NULL;
+}
+
+/*
+ * Look up the group of an IPv4 multicast frame.  NULL means the frame is
+ * flooded: snooping is off, no querier keeps the memberships fresh, the
+ * group is link local, or nobody reported it.
+ *
+ * called with rcu_read_lock, skb->data at the network header
+ */
+struct net_bridge_mdb_entry *br_mdb_get(struct net_bridge *br,
+					struct sk_buff *skb)
+{
+	const struct iphdr *iph;
+
+	if (br->multicast_disabled || !br_multicast_querier_present(br))
+		return NULL;
+
+	if (skb->protocol != htons(ETH_P_IP) ||
+	    !pskb_may_pull(skb, sizeof(struct iphdr)))
+		return NULL;
+
+	iph = (const struct iphdr *)skb->data;
+	if (!ipv4_is_multicast(iph->daddr) ||
+	    ipv4_is_local_multicast(iph->daddr))
+		return NULL;
+
+	return br_mdb_find(br, iph->daddr);
+}
+
+static void br_multicast_free_pg(struct rcu_head *head)
+{
+	struct net_bridge_port_group *pg =
+		container_of(head, struct net_bridge_port_group, rcu);
+
+	kfree(pg);
+}
+
+static void br_multicast_free_group(struct rcu_head *head)
+{
+	struct net_bridge_mdb_entry *mp =
+		container_of(head, struct net_bridge_mdb_entry, rcu);
+
+	kfree(mp);
+}
+
+/* called with multicast_lock */
+static void br_multicast_del_pg(struct net_bridge_port_group **pp)
+{
+	struct net_bridge_port_group *pg = *pp;
+
+	rcu_assign_pointer(*pp, pg->next);
+	call_rcu(&pg->rcu, br_multicast_free_pg);
+}
+
+/* called with multicast_lock */
+static void br_multicast_del_group(struct net_bridge *br,
+				   struct net_bridge_mdb_entry *mp)
+{
+	while (mp->ports)
+		br_multicast_del_pg(&mp->ports);
+
+	hlist_del_rcu(&mp->hlist);
+	br->mdb_count--;
+	call_rcu(&mp->rcu, br_multicast_free_group);
+}
+
+/*
+ * called with multicast_lock.  del_nbp() disables the port before
+ * br_multicast_del_port() and the bridge is marked down before
+ * br_multicast_stop(), both of which flush under the lock: once they
+ * ran, nothing may be added for the port any more.
+ */
+static int br_multicast_port_usable(struct net_bridge *br,
+				    struct net_bridge_port *port)
+{
+	return netif_running(br->dev) && port->state != BR_STATE_DISABLED;
+}
+
+static void br_multicast_add_group(struct net_bridge *br,
+				   struct net_bridge_port *port,
+				   __be32 group)
+{
+	struct net_bridge_mdb_entry *mp;
+	struct net_bridge_port_group *pg;
+
+	/* 224.0.0.x is always flooded, and the bridge device itself
+	 * gets a copy of every multicast frame anyway */
+	if (!port || ipv4_is_local_multicast(group))
+		return;
+
+	spin_lock(&br->multicast_lock);
+	if (br->multicast_disabled || !br_multicast_port_usable(br, port))
+		goto out;
+
+	mp = br_mdb_find(br, group);
+	if (!mp) {
+		if (br->mdb_count >= BR_MDB_MAX) {
+			if (net_ratelimit())
+				printk(KERN_INFO "%s: multicast database full, "
+				       "flooding new groups\n", br->dev->name);
+			goto out;
+		}
+
+		mp = kzalloc(sizeof(*mp), GFP_ATOMIC);
+		if (!mp)
+			goto out;
+
+		mp->addr = group;
+		hlist_add_head_rcu(&mp->hlist, &br->mdb[br_ip_hash(br, group)]);
+		br->mdb_count++;
+	}
+
+	for (pg = mp->ports; pg; pg = pg->next) {
+		if (pg->port == port)
+			goto refresh;
+	}
+
+	pg = kzalloc(sizeof(*pg), GFP_ATOMIC);
+	if (!pg) {
+		if (!mp->ports)
+			br_multicast_del_group(br, mp);
+		goto out;
+	}
+
+	pg->port = port;
+	pg->next = mp->ports;
+	rcu_assign_pointer(mp->ports, pg);
+
+refresh:
+	pg->expires = jiffies + BR_MULTICAST_MEMBERSHIP_INTERVAL;
+out:
+	spin_unlock(&br->multicast_lock);
+}
+
+/*
+ * A host behind the port left the group.  Others may still be there, so
+ * keep forwarding until the querier's group specific query has had time
+ * to collect their reports.
+ */
+static void br_multicast_leave_group(struct net_bridge *br,
+				     struct net_bridge_port *port,
+				     __be32 group)
+{
+	struct net_bridge_mdb_entry *mp;
+	struct net_bridge_port_group *pg;
+	unsigned long expires;
+
+	if (!port || ipv4_is_local_multicast(group) ||
+	    !br_multicast_querier_present(br))
+		return;
+
+	spin_lock(&br->multicast_lock);
+	mp = br_mdb_find(br, group);
+	if (!mp)
+		goto out;
+
+	expires = jiffies + BR_MULTICAST_LEAVE_DELAY;
+	for (pg = mp->ports; pg; pg = pg->next) {
+		if (pg->port == port) {
+			if (time_after(pg->expires, expires))
+				pg->expires = expires;
+			break;
+		}
+	}
+
+	if (pg && (!timer_pending(&br->multicast_gc_timer) ||
+		   time_after(br->multicast_gc_timer.expires, expires)))
+		mod_timer(&br->multicast_gc_timer, expires);
+out:
+	spin_unlock(&br->multicast_lock);
+}
+
+static void br_multicast_query_received(struct net_bridge *br,
+					struct net_bridge_port *port)
+{
+	unsigned long expires = jiffies + BR_MULTICAST_QUERIER_INTERVAL;
+
+	br->multicast_querier_expires = expires;
+
+	if (!port)
+		return;
+
+	spin_lock(&br->multicast_lock);
+	if (!br_multicast_port_usable(br, port))
+		goto out;
+	port->multicast_router_expires = expires;
+	if (!br->multicast_disabled && hlist_unhashed(&port->rlist))
+		hlist_add_head_rcu(&port->rlist, &br->router_list);
+out:
+	spin_unlock(&br->multicast_lock);
+}
+
+static int br_multicast_igmp3_report(struct net_bridge *br,
+				     struct net_bridge_port *port,
+				     struct sk_buff *skb,
+				     unsigned int offset)
+{
+	struct igmpv3_report *ih;
+	struct igmpv3_grec *grec;
+	unsigned int len;
+	int num, i;
+
+	if (!pskb_may_pull(skb, offset + sizeof(*ih)))
+		return -EINVAL;
+
+	ih = (struct igmpv3_report *)(skb->data + offset);
+	num = ntohs(ih->ngrec);
+	offset += sizeof(*ih);
+
+	for (i = 0; i < num; i++) {
+		if (!pskb_may_pull(skb, offset + sizeof(*grec)))
+			return -EINVAL;
+
+		grec = (struct igmpv3_grec *)(skb->data + offset);
+		len = sizeof(*grec) + 4 * (ntohs(grec->grec_nsrcs) +
+					   grec->grec_auxwords);
+
+		/* Source lists are not tracked; any interest in the group
+		 * makes the port a member, an empty include list ends it. */
+		switch (grec->grec_type) {
+		case IGMPV3_MODE_IS_INCLUDE:
+		case IGMPV3_CHANGE_TO_INCLUDE:
+			if (!grec->grec_nsrcs) {
+				br_multicast_leave_group(br, port,
+							 grec->grec_mca);
+				break;
+			}
+			/* fall through */
+		case IGMPV3_MODE_IS_EXCLUDE:
+		case IGMPV3_CHANGE_TO_EXCLUDE:
+		case IGMPV3_ALLOW_NEW_SOURCES:
+			br_multicast_add_group(br, port, grec->grec_mca);
+			break;
+		default:
+			break;
+		}
+
+		offset += len;
+	}
+
+	return 0;
+}
+
+/*
+ * Snoop an IGMP message received on @port, or sent by the bridge device
+ * itself when @port is NULL.  Returns nonzero if the frame should go to
+ * the multicast router ports only, as membership reports do once a
+ * querier is active.
+ *
+ * called with rcu_read_lock, skb->data at the network header
+ */
+int br_multicast_rcv(struct net_bridge *br, struct net_bridge_port *port,
+		     struct sk_buff *skb)
+{
+	const struct iphdr *iph;
+	struct igmphdr *ih;
+	unsigned int len, offset;
+	__be32 group;
+
+	if (br->multicast_disabled || skb->protocol != htons(ETH_P_IP))
+		return 0;
+
+	if (!pskb_may_pull(skb, sizeof(*iph)))
+		return 0;
+
+	iph = (const struct iphdr *)skb->data;
+	if (iph->ihl < 5 || iph->version != 4 ||
+	    iph->protocol != IPPROTO_IGMP)
+		return 0;
+
+	offset = iph->ihl * 4;
+	len = ntohs(iph->tot_len);
+	if (len > skb->len || len < offset + sizeof(*ih) ||
+	    !pskb_may_pull(skb, offset + sizeof(*ih)))
+		return 0;
+
+	/* ignore fragments, and anything a router would not accept */
+	iph = (const struct iphdr *)skb->data;
+	if (iph->frag_off & htons(IP_MF | IP_OFFSET) ||
+	    csum_fold(skb_checksum(skb, offset, len - offset, 0)))
+		return 0;
+
+	ih = (struct igmphdr *)(skb->data + offset);
+	group = ih->group;
+
+	switch (ih->type) {
+	case IGMP_HOST_MEMBERSHIP_REPORT:
+	case IGMPV2_HOST_MEMBERSHIP_REPORT:
+		br_multicast_add_group(br, port, group);
+		break;
+	case IGMPV3_HOST_MEMBERSHIP_REPORT:
+		if (br_multicast_igmp3_report(br, port, skb, offset))
+			return 0;
+		break;
+	case IGMP_HOST_LEAVE_MESSAGE:
+		br_multicast_leave_group(br, port, group);
+		break;
+	case IGMP_HOST_MEMBERSHIP_QUERY:
+		br_multicast_query_received(br, port);
+		return 0;
+	default:
+		return 0;
+	}
+
+	return br_multicast_querier_present(br);
+}
+
+/* Expire port memberships and router ports that were not refreshed. */
+static void br_multicast_gc(unsigned long data)
+{
+	struct net_bridge *br = (struct net_bridge *)data;
+	unsigned long next_timer = jiffies + BR_MULTICAST_GC_INTERVAL;
+	struct net_bridge_mdb_entry *mp;
+	struct net_bridge_port_group **pp, *pg;
+	struct net_bridge_port *port;
+	struct hlist_node *h, *n;
+	int i;
+
+	spin_lock(&br->multicast_lock);
+	for (i = 0; i < BR_MDB_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(mp, h, n, &br->mdb[i], hlist) {
+			for (pp = &mp->ports; (pg = *pp) != NULL; ) {
+				if (time_before_eq(pg->expires, jiffies)) {
+					br_multicast_del_pg(pp);
+					continue;
+				}
+				if (time_before(pg->expires, next_timer))
+					next_timer = pg->expires;
+				pp = &pg->next;
+			}
+
+			if (!mp->ports)
+				br_multicast_del_group(br, mp);
+		}
+	}
+
+	hlist_for_each_entry_safe(port, h, n, &br->router_list, rlist) {
+		if (time_before_eq(port->multicast_router_expires, jiffies))
+			hlist_del_init_rcu(&port->rlist);
+		else if (time_before(port->multicast_router_expires, next_timer))
+			next_timer = port->multicast_router_expires;
+	}
+	spin_unlock(&br->multicast_lock);
+
+	mod_timer(&br->multicast_gc_timer, round_jiffies_up(next_timer));
+}
+
+/* called with multicast_lock */
+static void br_multicast_flush(struct net_bridge *br)
+{
+	struct net_bridge_mdb_entry *mp;
+	struct net_bridge_port *port;
+	struct hlist_node *h, *n;
+	int i;
+
+	for (i = 0; i < BR_MDB_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(mp, h, n, &br->mdb[i], hlist)
+			br_multicast_del_group(br, mp);
+	}
+
+	hlist_for_each_entry_safe(port, h, n, &br->router_list, rlist)
+		hlist_del_init_rcu(&port->rlist);
+}
+
+/* called with RTNL, before the port is freed via RCU */
+void br_multicast_del_port(struct net_bridge_port *port)
+{
+	struct net_bridge *br = port->br;
+	struct net_bridge_mdb_entry *mp;
+	struct net_bridge_port_group **pp, *pg;
+	struct hlist_node *h, *n;
+	int i;
+
+	spin_lock_bh(&br->multicast_lock);
+	for (i = 0; i < BR_MDB_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(mp, h, n, &br->mdb[i], hlist) {
+			for (pp = &mp->ports; (pg = *pp) != NULL;
+			     pp = &pg->next) {
+				if (pg->port == port) {
+					br_multicast_del_pg(pp);
+					break;
+				}
+			}
+
+			if (!mp->ports)
+				br_multicast_del_group(br, mp);
+		}
+	}
+
+	if (!hlist_unhashed(&port->rlist))
+		hlist_del_init_rcu(&port->rlist);
+	spin_unlock_bh(&br->multicast_lock);
+}
+
+/* called under bridge lock, from sysfs */
+int br_multicast_toggle(struct net_bridge *br, unsigned long val)
+{
+	spin_lock(&br->multicast_lock);
+	br->multicast_disabled = !val;
+	if (br->multicast_disabled)
+		br_multicast_flush(br);
+	spin_unlock(&br->multicast_lock);
+
+	return 0;
+}
+
+void br_multicast_init(struct net_bridge *br)
+{
+	int i;
+
+	br->multicast_disabled = 0;
+	br->mdb_count = 0;
+	br->multicast_querier_expires = jiffies;
+	get_random_bytes(&br->multicast_salt, sizeof(br->multicast_salt));
+
+	spin_lock_init(&br->multicast_lock);
+	for (i = 0; i < BR_MDB_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&br->mdb[i]);
+	INIT_HLIST_HEAD(&br->router_list);
+	setup_timer(&br->multicast_gc_timer, br_multicast_gc,
+		    (unsigned long)br);
+}
+
+void br_multicast_open(struct net_bridge *br)
+{
+	mod_timer(&br->multicast_gc_timer,
+		  round_jiffies_up(jiffies + BR_MULTICAST_GC_INTERVAL));
+}
+
+void br_multicast_stop(struct net_bridge *br)
+{
+	del_timer_sync(&br->multicast_gc_timer);
+
+	spin_lock_bh(&br->multicast_lock);
+	br_multicast_flush(br);
+	br->multicast_querier_expires = jiffies;
+	spin_unlock_bh(&br->multicast_lock);
+}
@@ -17,8 +17,17 @@
 #include <linux/if_bridge.h>
 #include <net/route.h>
 
+/* The forwarding database starts at BR_HASH_SIZE buckets and doubles
+ * whenever it holds more entries than buckets, up to BR_HASH_MAX.
+ */
 #define BR_HASH_BITS 8
 #define BR_HASH_SIZE (1 << BR_HASH_BITS)
+#define BR_HASH_MAX_BITS 16
+#define BR_HASH_MAX (1 << BR_HASH_MAX_BITS)
+
+#define BR_MDB_HASH_BITS 8
+#define BR_MDB_HASH_SIZE (1 << BR_MDB_HASH_BITS)
+#define BR_MDB_MAX 4096
 
 #define BR_HOLD_TIME (1*HZ)
 
@@ -47,7 +56,9 @@ struct mac_addr
 
 struct net_bridge_fdb_entry
 {
-	struct hlist_node		hlist;
+	/* one node per table version, so lookups can go on in the old
+	 * table while a resize links the entries into the new one */
+	struct hlist_node		hlist[2];
 	struct net_bridge_port		*dst;
 
 	struct rcu_head			rcu;
@@ -58,6 +69,31 @@ struct net_bridge_fdb_entry
 	unsigned char			is_static;
 };
 
+struct net_bridge_fdb_htable
+{
+	struct hlist_head		*buckets;
+	unsigned int			size;
+	unsigned int			ver;
+};
+
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+struct net_bridge_port_group
+{
+	struct net_bridge_port		*port;
+	struct net_bridge_port_group	*next;
+	struct rcu_head			rcu;
+	unsigned long			expires;
+};
+
+struct net_bridge_mdb_entry
+{
+	struct hlist_node		hlist;
+	struct net_bridge_port_group	*ports;
+	struct rcu_head			rcu;
+	__be32				addr;
+};
+#endif
+
 struct net_bridge_port
 {
 	struct net_bridge		*br;
@@ -82,6 +118,12 @@ struct net_bridge_port
 	struct timer_list		message_age_timer;
 	struct kobject			kobj;
 	struct rcu_head			rcu;
+
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+	/* on br->router_list while IGMP queries arrive on this port */
+	struct hlist_node		rlist;
+	unsigned long			multicast_router_expires;
+#endif
 };
 
 struct net_bridge
@@ -90,7 +132,10 @@ struct net_bridge
 	struct list_head		port_list;
 	struct net_device		*dev;
 	spinlock_t			hash_lock;
-	struct hlist_head		hash[BR_HASH_SIZE];
+	struct net_bridge_fdb_htable	*fdb_table;
+	unsigned int			fdb_count;
+	unsigned char			fdb_resizing;
+	struct work_struct		fdb_resize_work;
 	struct list_head		age_list;
 	unsigned long			feature_mask;
 #ifdef CONFIG_BRIDGE_NETFILTER
@@ -128,6 +173,19 @@ struct net_bridge
 	struct timer_list		topology_change_timer;
 	struct timer_list		gc_timer;
 	struct kobject			*ifobj;
+
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+	unsigned char			multicast_disabled;
+	u32				multicast_salt;
+	unsigned int			mdb_count;
+	/* an IGMP querier is assumed present until this time */
+	unsigned long			multicast_querier_expires;
+
+	spinlock_t			multicast_lock;
+	struct hlist_head		mdb[BR_MDB_HASH_SIZE];
+	struct hlist_head		router_list;
+	struct timer_list		multicast_gc_timer;
+#endif
 };
 
 extern struct notifier_block br_device_notifier;
@@ -141,11 +199,14 @@ static inline int br_is_root_bridge(const struct net_bridge *br)
 
 /* br_device.c */
 extern void br_dev_setup(struct net_device *dev);
+extern void br_dev_free(struct net_device *dev);
 extern int br_dev_xmit(struct sk_buff *skb, struct net_device *dev);
 
 /* br_fdb.c */
 extern int br_fdb_init(void);
 extern void br_fdb_fini(void);
+extern int br_fdb_hash_init(struct net_bridge *br);
+extern void br_fdb_hash_fini(struct net_bridge *br);
 extern void br_fdb_flush(struct net_bridge *br);
 extern void br_fdb_changeaddr(struct net_bridge_port *p,
 			      const unsigned char *newaddr);
@@ -175,6 +236,14 @@ extern void br_forward(const struct net_bridge_port *to,
 extern int br_forward_finish(struct sk_buff *skb);
 extern void br_flood_deliver(struct net_bridge *br, struct sk_buff *skb);
 extern void br_flood_forward(struct net_bridge *br, struct sk_buff *skb);
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+extern void br_multicast_deliver(struct net_bridge *br,
+				 struct net_bridge_mdb_entry *mdst,
+				 struct sk_buff *skb);
+extern void br_multicast_forward(struct net_bridge *br,
+				 struct net_bridge_mdb_entry *mdst,
+				 struct sk_buff *skb);
+#endif
 
 /* br_if.c */
 extern void br_port_carrier_check(struct net_bridge_port *p);
@@ -197,6 +266,52 @@ extern struct sk_buff *br_handle_frame(struct net_bridge_port *p,
 extern int br_dev_ioctl(struct net_device *dev, struct ifreq *rq, int cmd);
 extern int br_ioctl_deviceless_stub(struct net *net, unsigned int cmd, void __user *arg);
 
+/* br_multicast.c */
+#ifdef CONFIG_BRIDGE_IGMP_SNOOPING
+extern int br_multicast_rcv(struct net_bridge *br,
+			    struct net_bridge_port *port,
+			    struct sk_buff *skb);
+extern struct net_bridge_mdb_entry *br_mdb_get(struct net_bridge *br,
+					       struct sk_buff *skb);
+extern void br_multicast_init(struct net_bridge *br);
+extern void br_multicast_open(struct net_bridge *br);
+extern void br_multicast_stop(struct net_bridge *br);
+extern void br_multicast_del_port(struct net_bridge_port *port);
+extern int br_multicast_toggle(struct net_bridge *br, unsigned long val);
+#else
+static inline int br_multicast_rcv(struct net_bridge *br,
+				   struct net_bridge_port *port,
+				   struct sk_buff *skb)
+{
+	return 0;
+}
+
+static inline struct net_bridge_mdb_entry *br_mdb_get(struct net_bridge *br,
+						      struct sk_buff *skb)
+{
+	return NULL;
+}
+
+static inline void br_multicast_init(struct net_bridge *br)
+{
+}
+
+static inline void br_multicast_open(struct net_bridge *br)
+{
+}
+
+static inline void br_multicast_stop(struct net_bridge *br)
+{
+}
+
+static inline void br_multicast_del_port(struct net_bridge_port *port)
+{
+}
+
+#define br_multicast_deliver(br, mdst, skb)	br_flood_deliver(br, skb)
+#define br_multicast_forward(br, mdst, skb)	br_flood_forward(br, skb)
+#endif
+
 /* br_netfilter.c */
 #ifdef CONFIG_BRIDGE_NETFILTER
 extern int br_netfilter_init(void);
@@ -55,6 +55,7 @@
 #include <net/checksum.h>
 #include <net/sock.h>
 #include <net/tcp_states.h>
+#include <net/busy_poll.h>
 
 /*
  *	Is a socket 'connection oriented' ?
@@ -167,6 +168,11 @@ struct sk_buff *__skb_recv_datagram(struct sock *sk, unsigned flags,
 		 */
 		unsigned long cpu_flags;
 
+		/* Spin on the device for a while rather than sleep */
+		if (sk_can_busy_loop(sk) &&
+		    skb_queue_empty(&sk->sk_receive_queue))
+			sk_busy_loop_rx(sk, flags & MSG_DONTWAIT);
+
 		spin_lock_irqsave(&sk->sk_receive_queue.lock, cpu_flags);
 		skb = skb_peek(&sk->sk_receive_queue);
 		if (skb) {
@@ -126,6 +126,7 @@
 #include <linux/in.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <net/busy_poll.h>
 
 #include "net-sysfs.h"
 
@@ -1652,10 +1653,18 @@ static int dev_gso_segment(struct sk_buff *skb)
 	return 0;
 }
 
+static inline void txq_account(struct netdev_queue *txq, unsigned int len)
+{
+	txq->tx_packets++;
+	txq->tx_bytes += len;
+}
+
 int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
 			struct netdev_queue *txq)
 {
 	const struct net_device_ops *ops = dev->netdev_ops;
+	unsigned int len;
+	int rc;
 
 	prefetch(&dev->netdev_ops->ndo_start_xmit);
 	if (likely(!skb->next)) {
@@ -1669,22 +1678,27 @@ int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
 				goto gso;
 		}
 
-		return ops->ndo_start_xmit(skb, dev);
+		len = skb->len;
+		rc = ops->ndo_start_xmit(skb, dev);
+		if (rc == NETDEV_TX_OK)
+			txq_account(txq, len);
+		return rc;
 	}
 
 gso:
 	do {
 		struct sk_buff *nskb = skb->next;
-		int rc;
 
 		skb->next = nskb->next;
 		nskb->next = NULL;
+		len = nskb->len;
 		rc = ops->ndo_start_xmit(nskb, dev);
 		if (unlikely(rc)) {
 			nskb->next = skb->next;
 			skb->next = nskb;
 			return rc;
 		}
+		txq_account(txq, len);
 		if (unlikely(netif_tx_queue_stopped(txq) && skb->next))
 			return NETDEV_TX_BUSY;
 	} while (skb->next);
@@ -1699,10 +1713,10 @@ out_kfree_skb:
 static u32 simple_tx_hashrnd;
 static int simple_tx_hashrnd_initialized = 0;
 
-static u16 simple_tx_hash(struct net_device *dev, struct sk_buff *skb)
+static u32 simple_tx_flow_hash(struct sk_buff *skb)
 {
 	u32 addr1, addr2, ports;
-	u32 hash, ihl;
+	u32 ihl;
 	u8 ip_proto = 0;
 
 	if (unlikely(!simple_tx_hashrnd_initialized)) {
@@ -1745,11 +1759,164 @@ static u16 simple_tx_hash(struct net_device *dev, struct sk_buff *skb)
 		break;
 	}
 
-	hash = jhash_3words(addr1, addr2, ports, simple_tx_hashrnd);
+	return jhash_3words(addr1, addr2, ports, simple_tx_hashrnd);
+}
+
+static u16 simple_tx_hash(struct net_device *dev, struct sk_buff *skb)
+{
+	u32 hash = simple_tx_flow_hash(skb);
 
 	return (u16) (((u64) hash * dev->real_num_tx_queues) >> 32);
 }
 
+#ifdef CONFIG_XPS
+static DEFINE_MUTEX(xps_map_mutex);
+
+static void xps_dev_maps_free(struct xps_dev_maps *dev_maps)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(dev_maps->cpu_map[cpu]);
+	kfree(dev_maps);
+}
+
+static void xps_dev_maps_free_rcu(struct rcu_head *head)
+{
+	xps_dev_maps_free(container_of(head, struct xps_dev_maps, rcu));
+}
+
+/**
+ *	netif_set_xps_queue - set the CPUs which transmit on a queue
+ *	@dev: network device
+ *	@mask: CPUs that should use the queue
+ *	@index: transmit queue index
+ *
+ *	Packets sent from a CPU in @mask will be put on queue @index, or on
+ *	one of the queues that CPU maps to, selected by flow hash.  An empty
+ *	@mask removes the queue from all maps.  Can sleep.
+ */
+int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
+			u16 index)
+{
+	struct xps_dev_maps *dev_maps, *new_dev_maps;
+	struct xps_map *map, *new_map;
+	bool active = false;
+	int cpu, i;
+
+	if (index >= dev->num_tx_queues)
+		return -EINVAL;
+
+	new_dev_maps = kzalloc(XPS_DEV_MAPS_SIZE, GFP_KERNEL);
+	if (!new_dev_maps)
+		return -ENOMEM;
+
+	mutex_lock(&xps_map_mutex);
+
+	dev_maps = dev->xps_maps;
+
+	for_each_possible_cpu(cpu) {
+		map = dev_maps ? dev_maps->cpu_map[cpu] : NULL;
+
+		new_map = kzalloc(XPS_MAP_SIZE((map ? map->len : 0) + 1),
+				  GFP_KERNEL);
+		if (!new_map)
+			goto error;
+
+		/* Keep the other queues of this CPU, update ours */
+		for (i = 0; map && i < map->len; i++)
+			if (map->queues[i] != index)
+				new_map->queues[new_map->len++] = map->queues[i];
+		if (cpumask_test_cpu(cpu, mask))
+			new_map->queues[new_map->len++] = index;
+
+		if (!new_map->len) {
+			kfree(new_map);
+			continue;
+		}
+		new_dev_maps->cpu_map[cpu] = new_map;
+		active = true;
+	}
+
+	if (!active) {
+		kfree(new_dev_maps);
+		new_dev_maps = NULL;
+	}
+	rcu_assign_pointer(dev->xps_maps, new_dev_maps);
+
+	mutex_unlock(&xps_map_mutex);
+
+	if (dev_maps)
+		call_rcu(&dev_maps->rcu, xps_dev_maps_free_rcu);
+
+	return 0;
+
+error:
+	mutex_unlock(&xps_map_mutex);
+	xps_dev_maps_free(new_dev_maps);
+	return -ENOMEM;
+}
+EXPORT_SYMBOL(netif_set_xps_queue);
+
+/* Called with rcu_read_lock_bh() held, from dev_queue_xmit() */
+static int get_xps_queue(struct net_device *dev, struct sk_buff *skb)
+{
+	struct xps_dev_maps *dev_maps;
+	struct xps_map *map;
+	int queue_index = -1;
+
+	dev_maps = rcu_dereference(dev->xps_maps);
+	if (!dev_maps)
+		return -1;
+
+	map = dev_maps->cpu_map[raw_smp_processor_id()];
+	if (!map)
+		return -1;
+
+	if (map->len == 1)
+		queue_index = map->queues[0];
+	else
+		queue_index = map->queues[((u64) simple_tx_flow_hash(skb) *
+					   map->len) >> 32];
+
+	if (unlikely(queue_index >= dev->real_num_tx_queues))
+		queue_index = -1;
+
+	return queue_index;
+}
+#else
+static inline int get_xps_queue(struct net_device *dev, struct sk_buff *skb)
+{
+	return -1;
+}
+#endif /* CONFIG_XPS */
+
+/*
+ * Pick the queue for a socket's packet once, and keep using it until the
+ * route changes or the socket has nothing in flight (skb->ooo_okay), so
+ * a flow is not reordered across queues.
+ */
+static u16 __dev_pick_tx(struct net_device *dev, struct sk_buff *skb)
+{
+	struct sock *sk = skb->sk;
+	int queue_index = sk_tx_queue_get(sk);
+
+	if (queue_index < 0 || skb->ooo_okay ||
+	    queue_index >= dev->real_num_tx_queues) {
+		int old_index = queue_index;
+
+		queue_index = get_xps_queue(dev, skb);
+		if (queue_index < 0)
+			queue_index = simple_tx_hash(dev, skb);
+
+		if (queue_index != old_index && sk &&
+		    sk->sk_dst_cache && sk->sk_dst_cache == skb->dst)
+			sk_tx_queue_set(sk, queue_index);
+	}
+
+	return queue_index;
+}
+
 static struct netdev_queue *dev_pick_tx(struct net_device *dev,
 					struct sk_buff *skb)
 {
@@ -1759,12 +1926,68 @@ static struct netdev_queue *dev_pick_tx(struct net_device *dev,
 	if (ops->ndo_select_queue)
 		queue_index = ops->ndo_select_queue(dev, skb);
 	else if (dev->real_num_tx_queues > 1)
-		queue_index = simple_tx_hash(dev, skb);
+		queue_index = __dev_pick_tx(dev, skb);
 
 	skb_set_queue_mapping(skb, queue_index);
 	return netdev_get_tx_queue(dev, queue_index);
 }
 
+static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
+				 struct net_device *dev,
+				 struct netdev_queue *txq)
+{
+	spinlock_t *root_lock = qdisc_lock(q);
+	bool contended = qdisc_is_running(q);
+	int rc;
+
+	/*
+	 * Heuristic to force contended enqueues to serialize on a
+	 * separate lock before trying to get qdisc main lock.
+	 * This lets the __QDISC_STATE_RUNNING owner, which retakes the
+	 * root lock after every packet, get it more often and dequeue
+	 * packets faster.
+	 */
+	if (unlikely(contended))
+		spin_lock(&q->busylock);
+
+	spin_lock(root_lock);
+	if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
+		kfree_skb(skb);
+		rc = NET_XMIT_DROP;
+	} else if ((q->flags & TCQ_F_CAN_BYPASS) && !qdisc_qlen(q) &&
+		   !q->gso_skb && qdisc_run_begin(q)) {
+		/*
+		 * This is a work-conserving queue; there are no old skbs
+		 * waiting to be sent out; and the qdisc is not running -
+		 * xmit the skb directly.
+		 */
+		__qdisc_update_bstats(q, skb->len);
+		if (sch_direct_xmit(skb, q, dev, txq, root_lock)) {
+			if (unlikely(contended)) {
+				spin_unlock(&q->busylock);
+				contended = false;
+			}
+			__qdisc_run(q);
+		} else
+			qdisc_run_end(q);
+
+		rc = NET_XMIT_SUCCESS;
+	} else {
+		rc = qdisc_enqueue_root(skb, q);
+		if (qdisc_run_begin(q)) {
+			if (unlikely(contended)) {
+				spin_unlock(&q->busylock);
+				contended = false;
+			}
+			__qdisc_run(q);
+		}
+	}
+	spin_unlock(root_lock);
+	if (unlikely(contended))
+		spin_unlock(&q->busylock);
+	return rc;
+}
+
 /**
  *	dev_queue_xmit - transmit a buffer
  *	@skb: buffer to transmit
@@ -1838,19 +2061,7 @@ gso:
 	skb->tc_verd = SET_TC_AT(skb->tc_verd,AT_EGRESS);
 #endif
 	if (q->enqueue) {
-		spinlock_t *root_lock = qdisc_lock(q);
-
-		spin_lock(root_lock);
-
-		if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
-			kfree_skb(skb);
-			rc = NET_XMIT_DROP;
-		} else {
-			rc = qdisc_enqueue_root(skb, q);
-			qdisc_run(q);
-		}
-		spin_unlock(root_lock);
-
+		rc = __dev_xmit_skb(skb, q, dev, txq);
 		goto out;
 	}
 
@@ -2476,6 +2687,8 @@ static int __napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 
 int napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
+	skb_mark_napi_id(skb, napi);
+
 	switch (__napi_gro_receive(napi, skb)) {
 	case -1:
 		return netif_receive_skb(skb);
@@ -2547,6 +2760,8 @@ int napi_gro_frags(struct napi_struct *napi, struct napi_gro_fraginfo *info)
 
 	err = NET_RX_SUCCESS;
 
+	skb_mark_napi_id(skb, napi);
+
 	switch (__napi_gro_receive(napi, skb)) {
 	case -1:
 		return netif_receive_skb(skb);
@@ -2635,6 +2850,138 @@ void napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(napi_complete);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/*
+ * Every napi context gets an id, hashed for lookup from sockets that
+ * want to busy poll the queue they receive from.  Readers use RCU;
+ * netif_napi_del() waits for them before the context can be freed.
+ */
+#define NAPI_HASH_BITS	8
+
+static DEFINE_SPINLOCK(napi_hash_lock);
+static unsigned int napi_gen_id;
+static struct hlist_head napi_hash[1 << NAPI_HASH_BITS];
+
+/* must be called under rcu_read_lock() or napi_hash_lock */
+static struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	struct hlist_head *head;
+	struct hlist_node *node;
+	struct napi_struct *napi;
+
+	head = &napi_hash[napi_id & ((1 << NAPI_HASH_BITS) - 1)];
+	hlist_for_each_entry_rcu(napi, node, head, napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+
+static void napi_hash_add(struct napi_struct *napi)
+{
+	spin_lock(&napi_hash_lock);
+
+	/* 0 means "not hashed"; skip ids still in use after a wrap */
+	do {
+		if (unlikely(++napi_gen_id == 0))
+			napi_gen_id = 1;
+	} while (napi_by_id(napi_gen_id));
+	napi->napi_id = napi_gen_id;
+
+	hlist_add_head_rcu(&napi->napi_hash_node,
+		&napi_hash[napi->napi_id & ((1 << NAPI_HASH_BITS) - 1)]);
+
+	spin_unlock(&napi_hash_lock);
+}
+
+/* Returns true if the caller must wait for an RCU grace period */
+static bool napi_hash_del(struct napi_struct *napi)
+{
+	bool hashed;
+
+	spin_lock(&napi_hash_lock);
+	hashed = napi->napi_id != 0;
+	if (hashed) {
+		hlist_del_rcu(&napi->napi_hash_node);
+		napi->napi_id = 0;
+	}
+	spin_unlock(&napi_hash_lock);
+
+	return hashed;
+}
+
+static unsigned long busy_loop_us_clock(void)
+{
+	return cpu_clock(raw_smp_processor_id()) >> 10;
+}
+
+/**
+ *	sk_busy_loop - poll the device queue a socket receives from
+ *	@sk: socket waiting for data
+ *	@usecs: how long to spin
+ *	@nonblock: poll once only
+ *
+ *	Calls the driver's NAPI ->poll() routine directly, taking ownership
+ *	of the context the same way net_rx_action() does, until data shows
+ *	up on @sk, @usecs pass or the task needs to reschedule.  Returns
+ *	true if the receive queue of @sk is not empty.
+ */
+bool sk_busy_loop(struct sock *sk, unsigned int usecs, int nonblock)
+{
+	unsigned long end_time = busy_loop_us_clock() + usecs;
+	struct napi_struct *napi;
+	bool rc = false;
+
+	rcu_read_lock();
+
+	napi = napi_by_id(ACCESS_ONCE(sk->sk_napi_id));
+	if (!napi)
+		goto out;
+
+	do {
+		void *have;
+		int work;
+
+		local_bh_disable();
+		have = netpoll_poll_lock(napi);
+
+		if (napi_schedule_prep(napi)) {
+			/* __napi_complete() expects us to be on a list */
+			INIT_LIST_HEAD(&napi->poll_list);
+			work = napi->poll(napi, BUSY_POLL_BUDGET);
+
+			/*
+			 * A driver consuming the whole budget leaves the
+			 * instance to us, so hand it on to the softirq.
+			 */
+			if (work == BUSY_POLL_BUDGET)
+				__napi_schedule(napi);
+		}
+
+		netpoll_poll_unlock(have);
+		local_bh_enable();
+
+		rc = !skb_queue_empty(&sk->sk_receive_queue);
+	} while (!rc && !nonblock && !need_resched() &&
+		 !signal_pending(current) &&
+		 !time_after(busy_loop_us_clock(), end_time));
+
+out:
+	rcu_read_unlock();
+	return rc;
+}
+EXPORT_SYMBOL(sk_busy_loop);
+#else
+static inline void napi_hash_add(struct napi_struct *napi)
+{
+}
+
+static inline bool napi_hash_del(struct napi_struct *napi)
+{
+	return false;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -2650,6 +2997,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->poll_owner = -1;
 #endif
 	set_bit(NAPI_STATE_SCHED, &napi->state);
+	napi_hash_add(napi);
 }
 EXPORT_SYMBOL(netif_napi_add);
 
@@ -2657,6 +3005,9 @@ void netif_napi_del(struct napi_struct *napi)
 {
 	struct sk_buff *skb, *next;
 
+	if (napi_hash_del(napi))
+		synchronize_net();
+
 	list_del_init(&napi->dev_list);
 	kfree(napi->skb);
 
@@ -4733,6 +5084,10 @@ void free_netdev(struct net_device *dev)
 	release_net(dev_net(dev));
 
 	kfree(dev->_tx);
+#ifdef CONFIG_XPS
+	if (dev->xps_maps)
+		xps_dev_maps_free(dev->xps_maps);
+#endif
 
 	list_for_each_entry_safe(p, n, &dev->napi_list, dev_list)
 		netif_napi_del(p);
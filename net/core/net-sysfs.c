@@ -419,6 +419,228 @@ static struct attribute_group wireless_group = {
 };
 #endif
 
+/*
+ * netdev_queue sysfs structures and functions: one queues/tx-N
+ * directory per transmit queue.
+ */
+struct netdev_queue_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct netdev_queue *queue,
+			struct netdev_queue_attribute *attr, char *buf);
+	ssize_t (*store)(struct netdev_queue *queue,
+			 struct netdev_queue_attribute *attr,
+			 const char *buf, size_t len);
+};
+#define to_netdev_queue_attr(_attr) container_of(_attr,		\
+    struct netdev_queue_attribute, attr)
+
+#define to_netdev_queue(obj) container_of(obj, struct netdev_queue, kobj)
+
+static ssize_t netdev_queue_attr_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct netdev_queue_attribute *attribute = to_netdev_queue_attr(attr);
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	if (!attribute->show)
+		return -EIO;
+
+	return attribute->show(queue, attribute, buf);
+}
+
+static ssize_t netdev_queue_attr_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct netdev_queue_attribute *attribute = to_netdev_queue_attr(attr);
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	if (!attribute->store)
+		return -EIO;
+
+	return attribute->store(queue, attribute, buf, count);
+}
+
+static struct sysfs_ops netdev_queue_sysfs_ops = {
+	.show = netdev_queue_attr_show,
+	.store = netdev_queue_attr_store,
+};
+
+static ssize_t show_queue_tx_packets(struct netdev_queue *queue,
+				     struct netdev_queue_attribute *attribute,
+				     char *buf)
+{
+	return sprintf(buf, fmt_ulong, queue->tx_packets);
+}
+
+static ssize_t show_queue_tx_bytes(struct netdev_queue *queue,
+				   struct netdev_queue_attribute *attribute,
+				   char *buf)
+{
+	return sprintf(buf, fmt_ulong, queue->tx_bytes);
+}
+
+static struct netdev_queue_attribute queue_tx_packets =
+	__ATTR(tx_packets, S_IRUGO, show_queue_tx_packets, NULL);
+
+static struct netdev_queue_attribute queue_tx_bytes =
+	__ATTR(tx_bytes, S_IRUGO, show_queue_tx_bytes, NULL);
+
+#ifdef CONFIG_XPS
+static inline unsigned int get_netdev_queue_index(struct netdev_queue *queue)
+{
+	struct net_device *dev = queue->dev;
+
+	return queue - dev->_tx;
+}
+
+static ssize_t show_xps_map(struct netdev_queue *queue,
+			    struct netdev_queue_attribute *attribute,
+			    char *buf)
+{
+	struct net_device *dev = queue->dev;
+	struct xps_dev_maps *dev_maps;
+	unsigned int index = get_netdev_queue_index(queue);
+	cpumask_var_t mask;
+	size_t len;
+	int cpu, i;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_clear(mask);
+
+	rcu_read_lock();
+	dev_maps = rcu_dereference(dev->xps_maps);
+	if (dev_maps) {
+		for_each_possible_cpu(cpu) {
+			struct xps_map *map = dev_maps->cpu_map[cpu];
+
+			for (i = 0; map && i < map->len; i++) {
+				if (map->queues[i] == index) {
+					cpumask_set_cpu(cpu, mask);
+					break;
+				}
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	len = cpumask_scnprintf(buf, PAGE_SIZE, mask);
+	if (PAGE_SIZE - len < 3) {
+		free_cpumask_var(mask);
+		return -EINVAL;
+	}
+	free_cpumask_var(mask);
+
+	len += sprintf(buf + len, "\n");
+	return len;
+}
+
+static ssize_t store_xps_map(struct netdev_queue *queue,
+			     struct netdev_queue_attribute *attribute,
+			     const char *buf, size_t len)
+{
+	struct net_device *dev = queue->dev;
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = netif_set_xps_queue(dev, mask,
+					  get_netdev_queue_index(queue));
+
+	free_cpumask_var(mask);
+
+	return err ? : len;
+}
+
+static struct netdev_queue_attribute xps_cpus_attribute =
+	__ATTR(xps_cpus, S_IRUGO | S_IWUSR, show_xps_map, store_xps_map);
+#endif /* CONFIG_XPS */
+
+static struct attribute *netdev_queue_default_attrs[] = {
+	&queue_tx_packets.attr,
+	&queue_tx_bytes.attr,
+#ifdef CONFIG_XPS
+	&xps_cpus_attribute.attr,
+#endif
+	NULL
+};
+
+static void netdev_queue_release(struct kobject *kobj)
+{
+	struct netdev_queue *queue = to_netdev_queue(kobj);
+
+	memset(kobj, 0, sizeof(*kobj));
+	dev_put(queue->dev);
+}
+
+static struct kobj_type netdev_queue_ktype = {
+	.sysfs_ops = &netdev_queue_sysfs_ops,
+	.release = netdev_queue_release,
+	.default_attrs = netdev_queue_default_attrs,
+};
+
+static int netdev_queue_add_kobject(struct net_device *net, int index)
+{
+	struct netdev_queue *queue = net->_tx + index;
+	struct kobject *kobj = &queue->kobj;
+	int error;
+
+	/* dropped by netdev_queue_release() */
+	dev_hold(queue->dev);
+
+	kobj->kset = net->queues_kset;
+	error = kobject_init_and_add(kobj, &netdev_queue_ktype, NULL,
+				     "tx-%u", index);
+	if (error) {
+		kobject_put(kobj);
+		return error;
+	}
+
+	kobject_uevent(kobj, KOBJ_ADD);
+
+	return 0;
+}
+
+static int register_queue_kobjects(struct net_device *net)
+{
+	int i, error;
+
+	net->queues_kset = kset_create_and_add("queues", NULL,
+					       &net->dev.kobj);
+	if (!net->queues_kset)
+		return -ENOMEM;
+
+	for (i = 0; i < net->num_tx_queues; i++) {
+		error = netdev_queue_add_kobject(net, i);
+		if (error)
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	while (--i >= 0)
+		kobject_put(&net->_tx[i].kobj);
+	kset_unregister(net->queues_kset);
+	return error;
+}
+
+static void remove_queue_kobjects(struct net_device *net)
+{
+	int i;
+
+	for (i = 0; i < net->num_tx_queues; i++)
+		kobject_put(&net->_tx[i].kobj);
+	kset_unregister(net->queues_kset);
+}
 #endif /* CONFIG_SYSFS */
 
 #ifdef CONFIG_HOTPLUG
@@ -482,6 +704,9 @@ void netdev_unregister_kobject(struct net_device * net)
 	if (dev_net(net) != &init_net)
 		return;
 
+#ifdef CONFIG_SYSFS
+	remove_queue_kobjects(net);
+#endif
 	device_del(dev);
 }
 
@@ -490,6 +715,7 @@ int netdev_register_kobject(struct net_device *net)
 {
 	struct device *dev = &(net->dev);
 	struct attribute_group **groups = net->sysfs_groups;
+	int error;
 
 	dev->class = &net_class;
 	dev->platform_data = net;
@@ -510,7 +736,19 @@ int netdev_register_kobject(struct net_device *net)
 	if (dev_net(net) != &init_net)
 		return 0;
 
-	return device_add(dev);
+	error = device_add(dev);
+	if (error)
+		return error;
+
+#ifdef CONFIG_SYSFS
+	error = register_queue_kobjects(net);
+	if (error) {
+		device_del(dev);
+		return error;
+	}
+#endif
+
+	return 0;
 }
 
 int netdev_class_create_file(struct class_attribute *class_attr)
@@ -55,6 +55,8 @@
 #include <linux/rtnetlink.h>
 #include <linux/init.h>
 #include <linux/scatterlist.h>
+#include <linux/errqueue.h>
+#include <linux/cpu.h>
 
 #include <net/protocol.h>
 #include <net/dst.h>
@@ -70,6 +72,58 @@
 static struct kmem_cache *skbuff_head_cache __read_mostly;
 static struct kmem_cache *skbuff_fclone_cache __read_mostly;
 
+/*
+ * Most sk_buff heads are allocated by the receive path and freed by the
+ * transmit completion and socket receive paths, all in softirq context.
+ * There they go through a small per cpu cache, refilled from and flushed
+ * to skbuff_head_cache in bulk.
+ */
+#define SKB_HEAD_CACHE_SIZE	64
+#define SKB_HEAD_CACHE_BULK	16
+
+struct skb_head_cache {
+	unsigned int count;
+	void *heads[SKB_HEAD_CACHE_SIZE];
+};
+static DEFINE_PER_CPU(struct skb_head_cache, skb_head_cache);
+
+/*
+ * The cache may only be used where nothing else on this cpu can use it
+ * at the same time: in softirq context, but not in a hardirq that
+ * interrupted it.
+ */
+static inline int skb_head_cache_usable(void)
+{
+	return in_softirq() && !in_irq();
+}
+
+static struct sk_buff *skb_head_cache_get(gfp_t gfp_mask)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(!hc->count)) {
+		hc->count = kmem_cache_alloc_bulk(skbuff_head_cache, gfp_mask,
+						  SKB_HEAD_CACHE_BULK,
+						  hc->heads);
+		/* A single head may still be there when a batch is not */
+		if (unlikely(!hc->count))
+			return kmem_cache_alloc(skbuff_head_cache, gfp_mask);
+	}
+	return hc->heads[--hc->count];
+}
+
+static void skb_head_cache_put(struct sk_buff *skb)
+{
+	struct skb_head_cache *hc = &__get_cpu_var(skb_head_cache);
+
+	if (unlikely(hc->count == SKB_HEAD_CACHE_SIZE)) {
+		hc->count -= SKB_HEAD_CACHE_BULK;
+		kmem_cache_free_bulk(skbuff_head_cache, SKB_HEAD_CACHE_BULK,
+				     hc->heads + hc->count);
+	}
+	hc->heads[hc->count++] = skb;
+}
+
 static void sock_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
@@ -187,7 +241,10 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	cache = fclone ? skbuff_fclone_cache : skbuff_head_cache;
 
 	/* Get the HEAD */
-	skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
+	if (!fclone && node == -1 && skb_head_cache_usable())
+		skb = skb_head_cache_get(gfp_mask & ~__GFP_DMA);
+	else
+		skb = kmem_cache_alloc_node(cache, gfp_mask & ~__GFP_DMA, node);
 	if (!skb)
 		goto out;
 
@@ -218,6 +275,7 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	shinfo->gso_type = 0;
 	shinfo->ip6_frag_id = 0;
 	shinfo->frag_list = NULL;
+	shinfo->uarg = NULL;
 
 	if (fclone) {
 		struct sk_buff *child = skb + 1;
@@ -236,6 +294,137 @@ nodata:
 	goto out;
 }
 
+/**
+ *	build_skb - build a network buffer around already filled memory
+ *	@data: data buffer provided by the caller
+ *	@frag_size: size of the fragment, or 0 if @data was kmalloc()ed
+ *
+ *	Allocate a new &sk_buff whose head is @data instead of a freshly
+ *	allocated buffer, so a driver can hand up a frame it received
+ *	directly into memory it owns without copying it.  The buffer must
+ *	leave room for a &struct skb_shared_info at its end, which is
+ *	initialised here.
+ *
+ *	@frag_size is non-zero when @data was obtained from
+ *	netdev_alloc_frag(); the page reference is then dropped rather
+ *	than kfree()ing the head when the skb is released.
+ *
+ *	The return is the new skb, or %NULL on allocation failure, in
+ *	which case @data still belongs to the caller.
+ */
+struct sk_buff *build_skb(void *data, unsigned int frag_size)
+{
+	struct skb_shared_info *shinfo;
+	struct sk_buff *skb;
+	unsigned int size = frag_size ? : ksize(data);
+
+	skb = kmem_cache_alloc(skbuff_head_cache, GFP_ATOMIC);
+	if (!skb)
+		return NULL;
+
+	size -= SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->truesize = size + sizeof(struct sk_buff);
+	skb->head_frag = frag_size != 0;
+	atomic_set(&skb->users, 1);
+	skb->head = data;
+	skb->data = data;
+	skb_reset_tail_pointer(skb);
+	skb->end = skb->tail + size;
+
+	shinfo = skb_shinfo(skb);
+	atomic_set(&shinfo->dataref, 1);
+	shinfo->nr_frags  = 0;
+	shinfo->gso_size = 0;
+	shinfo->gso_segs = 0;
+	shinfo->gso_type = 0;
+	shinfo->ip6_frag_id = 0;
+	shinfo->frag_list = NULL;
+	shinfo->uarg = NULL;
+
+	return skb;
+}
+EXPORT_SYMBOL(build_skb);
+
+/*
+ * Per-cpu page fragment cache for receive buffers.  Skb heads are
+ * carved out of a (preferably high-order) page, one page reference
+ * per fragment.  Instead of taking those references one at a time we
+ * preload page->_count with a large bias and hand it out locally; once
+ * the page is exhausted and every fragment has been freed again the
+ * count is back at our bias and the page is reused without going
+ * through the page allocator.
+ */
+struct netdev_alloc_cache {
+	struct page	*page;
+	unsigned int	size;
+	unsigned int	offset;
+	unsigned int	pagecnt_bias;
+};
+static DEFINE_PER_CPU(struct netdev_alloc_cache, netdev_alloc_cache);
+
+#define NETDEV_FRAG_PAGE_MAX_ORDER	get_order(32768)
+#define NETDEV_FRAG_PAGE_MAX_SIZE	(PAGE_SIZE << NETDEV_FRAG_PAGE_MAX_ORDER)
+#define NETDEV_PAGECNT_MAX_BIAS		NETDEV_FRAG_PAGE_MAX_SIZE
+
+static void *__netdev_alloc_frag(unsigned int fragsz, gfp_t gfp_mask)
+{
+	struct netdev_alloc_cache *nc;
+	void *data = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	nc = &__get_cpu_var(netdev_alloc_cache);
+	if (unlikely(!nc->page)) {
+refill:
+		nc->size = NETDEV_FRAG_PAGE_MAX_SIZE;
+		nc->page = alloc_pages(gfp_mask | __GFP_COMP | __GFP_NOWARN |
+				       __GFP_NORETRY,
+				       NETDEV_FRAG_PAGE_MAX_ORDER);
+		if (unlikely(!nc->page) && NETDEV_FRAG_PAGE_MAX_ORDER) {
+			nc->size = PAGE_SIZE;
+			nc->page = alloc_page(gfp_mask);
+		}
+		if (unlikely(!nc->page))
+			goto end;
+recycle:
+		atomic_set(&nc->page->_count, NETDEV_PAGECNT_MAX_BIAS);
+		nc->pagecnt_bias = NETDEV_PAGECNT_MAX_BIAS;
+		nc->offset = 0;
+	}
+
+	if (nc->offset + fragsz > nc->size) {
+		/* All fragments handed back?  Then reuse the page. */
+		if (atomic_read(&nc->page->_count) == nc->pagecnt_bias ||
+		    atomic_sub_and_test(nc->pagecnt_bias, &nc->page->_count))
+			goto recycle;
+		goto refill;
+	}
+
+	data = page_address(nc->page) + nc->offset;
+	nc->offset += fragsz;
+	nc->pagecnt_bias--;
+end:
+	local_irq_restore(flags);
+	return data;
+}
+
+/**
+ *	netdev_alloc_frag - allocate a page fragment
+ *	@fragsz: fragment size
+ *
+ *	Allocates a fragment from the per-cpu page fragment cache, for use
+ *	with build_skb().  Free it with put_page(virt_to_head_page(data)).
+ *
+ *	%NULL is returned if there is no free memory.
+ */
+void *netdev_alloc_frag(unsigned int fragsz)
+{
+	return __netdev_alloc_frag(fragsz, GFP_ATOMIC | __GFP_COLD);
+}
+EXPORT_SYMBOL(netdev_alloc_frag);
+
 /**
  *	__netdev_alloc_skb - allocate an skbuff for rx on a specific device
  *	@dev: network device to receive on
@@ -247,15 +436,31 @@ nodata:
  *	the headroom they think they need without accounting for the
  *	built in space. The built in space is used for optimisations.
  *
+ *	Small atomic allocations take their head from the page fragment
+ *	cache rather than from kmalloc().
+ *
  *	%NULL is returned if there is no free memory.
  */
 struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 		unsigned int length, gfp_t gfp_mask)
 {
-	int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
-	struct sk_buff *skb;
+	struct sk_buff *skb = NULL;
+	unsigned int fragsz = SKB_DATA_ALIGN(length + NET_SKB_PAD) +
+			      SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+
+	if (fragsz <= PAGE_SIZE && !(gfp_mask & (__GFP_WAIT | GFP_DMA))) {
+		void *data = __netdev_alloc_frag(fragsz, gfp_mask);
+
+		if (likely(data)) {
+			skb = build_skb(data, fragsz);
+			if (unlikely(!skb))
+				put_page(virt_to_head_page(data));
+		}
+	} else {
+		int node = dev->dev.parent ? dev_to_node(dev->dev.parent) : -1;
 
-	skb = __alloc_skb(length + NET_SKB_PAD, gfp_mask, 0, node);
+		skb = __alloc_skb(length + NET_SKB_PAD, gfp_mask, 0, node);
+	}
 	if (likely(skb)) {
 		skb_reserve(skb, NET_SKB_PAD);
 		skb->dev = dev;
@@ -331,6 +536,220 @@ static void skb_clone_fraglist(struct sk_buff *skb)
 		skb_get(list);
 }
 
+/*
+ *	MSG_ZEROCOPY support.  The ubuf_info lives in the control block of
+ *	the skb that later carries the completion to the socket error
+ *	queue, so that nothing has to be allocated when the send completes.
+ */
+
+static inline struct sk_buff *skb_from_uarg(struct ubuf_info *uarg)
+{
+	return container_of((void *)uarg, struct sk_buff, cb);
+}
+
+/* Try to fold the range [lo, lo + len) into the report at the queue tail */
+static int skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len,
+				      u8 code)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+	u32 old_lo = serr->ee.ee_info;
+	u32 old_hi = serr->ee.ee_data;
+	u64 sum_len;
+
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    serr->ee.ee_code != code)
+		return 0;
+
+	sum_len = old_hi - old_lo + 1ULL + len;
+	if (sum_len >= (1ULL << 32) || lo != old_hi + 1)
+		return 0;
+
+	serr->ee.ee_data += len;
+	return 1;
+}
+
+static void sock_zerocopy_callback(struct ubuf_info *uarg, int zerocopy)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u32 lo, hi;
+	u16 len;
+
+	/* The only send was aborted before queueing anything */
+	if (!uarg->len || sock_flag(sk, SOCK_DEAD))
+		goto release;
+
+	len = uarg->len;
+	lo = uarg->id;
+	hi = uarg->id + len - 1;
+
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_info = lo;
+	serr->ee.ee_data = hi;
+	if (!zerocopy)
+		serr->ee.ee_code = SO_EE_CODE_ZEROCOPY_COPIED;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail ||
+	    !skb_zerocopy_notify_extend(tail, lo, len, serr->ee.ee_code)) {
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	sk->sk_error_report(sk);
+
+release:
+	if (skb)
+		kfree_skb(skb);
+	sock_put(sk);
+}
+
+/**
+ *	sock_zerocopy_alloc - start tracking a MSG_ZEROCOPY send
+ *	@sk: socket the data is sent on
+ *
+ *	Allocate the completion state for one send call and assign it the
+ *	next notification id of @sk.  The caller owns the only reference
+ *	and drops it with sock_zerocopy_put() once all data is queued.
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+
+	skb = sock_omalloc(sk, 0, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	uarg = (struct ubuf_info *)skb->cb;
+	uarg->callback = sock_zerocopy_callback;
+	uarg->id = (u32)atomic_inc_return(&sk->sk_zckey) - 1;
+	uarg->len = 1;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL(sock_zerocopy_alloc);
+
+void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg && atomic_dec_and_test(&uarg->refcnt))
+		uarg->callback(uarg, uarg->zerocopy);
+}
+EXPORT_SYMBOL(sock_zerocopy_put);
+
+/* Give back the id of a send that failed before queueing any data */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	if (uarg) {
+		struct sock *sk = skb_from_uarg(uarg)->sk;
+
+		atomic_dec(&sk->sk_zckey);
+		uarg->len--;
+		sock_zerocopy_put(uarg);
+	}
+}
+EXPORT_SYMBOL(sock_zerocopy_put_abort);
+
+/* @nskb took page references on the frags of @orig; pin the send too */
+static void skb_zerocopy_clone(struct sk_buff *nskb, struct sk_buff *orig)
+{
+	struct ubuf_info *uarg = skb_zcopy(orig);
+
+	if (uarg && !skb_zcopy(nskb)) {
+		atomic_inc(&uarg->refcnt);
+		skb_shinfo(nskb)->uarg = uarg;
+	}
+}
+
+/**
+ *	skb_zerocopy_add_frags - attach user pages to an skb
+ *	@sk: socket the data is sent on
+ *	@skb: buffer to extend
+ *	@from: user address of the data
+ *	@len: number of bytes wanted
+ *	@uarg: completion state of the send
+ *
+ *	Pin the user pages backing @from and append them to @skb as
+ *	frags instead of copying the data.  The caller must already have
+ *	scheduled socket memory for @len bytes.  Returns the number of
+ *	bytes attached, which is zero when @skb has no free frag slot,
+ *	-EEXIST if @skb carries the pages of another send, or -EFAULT
+ *	if the first page cannot be pinned.
+ */
+int skb_zerocopy_add_frags(struct sock *sk, struct sk_buff *skb,
+			   unsigned char __user *from, int len,
+			   struct ubuf_info *uarg)
+{
+	struct ubuf_info *orig = skb_zcopy(skb);
+	int copied = 0;
+
+	if (orig && orig != uarg)
+		return -EEXIST;
+
+	while (copied < len) {
+		unsigned long addr = (unsigned long)from + copied;
+		int off = addr & ~PAGE_MASK;
+		int size = min_t(int, len - copied, PAGE_SIZE - off);
+		int i = skb_shinfo(skb)->nr_frags;
+		struct page *page;
+
+		if (get_user_pages_fast(addr, 1, 0, &page) != 1) {
+			if (!copied)
+				return -EFAULT;
+			break;
+		}
+
+		if (skb_can_coalesce(skb, i, page, off)) {
+			put_page(page);
+			skb_shinfo(skb)->frags[i - 1].size += size;
+		} else if (i < MAX_SKB_FRAGS) {
+			skb_fill_page_desc(skb, i, page, off, size);
+		} else {
+			put_page(page);
+			break;
+		}
+		copied += size;
+	}
+
+	if (!copied)
+		return 0;
+
+	skb->len += copied;
+	skb->data_len += copied;
+	skb->truesize += copied;
+	sk->sk_wmem_queued += copied;
+	sk_mem_charge(sk, copied);
+
+	if (!orig) {
+		atomic_inc(&uarg->refcnt);
+		skb_shinfo(skb)->uarg = uarg;
+	}
+	return copied;
+}
+EXPORT_SYMBOL(skb_zerocopy_add_frags);
+
+static void skb_free_head(struct sk_buff *skb)
+{
+	if (skb->head_frag)
+		put_page(virt_to_head_page(skb->head));
+	else
+		kfree(skb->head);
+}
+
 static void skb_release_data(struct sk_buff *skb)
 {
 	if (!skb->cloned ||
@@ -342,10 +761,13 @@ static void skb_release_data(struct sk_buff *skb)
 				put_page(skb_shinfo(skb)->frags[i].page);
 		}
 
+		/* Last reference to the user pages of a zerocopy send */
+		sock_zerocopy_put(skb_zcopy(skb));
+
 		if (skb_shinfo(skb)->frag_list)
 			skb_drop_fraglist(skb);
 
-		kfree(skb->head);
+		skb_free_head(skb);
 	}
 }
 
@@ -359,7 +781,10 @@ static void kfree_skbmem(struct sk_buff *skb)
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		if (skb_head_cache_usable())
+			skb_head_cache_put(skb);
+		else
+			kmem_cache_free(skbuff_head_cache, skb);
 		break;
 
 	case SKB_FCLONE_ORIG:
@@ -464,8 +889,10 @@ void kfree_skb(struct sk_buff *skb)
 int skb_recycle_check(struct sk_buff *skb, int skb_size)
 {
 	struct skb_shared_info *shinfo;
+	int head_frag;
 
-	if (skb_is_nonlinear(skb) || skb->fclone != SKB_FCLONE_UNAVAILABLE)
+	if (skb_is_nonlinear(skb) || skb_zcopy(skb) ||
+	    skb->fclone != SKB_FCLONE_UNAVAILABLE)
 		return 0;
 
 	skb_size = SKB_DATA_ALIGN(skb_size + NET_SKB_PAD);
@@ -484,8 +911,11 @@ int skb_recycle_check(struct sk_buff *skb, int skb_size)
 	shinfo->gso_type = 0;
 	shinfo->ip6_frag_id = 0;
 	shinfo->frag_list = NULL;
+	shinfo->uarg = NULL;
 
+	head_frag = skb->head_frag;
 	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->head_frag = head_frag;
 	skb->data = skb->head + NET_SKB_PAD;
 	skb_reset_tail_pointer(skb);
 
@@ -529,6 +959,10 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 #endif
 #endif
 	new->vlan_tci		= old->vlan_tci;
+	new->ooo_okay		= old->ooo_okay;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id		= old->napi_id;
+#endif
 
 	skb_copy_secmark(new, old);
 }
@@ -554,6 +988,7 @@ static struct sk_buff *__skb_clone(struct sk_buff *n, struct sk_buff *skb)
 	C(head);
 	C(data);
 	C(truesize);
+	C(head_frag);
 #if defined(CONFIG_MAC80211) || defined(CONFIG_MAC80211_MODULE)
 	C(do_not_encrypt);
 	C(requeue);
@@ -731,6 +1166,7 @@ struct sk_buff *pskb_copy(struct sk_buff *skb, gfp_t gfp_mask)
 			get_page(skb_shinfo(n)->frags[i].page);
 		}
 		skb_shinfo(n)->nr_frags = i;
+		skb_zerocopy_clone(n, skb);
 	}
 
 	if (skb_shinfo(skb)->frag_list) {
@@ -795,6 +1231,10 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 		get_page(skb_shinfo(skb)->frags[i].page);
 
+	/* The copied shared info points at the same user pages */
+	if (skb_zcopy(skb))
+		atomic_inc(&skb_zcopy(skb)->refcnt);
+
 	if (skb_shinfo(skb)->frag_list)
 		skb_clone_fraglist(skb);
 
@@ -803,6 +1243,7 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 	off = (data + nhead) - skb->head;
 
 	skb->head     = data;
+	skb->head_frag = 0;
 	skb->data    += off;
 #ifdef NET_SKBUFF_DATA_USES_OFFSET
 	skb->end      = size;
@@ -1441,10 +1882,13 @@ static int __skb_splice_bits(struct sk_buff *skb, unsigned int *offset,
  * the fragments, and the frag list. It does NOT handle frag lists within
  * the frag list, if such a thing exists. We'd probably need to recurse to
  * handle that cleanly.
+ *
+ * If the caller holds the lock of socket @sk, it is dropped while the
+ * pipe is filled.  Pass a NULL @sk when no socket lock is held.
  */
-int skb_splice_bits(struct sk_buff *__skb, unsigned int offset,
-		    struct pipe_inode_info *pipe, unsigned int tlen,
-		    unsigned int flags)
+int skb_splice_bits(struct sk_buff *__skb, struct sock *sk,
+		    unsigned int offset, struct pipe_inode_info *pipe,
+		    unsigned int tlen, unsigned int flags)
 {
 	struct partial_page partial[PIPE_BUFFERS];
 	struct page *pages[PIPE_BUFFERS];
@@ -1496,7 +1940,9 @@ done:
 
 	if (spd.nr_pages) {
 		int ret;
-		struct sock *sk = __skb->sk;
+
+		if (!sk)
+			return splice_to_pipe(pipe, &spd);
 
 		/*
 		 * Drop the socket lock, otherwise we have reverse
@@ -2016,6 +2462,8 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
 		skb_split_no_header(skb, skb1, len, pos);
+
+	skb_zerocopy_clone(skb1, skb);
 }
 
 /* Shifting from/to a cloned skb is a no-go.
@@ -2053,6 +2501,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* Frags of a zerocopy send must stay with its completion state */
+	if (skb_zcopy(tgt) || skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2518,6 +2970,7 @@ struct sk_buff *skb_segment(struct sk_buff *skb, int features)
 		}
 
 		frag = skb_shinfo(nskb)->frags;
+		skb_zerocopy_clone(nskb, skb);
 
 		skb_copy_from_linear_data_offset(skb, offset,
 						 skb_put(nskb, hsize), hsize);
@@ -2660,6 +3113,22 @@ done:
 }
 EXPORT_SYMBOL_GPL(skb_gro_receive);
 
+static int skb_cpu_callback(struct notifier_block *nfb,
+			    unsigned long action, void *hcpu)
+{
+	struct skb_head_cache *hc;
+
+	if (action != CPU_DEAD && action != CPU_DEAD_FROZEN)
+		return NOTIFY_OK;
+
+	/* Give the sk_buff heads cached by the dead cpu back */
+	hc = &per_cpu(skb_head_cache, (unsigned long)hcpu);
+	kmem_cache_free_bulk(skbuff_head_cache, hc->count, hc->heads);
+	hc->count = 0;
+
+	return NOTIFY_OK;
+}
+
 void __init skb_init(void)
 {
 	skbuff_head_cache = kmem_cache_create("skbuff_head_cache",
@@ -2673,6 +3142,7 @@ void __init skb_init(void)
 						0,
 						SLAB_HWCACHE_ALIGN|SLAB_PANIC,
 						NULL);
+	hotcpu_notifier(skb_cpu_callback, 0);
 }
 
 /**
@@ -110,6 +110,7 @@
 #include <linux/tcp.h>
 #include <linux/init.h>
 #include <linux/highmem.h>
+#include <linux/errqueue.h>
 
 #include <asm/uaccess.h>
 #include <asm/system.h>
@@ -127,6 +128,7 @@
 
 #ifdef CONFIG_INET
 #include <net/tcp.h>
+#include <net/busy_poll.h>
 #endif
 
 /*
@@ -212,6 +214,12 @@ __u32 sysctl_rmem_default __read_mostly = SK_RMEM_MAX;
 /* Maximal space eaten by iovec or ancilliary data plus some space */
 int sysctl_optmem_max __read_mostly = sizeof(unsigned long)*(2*UIO_MAXIOV+512);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/* Default SO_BUSY_POLL for new sockets, and the poll()/select() budget */
+unsigned int sysctl_net_busy_read __read_mostly;
+unsigned int sysctl_net_busy_poll __read_mostly;
+#endif
+
 static int sock_set_timeout(long *timeo_p, char __user *optval, int optlen)
 {
 	struct timeval tv;
@@ -666,6 +674,31 @@ set_rcvbuf:
 		}
 		break;
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	case SO_BUSY_POLL:
+		/* allow unprivileged users to decrease the value */
+		if ((val > sk->sk_ll_usec) && !capable(CAP_NET_ADMIN))
+			ret = -EPERM;
+		else if (val < 0)
+			ret = -EINVAL;
+		else
+			sk->sk_ll_usec = val;
+		break;
+#endif
+
+	case SO_ZEROCOPY:
+		/* Only TCP knows how to send from pinned user pages */
+		if ((sk->sk_family != PF_INET && sk->sk_family != PF_INET6) ||
+		    sk->sk_type != SOCK_STREAM)
+			ret = -EOPNOTSUPP;
+		else if (val < 0 || val > 1)
+			ret = -EINVAL;
+		else if (valbool)
+			sock_set_flag(sk, SOCK_ZEROCOPY);
+		else
+			sock_reset_flag(sk, SOCK_ZEROCOPY);
+		break;
+
 		/* We implement the SO_SNDLOWAT etc to
 		   not be settable (1003.1g 5.3) */
 	default:
@@ -838,6 +871,16 @@ int sock_getsockopt(struct socket *sock, int level, int optname,
 		v.val = sk->sk_mark;
 		break;
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	case SO_BUSY_POLL:
+		v.val = sk->sk_ll_usec;
+		break;
+#endif
+
+	case SO_ZEROCOPY:
+		v.val = sock_flag(sk, SOCK_ZEROCOPY);
+		break;
+
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -949,6 +992,7 @@ struct sock *sk_alloc(struct net *net, int family, gfp_t priority,
 		sk->sk_prot = sk->sk_prot_creator = prot;
 		sock_lock_init(sk);
 		sock_net_set(sk, get_net(net));
+		sk_tx_queue_clear(sk);
 	}
 
 	return sk;
@@ -1030,6 +1074,8 @@ struct sock *sk_clone(const struct sock *sk, const gfp_t priority)
 				af_family_clock_key_strings[newsk->sk_family]);
 
 		newsk->sk_dst_cache	= NULL;
+		newsk->sk_rx_dst	= NULL;
+		sk_tx_queue_clear(newsk);
 		newsk->sk_wmem_queued	= 0;
 		newsk->sk_forward_alloc = 0;
 		newsk->sk_send_head	= NULL;
@@ -1193,6 +1239,36 @@ struct sk_buff *sock_rmalloc(struct sock *sk, unsigned long size, int force,
 	return NULL;
 }
 
+static void sock_ofree(struct sk_buff *skb)
+{
+	struct sock *sk = skb->sk;
+
+	atomic_sub(skb->truesize, &sk->sk_omem_alloc);
+}
+
+/*
+ * Allocate a skb from the socket's option memory buffer.  The caller
+ * must keep the socket alive for as long as the skb exists.
+ */
+struct sk_buff *sock_omalloc(struct sock *sk, unsigned long size,
+			     gfp_t priority)
+{
+	struct sk_buff *skb;
+
+	if (atomic_read(&sk->sk_omem_alloc) + size + sizeof(struct sk_buff) >
+	    sysctl_optmem_max)
+		return NULL;
+
+	skb = alloc_skb(size, priority);
+	if (!skb)
+		return NULL;
+
+	atomic_add(skb->truesize, &sk->sk_omem_alloc);
+	skb->sk = sk;
+	skb->destructor = sock_ofree;
+	return skb;
+}
+
 /*
  * Allocate a memory block from the socket's option memory buffer.
  */
@@ -1414,6 +1490,36 @@ int sk_wait_data(struct sock *sk, long *timeo)
 
 EXPORT_SYMBOL(sk_wait_data);
 
+/*
+ * Charge @amt pages (uncharge if negative) to memory_allocated.  The
+ * updates are gathered per cpu, so that the shared counter is only
+ * written once SK_MEMORY_PCPU_RESERVE pages have accumulated.  Returns
+ * the total as seen from this cpu.
+ */
+static int sk_memory_allocated_add(struct proto *prot, int amt)
+{
+	int *reserve;
+	int allocated;
+
+	if (!prot->per_cpu_fw_alloc)
+		return atomic_add_return(amt, prot->memory_allocated);
+
+	/* Charges come from process context as well as from softirq. */
+	local_bh_disable();
+	reserve = per_cpu_ptr(prot->per_cpu_fw_alloc, smp_processor_id());
+	*reserve += amt;
+	if (*reserve >= SK_MEMORY_PCPU_RESERVE ||
+	    *reserve <= -SK_MEMORY_PCPU_RESERVE) {
+		allocated = atomic_add_return(*reserve,
+					      prot->memory_allocated);
+		*reserve = 0;
+	} else
+		allocated = atomic_read(prot->memory_allocated) + *reserve;
+	local_bh_enable();
+
+	return allocated;
+}
+
 /**
  *	__sk_mem_schedule - increase sk_forward_alloc and memory_allocated
  *	@sk: socket
@@ -1431,7 +1537,7 @@ int __sk_mem_schedule(struct sock *sk, int size, int kind)
 	int allocated;
 
 	sk->sk_forward_alloc += amt * SK_MEM_QUANTUM;
-	allocated = atomic_add_return(amt, prot->memory_allocated);
+	allocated = sk_memory_allocated_add(prot, amt);
 
 	/* Under limit. */
 	if (allocated <= prot->sysctl_mem[0]) {
@@ -1489,7 +1595,7 @@ suppress_allocation:
 
 	/* Alas. Undo changes. */
 	sk->sk_forward_alloc -= amt * SK_MEM_QUANTUM;
-	atomic_sub(amt, prot->memory_allocated);
+	sk_memory_allocated_add(prot, -amt);
 	return 0;
 }
 
@@ -1502,13 +1608,14 @@ EXPORT_SYMBOL(__sk_mem_schedule);
 void __sk_mem_reclaim(struct sock *sk)
 {
 	struct proto *prot = sk->sk_prot;
+	int allocated;
 
-	atomic_sub(sk->sk_forward_alloc >> SK_MEM_QUANTUM_SHIFT,
-		   prot->memory_allocated);
+	allocated = sk_memory_allocated_add(prot,
+			-(sk->sk_forward_alloc >> SK_MEM_QUANTUM_SHIFT));
 	sk->sk_forward_alloc &= SK_MEM_QUANTUM - 1;
 
 	if (prot->memory_pressure && *prot->memory_pressure &&
-	    (atomic_read(prot->memory_allocated) < prot->sysctl_mem[0]))
+	    allocated < prot->sysctl_mem[0])
 		*prot->memory_pressure = 0;
 }
 
@@ -1743,6 +1850,11 @@ void sock_init_data(struct socket *sock, struct sock *sk)
 
 	sk->sk_stamp = ktime_set(-1L, 0);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	sk->sk_napi_id		=	0;
+	sk->sk_ll_usec		=	sysctl_net_busy_read;
+#endif
+
 	atomic_set(&sk->sk_refcnt, 1);
 	atomic_set(&sk->sk_drops, 0);
 }
@@ -1868,6 +1980,45 @@ int sock_common_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 EXPORT_SYMBOL(sock_common_recvmsg);
 
+/*
+ *	Pop the oldest report off the socket error queue for a
+ *	MSG_ERRQUEUE read, for protocols with no addressing to add.
+ */
+int sock_recv_errqueue(struct sock *sk, struct msghdr *msg, int len,
+		       int level, int type)
+{
+	struct sock_exterr_skb *serr;
+	struct sk_buff *skb;
+	int copied, err;
+
+	err = -EAGAIN;
+	skb = skb_dequeue(&sk->sk_error_queue);
+	if (skb == NULL)
+		goto out;
+
+	copied = skb->len;
+	if (copied > len) {
+		msg->msg_flags |= MSG_TRUNC;
+		copied = len;
+	}
+	err = skb_copy_datagram_iovec(skb, 0, msg->msg_iov, copied);
+	if (err)
+		goto out_free_skb;
+
+	serr = SKB_EXT_ERR(skb);
+	put_cmsg(msg, level, type, sizeof(serr->ee), &serr->ee);
+
+	msg->msg_flags |= MSG_ERRQUEUE;
+	err = copied;
+
+out_free_skb:
+	kfree_skb(skb);
+out:
+	return err;
+}
+
+EXPORT_SYMBOL(sock_recv_errqueue);
+
 /*
  *	Set socket options on an inet socket.
  */
@@ -2090,6 +2241,10 @@ int proto_register(struct proto *prot, int alloc_slab)
 		}
 	}
 
+	/* Without the per cpu reserves every charge goes to memory_allocated */
+	if (prot->memory_allocated && !prot->per_cpu_fw_alloc)
+		prot->per_cpu_fw_alloc = alloc_percpu(int);
+
 	write_lock(&proto_list_lock);
 	list_add(&prot->node, &proto_list);
 	assign_proto_idx(prot);
@@ -2121,6 +2276,16 @@ void proto_unregister(struct proto *prot)
 	list_del(&prot->node);
 	write_unlock(&proto_list_lock);
 
+	if (prot->per_cpu_fw_alloc != NULL) {
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			atomic_add(*per_cpu_ptr(prot->per_cpu_fw_alloc, cpu),
+				   prot->memory_allocated);
+		free_percpu(prot->per_cpu_fw_alloc);
+		prot->per_cpu_fw_alloc = NULL;
+	}
+
 	if (prot->slab != NULL) {
 		kmem_cache_destroy(prot->slab);
 		prot->slab = NULL;
@@ -2272,6 +2437,7 @@ EXPORT_SYMBOL(sock_alloc_send_skb);
 EXPORT_SYMBOL(sock_init_data);
 EXPORT_SYMBOL(sock_kfree_s);
 EXPORT_SYMBOL(sock_kmalloc);
+EXPORT_SYMBOL(sock_omalloc);
 EXPORT_SYMBOL(sock_no_accept);
 EXPORT_SYMBOL(sock_no_bind);
 EXPORT_SYMBOL(sock_no_connect);
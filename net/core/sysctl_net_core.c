@@ -12,6 +12,7 @@
 #include <linux/netdevice.h>
 #include <linux/init.h>
 #include <net/sock.h>
+#include <net/busy_poll.h>
 
 static struct ctl_table net_core_table[] = {
 #ifdef CONFIG_NET
@@ -88,6 +89,24 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	{
+		.ctl_name	= CTL_UNNUMBERED,
+		.procname	= "busy_poll",
+		.data		= &sysctl_net_busy_poll,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec
+	},
+	{
+		.ctl_name	= CTL_UNNUMBERED,
+		.procname	= "busy_read",
+		.data		= &sysctl_net_busy_read,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec
+	},
+#endif
 #endif /* CONFIG_NET */
 	{
 		.ctl_name	= NET_CORE_BUDGET,
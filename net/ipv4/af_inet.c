@@ -156,6 +156,7 @@ void inet_sock_destruct(struct sock *sk)
 
 	kfree(inet->opt);
 	dst_release(sk->sk_dst_cache);
+	dst_release(sk->sk_rx_dst);
 	sk_refcnt_debug_dec(sk);
 }
 
@@ -883,6 +884,7 @@ const struct proto_ops inet_dgram_ops = {
 	.recvmsg	   = sock_common_recvmsg,
 	.mmap		   = sock_no_mmap,
 	.sendpage	   = inet_sendpage,
+	.splice_read	   = udp_splice_read,
 #ifdef CONFIG_COMPAT
 	.compat_setsockopt = compat_sock_common_setsockopt,
 	.compat_getsockopt = compat_sock_common_getsockopt,
@@ -1199,6 +1201,7 @@ static struct sk_buff *inet_gso_segment(struct sk_buff *skb, int features)
 		       SKB_GSO_UDP |
 		       SKB_GSO_DODGY |
 		       SKB_GSO_TCP_ECN |
+		       SKB_GSO_UDP_L4 |
 		       0)))
 		goto out;
 
@@ -1407,6 +1410,7 @@ static struct net_protocol igmp_protocol = {
 #endif
 
 static struct net_protocol tcp_protocol = {
+	.early_demux =	tcp_v4_early_demux,
 	.handler =	tcp_v4_rcv,
 	.err_handler =	tcp_v4_err,
 	.gso_send_check = tcp_v4_gso_send_check,
@@ -1420,6 +1424,7 @@ static struct net_protocol tcp_protocol = {
 static struct net_protocol udp_protocol = {
 	.handler =	udp_rcv,
 	.err_handler =	udp_err,
+	.gso_segment =	udp4_gso_segment,
 	.no_policy =	1,
 	.netns_ok =	1,
 };
@@ -193,7 +193,7 @@ static int inet_twsk_diag_fill(struct inet_timewait_sock *tw,
 
 	nlh->nlmsg_flags = nlmsg_flags;
 
-	tmo = tw->tw_ttd - jiffies;
+	tmo = inet_twsk_ttd(tw);
 	if (tmo < 0)
 		tmo = 0;
 
@@ -320,11 +320,32 @@ drop:
 	return -1;
 }
 
+int sysctl_ip_early_demux __read_mostly = 1;
+
 static int ip_rcv_finish(struct sk_buff *skb)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct rtable *rt;
 
+	/*
+	 *	Let the transport protocol find the socket first: an
+	 *	established socket may already know the input route.
+	 */
+	if (sysctl_ip_early_demux && skb->dst == NULL && skb->sk == NULL &&
+	    !(iph->frag_off & htons(IP_MF | IP_OFFSET))) {
+		const struct net_protocol *ipprot;
+		int hash = iph->protocol & (MAX_INET_PROTOS - 1);
+
+		rcu_read_lock();
+		ipprot = rcu_dereference(inet_protos[hash]);
+		if (ipprot && ipprot->early_demux) {
+			ipprot->early_demux(skb);
+			/* the header may have been pulled into a new head */
+			iph = ip_hdr(skb);
+		}
+		rcu_read_unlock();
+	}
+
 	/*
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
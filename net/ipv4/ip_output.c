@@ -720,14 +720,15 @@ static inline int ip_ufo_append_data(struct sock *sk,
 			int getfrag(void *from, char *to, int offset, int len,
 			       int odd, struct sk_buff *skb),
 			void *from, int length, int hh_len, int fragheaderlen,
-			int transhdrlen, int mtu, unsigned int flags)
+			int transhdrlen, int gso_size, int gso_type,
+			unsigned int flags)
 {
 	struct sk_buff *skb;
 	int err;
 
-	/* There is support for UDP fragmentation offload by network
-	 * device, so create one single skb packet containing complete
-	 * udp datagram
+	/* The device, or GSO on the way to it, cuts the data into
+	 * datagrams or fragments, so create one single skb packet
+	 * containing all of it
 	 */
 	if ((skb = skb_peek_tail(&sk->sk_write_queue)) == NULL) {
 		skb = sock_alloc_send_skb(sk,
@@ -753,9 +754,9 @@ static inline int ip_ufo_append_data(struct sock *sk,
 		skb->csum = 0;
 		sk->sk_sndmsg_off = 0;
 
-		/* specify the length of each IP datagram fragment */
-		skb_shinfo(skb)->gso_size = mtu - fragheaderlen;
-		skb_shinfo(skb)->gso_type = SKB_GSO_UDP;
+		/* specify the length of each fragment or datagram */
+		skb_shinfo(skb)->gso_size = gso_size;
+		skb_shinfo(skb)->gso_type = gso_type;
 		__skb_queue_tail(&sk->sk_write_queue, skb);
 	}
 
@@ -859,11 +860,26 @@ int ip_append_data(struct sock *sk,
 		csummode = CHECKSUM_PARTIAL;
 
 	inet->cork.length += length;
+	if (inet->cork.gso_size) {
+		/* UDP_SEGMENT: every datagram must fit the path MTU */
+		err = -EINVAL;
+		if (fragheaderlen + transhdrlen + inet->cork.gso_size > mtu)
+			goto error;
+		err = ip_ufo_append_data(sk, getfrag, from, length, hh_len,
+					 fragheaderlen, transhdrlen,
+					 inet->cork.gso_size, SKB_GSO_UDP_L4,
+					 flags);
+		if (err)
+			goto error;
+		return 0;
+	}
+
 	if (((length> mtu) || !skb_queue_empty(&sk->sk_write_queue)) &&
 	    (sk->sk_protocol == IPPROTO_UDP) &&
 	    (rt->u.dst.dev->features & NETIF_F_UFO)) {
 		err = ip_ufo_append_data(sk, getfrag, from, length, hh_len,
-					 fragheaderlen, transhdrlen, mtu,
+					 fragheaderlen, transhdrlen,
+					 mtu - fragheaderlen, SKB_GSO_UDP,
 					 flags);
 		if (err)
 			goto error;
@@ -1253,9 +1269,10 @@ int ip_push_pending_frames(struct sock *sk)
 
 	/* DF bit is set when we want to see DF on outgoing frames.
 	 * If local_df is set too, we still allow to fragment this frame
-	 * locally. */
+	 * locally.  UDP_SEGMENT datagrams each fit the MTU on their own. */
 	if (inet->pmtudisc >= IP_PMTUDISC_DO ||
-	    (skb->len <= dst_mtu(&rt->u.dst) &&
+	    ((skb->len <= dst_mtu(&rt->u.dst) ||
+	      skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) &&
 	     ip_dont_fragment(sk, &rt->u.dst)))
 		df = htons(IP_DF);
 
@@ -1680,6 +1680,15 @@ static struct dst_entry *ipv4_dst_check(struct dst_entry *dst, u32 cookie)
 	return NULL;
 }
 
+/*
+ * Sockets keep the input route of their flow for early demux.  It may
+ * be reused for as long as it has not been flushed from the cache.
+ */
+int ip_rx_dst_valid(struct dst_entry *dst)
+{
+	return !dst->obsolete && !rt_is_expired((struct rtable *)dst);
+}
+
 static void ipv4_dst_destroy(struct dst_entry *dst)
 {
 	struct rtable *rt = (struct rtable *) dst;
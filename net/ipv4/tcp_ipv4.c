@@ -71,6 +71,7 @@
 #include <net/timewait_sock.h>
 #include <net/xfrm.h>
 #include <net/netdma.h>
+#include <net/busy_poll.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -1530,6 +1531,74 @@ csum_err:
  *	From tcp_input.c
  */
 
+static void tcp_v4_edemux_destructor(struct sk_buff *skb)
+{
+	struct sock *sk = skb->sk;
+
+	if (sk->sk_state == TCP_TIME_WAIT)
+		inet_twsk_put(inet_twsk(sk));
+	else
+		sock_put(sk);
+}
+
+/*
+ *	Called from ip_rcv_finish() before the route lookup.  Attach the
+ *	established socket to the skb, so that tcp_v4_rcv() need not look
+ *	it up again, and reuse the input route it has cached, if any.
+ */
+void tcp_v4_early_demux(struct sk_buff *skb)
+{
+	const struct iphdr *iph;
+	const struct tcphdr *th;
+	struct dst_entry *dst;
+	struct sock *sk;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return;
+
+	if (!pskb_may_pull(skb, ip_hdrlen(skb) + sizeof(struct tcphdr)))
+		return;
+
+	iph = ip_hdr(skb);
+	th = (struct tcphdr *)((char *)iph + ip_hdrlen(skb));
+
+	if (th->doff < sizeof(struct tcphdr) / 4)
+		return;
+
+	sk = __inet_lookup_established(dev_net(skb->dev), &tcp_hashinfo,
+				       iph->saddr, th->source,
+				       iph->daddr, ntohs(th->dest),
+				       skb->iif);
+	if (!sk)
+		return;
+
+	skb->sk = sk;
+	skb->destructor = tcp_v4_edemux_destructor;
+	if (sk->sk_state == TCP_TIME_WAIT)
+		return;
+
+	/* sk_rx_dst is only changed with the socket spinlock held */
+	bh_lock_sock_nested(sk);
+	dst = sk->sk_rx_dst;
+	if (dst && inet_sk(sk)->rx_dst_ifindex == skb->iif &&
+	    ip_rx_dst_valid(dst))
+		skb->dst = dst_clone(dst);
+	bh_unlock_sock(sk);
+}
+
+/* Remember the input route of an established flow for early demux. */
+static void tcp_v4_rx_dst_update(struct sock *sk, struct sk_buff *skb)
+{
+	struct dst_entry *dst = sk->sk_rx_dst;
+
+	if (dst == skb->dst)
+		return;
+
+	sk->sk_rx_dst = dst_clone(skb->dst);
+	inet_sk(sk)->rx_dst_ifindex = inet_iif(skb);
+	dst_release(dst);
+}
+
 int tcp_v4_rcv(struct sk_buff *skb)
 {
 	const struct iphdr *iph;
@@ -1586,9 +1655,12 @@ process:
 	if (sk_filter(sk, skb))
 		goto discard_and_relse;
 
+	sk_mark_napi_id(sk, skb);
 	skb->dev = NULL;
 
 	bh_lock_sock_nested(sk);
+	if (sk->sk_state == TCP_ESTABLISHED)
+		tcp_v4_rx_dst_update(sk, skb);
 	ret = 0;
 	if (!sock_owned_by_user(sk)) {
 #ifdef CONFIG_NET_DMA
@@ -2262,7 +2334,7 @@ static void get_timewait4_sock(struct inet_timewait_sock *tw,
 {
 	__be32 dest, src;
 	__u16 destp, srcp;
-	int ttd = tw->tw_ttd - jiffies;
+	int ttd = inet_twsk_ttd(tw);
 
 	if (ttd < 0)
 		ttd = 0;
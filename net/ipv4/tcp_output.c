@@ -638,6 +638,9 @@ static int tcp_transmit_skb(struct sock *sk, struct sk_buff *skb, int clone_it,
 	if (tcp_packets_in_flight(tp) == 0)
 		tcp_ca_event(sk, CA_EVENT_TX_START);
 
+	/* Nothing of ours is queued below us: the tx queue may change */
+	skb->ooo_okay = atomic_read(&sk->sk_wmem_alloc) == 0;
+
 	skb_push(skb, tcp_header_size);
 	skb_reset_transport_header(skb);
 	skb_set_owner_w(skb, sk);
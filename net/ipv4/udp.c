@@ -99,11 +99,13 @@
 #include <linux/skbuff.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/splice.h>
 #include <net/net_namespace.h>
 #include <net/icmp.h>
 #include <net/route.h>
 #include <net/checksum.h>
 #include <net/xfrm.h>
+#include <net/busy_poll.h>
 #include "udp_impl.h"
 
 struct udp_table udp_table;
@@ -545,6 +547,24 @@ out:
 	return err;
 }
 
+int udp_cmsg_send(struct msghdr *msg, u16 *gso_size)
+{
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (!CMSG_OK(msg, cmsg))
+			return -EINVAL;
+		if (cmsg->cmsg_level != SOL_UDP)
+			continue;
+		if (cmsg->cmsg_type != UDP_SEGMENT ||
+		    cmsg->cmsg_len != CMSG_LEN(sizeof(__u16)))
+			return -EINVAL;
+		*gso_size = *(__u16 *)CMSG_DATA(cmsg);
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(udp_cmsg_send);
+
 int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		size_t len)
 {
@@ -561,6 +581,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	int err, is_udplite = IS_UDPLITE(sk);
 	int corkreq = up->corkflag || msg->msg_flags&MSG_MORE;
 	int (*getfrag)(void *, char *, int, int, int, struct sk_buff *);
+	u16 gso_size = up->gso_size;
 
 	if (len > 0xFFFF)
 		return -EMSGSIZE;
@@ -621,6 +642,9 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 
 	ipc.oif = sk->sk_bound_dev_if;
 	if (msg->msg_controllen) {
+		err = udp_cmsg_send(msg, &gso_size);
+		if (err)
+			return err;
 		err = ip_cmsg_send(sock_net(sk), msg, &ipc);
 		if (err)
 			return err;
@@ -631,6 +655,19 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	if (!ipc.opt)
 		ipc.opt = inet->opt;
 
+	/*
+	 *	UDP_SEGMENT: build one skb for the whole buffer and let GSO
+	 *	cut it into datagrams of gso_size bytes on the way out.
+	 */
+	if (corkreq || len <= gso_size)
+		gso_size = 0;
+	else if (gso_size && (is_udplite ||
+			      sk->sk_no_check == UDP_CSUM_NOXMIT ||
+			      len > gso_size * UDP_MAX_SEGMENTS)) {
+		err = -EINVAL;
+		goto out;
+	}
+
 	saddr = ipc.addr;
 	ipc.addr = faddr = daddr;
 
@@ -713,6 +750,7 @@ back_from_confirm:
 	inet->cork.fl.fl_ip_dport = dport;
 	inet->cork.fl.fl4_src = saddr;
 	inet->cork.fl.fl_ip_sport = inet->sport;
+	inet->cork.gso_size = gso_size;
 	up->pending = AF_INET;
 
 do_append_data:
@@ -1240,7 +1278,10 @@ int __udp4_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 	sk = __udp4_lib_lookup_skb(skb, uh->source, uh->dest, udptable);
 
 	if (sk != NULL) {
-		int ret = udp_queue_rcv_skb(sk, skb);
+		int ret;
+
+		sk_mark_napi_id(sk, skb);
+		ret = udp_queue_rcv_skb(sk, skb);
 		sock_put(sk);
 
 		/* a return value > 0 means to resubmit the input, but
@@ -1303,6 +1344,73 @@ int udp_rcv(struct sk_buff *skb)
 	return __udp4_lib_rcv(skb, &udp_table, IPPROTO_UDP);
 }
 
+/*
+ *	Cut a UDP_SEGMENT skb into datagrams of gso_size payload bytes,
+ *	each with its own UDP length and checksum.
+ */
+struct sk_buff *udp4_gso_segment(struct sk_buff *skb, int features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	struct udphdr *uh;
+	struct iphdr *iph;
+	unsigned int mss;
+	unsigned int len;
+	__wsum csum;
+
+	if (!(skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4))
+		goto out;
+
+	if (!pskb_may_pull(skb, sizeof(*uh)))
+		goto out;
+
+	__skb_pull(skb, sizeof(*uh));
+
+	mss = skb_shinfo(skb)->gso_size;
+	if (unlikely(skb->len <= mss))
+		goto out;
+
+	if (skb_gso_ok(skb, features | NETIF_F_GSO_ROBUST)) {
+		/* Packet is from an untrusted source, reset gso_segs. */
+		int type = skb_shinfo(skb)->gso_type;
+
+		if (unlikely(type & ~(SKB_GSO_UDP_L4 | SKB_GSO_DODGY)))
+			goto out;
+
+		skb_shinfo(skb)->gso_segs = DIV_ROUND_UP(skb->len, mss);
+
+		segs = NULL;
+		goto out;
+	}
+
+	segs = skb_segment(skb, features);
+	if (IS_ERR(segs))
+		goto out;
+
+	for (skb = segs; skb; skb = skb->next) {
+		uh = udp_hdr(skb);
+		iph = ip_hdr(skb);
+		len = skb->len - skb_transport_offset(skb);
+
+		uh->len = htons(len);
+		if (skb->ip_summed == CHECKSUM_PARTIAL) {
+			uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+						       len, IPPROTO_UDP, 0);
+			continue;
+		}
+
+		/* skb_segment() summed the payload, add the header */
+		uh->check = 0;
+		csum = csum_partial(uh, sizeof(*uh), skb->csum);
+		uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr,
+					      len, IPPROTO_UDP, csum);
+		if (uh->check == 0)
+			uh->check = CSUM_MANGLED_0;
+	}
+
+out:
+	return segs;
+}
+
 void udp_destroy_sock(struct sock *sk)
 {
 	lock_sock(sk);
@@ -1340,6 +1448,12 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		}
 		break;
 
+	case UDP_SEGMENT:
+		if (val < 0 || val > USHORT_MAX)
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
 	case UDP_ENCAP:
 		switch (val) {
 		case 0:
@@ -1433,6 +1547,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->corkflag;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
 	case UDP_ENCAP:
 		val = up->encap_type;
 		break;
@@ -1520,6 +1638,70 @@ unsigned int udp_poll(struct file *file, struct socket *sock, poll_table *wait)
 
 }
 
+/**
+ *	udp_splice_read - splice a datagram from a UDP socket to a pipe
+ *	@sock:	socket to splice from
+ *	@ppos:	position (not valid)
+ *	@pipe:	pipe to splice to
+ *	@len:	number of bytes to splice
+ *	@flags:	splice modifier flags
+ *
+ *	Like recvmsg(), one call consumes one datagram and drops whatever
+ *	does not fit in @len.  The payload is handed to the pipe without
+ *	a copy, so the checksum has to be verified first.
+ */
+ssize_t udp_splice_read(struct socket *sock, loff_t *ppos,
+			struct pipe_inode_info *pipe, size_t len,
+			unsigned int flags)
+{
+	struct sock *sk = sock->sk;
+	int noblock = flags & SPLICE_F_NONBLOCK;
+	int is_udplite = IS_UDPLITE(sk);
+	struct sk_buff *skb;
+	unsigned int ulen;
+	int peeked;
+	int err;
+
+	if (unlikely(*ppos))
+		return -ESPIPE;
+
+try_again:
+	skb = __skb_recv_datagram(sk, noblock ? MSG_DONTWAIT : 0,
+				  &peeked, &err);
+	if (!skb)
+		return err;
+
+	if (udp_lib_checksum_complete(skb)) {
+		UDPX_INC_STATS_USER(sk, UDP_MIB_INERRORS, is_udplite);
+		lock_sock(sk);
+		skb_free_datagram(sk, skb);
+		release_sock(sk);
+
+		if (noblock)
+			return -EAGAIN;
+		goto try_again;
+	}
+
+	ulen = skb->len - sizeof(struct udphdr);
+	if (len > ulen)
+		len = ulen;
+
+	err = skb_splice_bits(skb, NULL, sizeof(struct udphdr), pipe, len,
+			      flags);
+	if (len && err <= 0) {
+		/* The pipe is full: keep the datagram for the next read */
+		skb_queue_head(&sk->sk_receive_queue, skb);
+		return err;
+	}
+
+	UDPX_INC_STATS_USER(sk, UDP_MIB_INDATAGRAMS, is_udplite);
+
+	lock_sock(sk);
+	skb_free_datagram(sk, skb);
+	release_sock(sk);
+	return err;
+}
+
 struct proto udp_prot = {
 	.name		   = "UDP",
 	.owner		   = THIS_MODULE,
@@ -1786,6 +1968,7 @@ EXPORT_SYMBOL(udp_sendmsg);
 EXPORT_SYMBOL(udp_lib_getsockopt);
 EXPORT_SYMBOL(udp_lib_setsockopt);
 EXPORT_SYMBOL(udp_poll);
+EXPORT_SYMBOL(udp_splice_read);
 EXPORT_SYMBOL(udp_lib_get_port);
 
 #ifdef CONFIG_PROC_FS
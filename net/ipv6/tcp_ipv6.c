@@ -59,6 +59,7 @@
 #include <net/dsfield.h>
 #include <net/timewait_sock.h>
 #include <net/netdma.h>
+#include <net/busy_poll.h>
 #include <net/inet_common.h>
 
 #include <asm/uaccess.h>
@@ -1667,6 +1668,7 @@ process:
 	if (sk_filter(sk, skb))
 		goto discard_and_relse;
 
+	sk_mark_napi_id(sk, skb);
 	skb->dev = NULL;
 
 	bh_lock_sock_nested(sk);
@@ -1978,7 +1980,7 @@ static void get_timewait6_sock(struct seq_file *seq,
 	struct in6_addr *dest, *src;
 	__u16 destp, srcp;
 	struct inet6_timewait_sock *tw6 = inet6_twsk((struct sock *)tw);
-	int ttd = tw->tw_ttd - jiffies;
+	int ttd = inet_twsk_ttd(tw);
 
 	if (ttd < 0)
 		ttd = 0;
@@ -47,6 +47,7 @@
 
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <net/busy_poll.h>
 #include "udp_impl.h"
 
 int udp_v6_get_port(struct sock *sk, unsigned short snum)
@@ -566,6 +567,7 @@ int __udp6_lib_rcv(struct sk_buff *skb, struct udp_table *udptable,
 
 	/* deliver */
 
+	sk_mark_napi_id(sk, skb);
 	bh_lock_sock(sk);
 	if (!sock_owned_by_user(sk))
 		udpv6_queue_rcv_skb(sk, skb);
@@ -747,6 +749,23 @@ do_udp_sendmsg:
 		}
 		release_sock(sk);
 	}
+
+	/*
+	 * UDP_SEGMENT is only implemented by udp_sendmsg(), i.e. for
+	 * v4-mapped destinations.  Refuse a send that would need it rather
+	 * than emit one big fragmented datagram.
+	 */
+	if (!corkreq) {
+		u16 gso_size = up->gso_size;
+
+		if (msg->msg_controllen) {
+			err = udp_cmsg_send(msg, &gso_size);
+			if (err)
+				return err;
+		}
+		if (gso_size && len > gso_size)
+			return -EOPNOTSUPP;
+	}
 	ulen += sizeof(struct udphdr);
 
 	memset(&fl, 0, sizeof(fl));
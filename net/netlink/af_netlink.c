@@ -55,6 +55,8 @@
 #include <linux/types.h>
 #include <linux/audit.h>
 #include <linux/mutex.h>
+#include <linux/highmem.h>
+#include <linux/poll.h>
 
 #include <net/net_namespace.h>
 #include <net/sock.h>
@@ -64,6 +66,17 @@
 #define NLGRPSZ(x)	(ALIGN(x, sizeof(unsigned long) * 8) / 8)
 #define NLGRPLONGS(x)	(NLGRPSZ(x)/sizeof(unsigned long))
 
+struct netlink_ring {
+	char			**pg_vec;
+	unsigned int		head;
+	unsigned int		frames_per_block;
+	unsigned int		frame_size;
+	unsigned int		frame_max;
+	unsigned int		pg_vec_order;
+	unsigned int		pg_vec_pages;
+	unsigned int		pg_vec_len;
+};
+
 struct netlink_sock {
 	/* struct sock has to be the first member of netlink_sock */
 	struct sock		sk;
@@ -81,6 +94,12 @@ struct netlink_sock {
 	struct mutex		cb_def_mutex;
 	void			(*netlink_rcv)(struct sk_buff *skb);
 	struct module		*module;
+#ifdef CONFIG_NETLINK_MMAP
+	struct mutex		pg_vec_lock;
+	struct netlink_ring	rx_ring;
+	struct netlink_ring	tx_ring;
+	atomic_t		mapped;
+#endif
 };
 
 #define NETLINK_KERNEL_SOCKET	0x1
@@ -126,6 +145,11 @@ static DECLARE_WAIT_QUEUE_HEAD(nl_table_wait);
 
 static int netlink_dump(struct sock *sk);
 static void netlink_destroy_callback(struct netlink_callback *cb);
+static void netlink_overrun(struct sock *sk);
+#ifdef CONFIG_NETLINK_MMAP
+static int netlink_set_ring(struct sock *sk, struct nl_mmap_req *req,
+			    int closing, int tx_ring);
+#endif
 
 static DEFINE_RWLOCK(nl_table_lock);
 static atomic_t nl_table_users = ATOMIC_INIT(0);
@@ -413,6 +437,9 @@ static int __netlink_create(struct net *net, struct socket *sock,
 		mutex_init(nlk->cb_mutex);
 	}
 	init_waitqueue_head(&nlk->wait);
+#ifdef CONFIG_NETLINK_MMAP
+	mutex_init(&nlk->pg_vec_lock);
+#endif
 
 	sk->sk_destruct = netlink_sock_destruct;
 	sk->sk_protocol = protocol;
@@ -488,6 +515,18 @@ static int netlink_release(struct socket *sock)
 
 	skb_queue_purge(&sk->sk_write_queue);
 
+#ifdef CONFIG_NETLINK_MMAP
+	{
+		struct nl_mmap_req req;
+
+		memset(&req, 0, sizeof(req));
+		if (nlk->rx_ring.pg_vec)
+			netlink_set_ring(sk, &req, 1, 0);
+		if (nlk->tx_ring.pg_vec)
+			netlink_set_ring(sk, &req, 1, 1);
+	}
+#endif
+
 	if (nlk->pid && !nlk->subscriptions) {
 		struct netlink_notify n = {
 						.net = sock_net(sk),
@@ -757,6 +796,197 @@ struct sock *netlink_getsockbyfilp(struct file *filp)
 	return sock;
 }
 
+#ifdef CONFIG_NETLINK_MMAP
+static inline int netlink_rx_is_mmaped(struct sock *sk)
+{
+	return nlk_sk(sk)->rx_ring.pg_vec != NULL;
+}
+
+static inline int netlink_tx_is_mmaped(struct sock *sk)
+{
+	return nlk_sk(sk)->tx_ring.pg_vec != NULL;
+}
+
+static enum nl_mmap_status netlink_get_status(const struct nl_mmap_hdr *hdr)
+{
+	smp_rmb();
+	flush_dcache_page(virt_to_page(hdr));
+	return hdr->nm_status;
+}
+
+static void netlink_set_status(struct nl_mmap_hdr *hdr,
+			       enum nl_mmap_status status)
+{
+	/* The frame contents must be visible before its status. */
+	smp_mb();
+	hdr->nm_status = status;
+	flush_dcache_page(virt_to_page(hdr));
+}
+
+static struct nl_mmap_hdr *
+netlink_lookup_frame(const struct netlink_ring *ring, unsigned int pos,
+		     enum nl_mmap_status status)
+{
+	unsigned int pg_vec_pos, frame_off;
+	struct nl_mmap_hdr *hdr;
+
+	pg_vec_pos = pos / ring->frames_per_block;
+	frame_off  = pos % ring->frames_per_block;
+
+	hdr = (struct nl_mmap_hdr *)(ring->pg_vec[pg_vec_pos] +
+				     frame_off * ring->frame_size);
+	if (netlink_get_status(hdr) != status)
+		return NULL;
+	return hdr;
+}
+
+static struct nl_mmap_hdr *
+netlink_current_frame(const struct netlink_ring *ring,
+		      enum nl_mmap_status status)
+{
+	return netlink_lookup_frame(ring, ring->head, status);
+}
+
+static struct nl_mmap_hdr *
+netlink_previous_frame(const struct netlink_ring *ring,
+		       enum nl_mmap_status status)
+{
+	unsigned int prev;
+
+	prev = ring->head ? ring->head - 1 : ring->frame_max;
+	return netlink_lookup_frame(ring, prev, status);
+}
+
+static void netlink_increment_head(struct netlink_ring *ring)
+{
+	ring->head = ring->head != ring->frame_max ? ring->head + 1 : 0;
+}
+
+/*
+ * Copy @skb into the frame @hdr of the receive ring and hand the frame
+ * to user space.  Called with the receive queue lock held.
+ */
+static void netlink_ring_fill(struct nl_mmap_hdr *hdr, struct sk_buff *skb)
+{
+	skb_copy_bits(skb, 0, (void *)hdr + NL_MMAP_HDRLEN, skb->len);
+	hdr->nm_len	= skb->len;
+	hdr->nm_group	= NETLINK_CB(skb).dst_group;
+	hdr->nm_pid	= NETLINK_CB(skb).pid;
+	hdr->nm_uid	= NETLINK_CREDS(skb)->uid;
+	hdr->nm_gid	= NETLINK_CREDS(skb)->gid;
+	netlink_set_status(hdr, NL_MMAP_STATUS_VALID);
+}
+
+/*
+ * Deliver an skb owned by @sk through its receive ring.  Messages that
+ * do not fit into a frame stay on the receive queue and are announced
+ * with a COPY frame, to be picked up with recvmsg().
+ */
+static void netlink_ring_queue(struct sock *sk, struct sk_buff *skb)
+{
+	struct netlink_ring *ring = &nlk_sk(sk)->rx_ring;
+	struct nl_mmap_hdr *hdr;
+
+	spin_lock_bh(&sk->sk_receive_queue.lock);
+	hdr = netlink_current_frame(ring, NL_MMAP_STATUS_UNUSED);
+	if (hdr == NULL) {
+		spin_unlock_bh(&sk->sk_receive_queue.lock);
+		kfree_skb(skb);
+		netlink_overrun(sk);
+		return;
+	}
+	netlink_increment_head(ring);
+
+	if (skb->len > ring->frame_size - NL_MMAP_HDRLEN) {
+		hdr->nm_len = skb->len;
+		netlink_set_status(hdr, NL_MMAP_STATUS_COPY);
+		__skb_queue_tail(&sk->sk_receive_queue, skb);
+		spin_unlock_bh(&sk->sk_receive_queue.lock);
+		return;
+	}
+
+	netlink_ring_fill(hdr, skb);
+	spin_unlock_bh(&sk->sk_receive_queue.lock);
+	kfree_skb(skb);
+}
+
+/*
+ * A dump must not produce its next chunk while the receive ring is
+ * full: netlink_ring_queue() would have to drop it.  The dump is
+ * continued from poll() or recvmsg() once user space releases frames.
+ */
+static int netlink_rx_has_room(struct sock *sk)
+{
+	struct netlink_ring *ring = &nlk_sk(sk)->rx_ring;
+	int room;
+
+	spin_lock_bh(&sk->sk_receive_queue.lock);
+	room = netlink_current_frame(ring, NL_MMAP_STATUS_UNUSED) != NULL;
+	spin_unlock_bh(&sk->sk_receive_queue.lock);
+	return room;
+}
+
+/*
+ * Broadcast delivery straight from the sender's skb into the receive
+ * ring, without cloning it for this listener.  Returns -EMSGSIZE if
+ * the message has to go through the receive queue instead.
+ */
+static int netlink_ring_broadcast(struct sock *sk, struct sk_buff *skb)
+{
+	struct netlink_ring *ring = &nlk_sk(sk)->rx_ring;
+	struct nl_mmap_hdr *hdr;
+	int err = 0;
+
+	if (skb->len > ring->frame_size - NL_MMAP_HDRLEN)
+		return -EMSGSIZE;
+
+	spin_lock_bh(&sk->sk_receive_queue.lock);
+	hdr = netlink_current_frame(ring, NL_MMAP_STATUS_UNUSED);
+	if (hdr != NULL) {
+		netlink_increment_head(ring);
+		netlink_ring_fill(hdr, skb);
+	} else
+		err = -ENOBUFS;
+	spin_unlock_bh(&sk->sk_receive_queue.lock);
+	return err;
+}
+#else /* CONFIG_NETLINK_MMAP */
+static inline int netlink_rx_is_mmaped(struct sock *sk)
+{
+	return 0;
+}
+
+static inline int netlink_tx_is_mmaped(struct sock *sk)
+{
+	return 0;
+}
+
+static inline void netlink_ring_queue(struct sock *sk, struct sk_buff *skb)
+{
+}
+
+static inline int netlink_rx_has_room(struct sock *sk)
+{
+	return 1;
+}
+
+static inline int netlink_ring_broadcast(struct sock *sk, struct sk_buff *skb)
+{
+	return -EMSGSIZE;
+}
+#endif /* CONFIG_NETLINK_MMAP */
+
+static void __netlink_sendskb(struct sock *sk, struct sk_buff *skb)
+{
+	int len = skb->len;
+
+	if (netlink_rx_is_mmaped(sk))
+		netlink_ring_queue(sk, skb);
+	else
+		skb_queue_tail(&sk->sk_receive_queue, skb);
+	sk->sk_data_ready(sk, len);
+}
+
 /*
  * Attach a skb to a netlink socket.
  * The caller must hold a reference to the destination socket. On error, the
@@ -811,8 +1041,7 @@ int netlink_sendskb(struct sock *sk, struct sk_buff *skb)
 {
 	int len = skb->len;
 
-	skb_queue_tail(&sk->sk_receive_queue, skb);
-	sk->sk_data_ready(sk, len);
+	__netlink_sendskb(sk, skb);
 	sock_put(sk);
 	return len;
 }
@@ -937,8 +1166,7 @@ static inline int netlink_broadcast_deliver(struct sock *sk,
 	if (atomic_read(&sk->sk_rmem_alloc) <= sk->sk_rcvbuf &&
 	    !test_bit(0, &nlk->state)) {
 		skb_set_owner_r(skb, sk);
-		skb_queue_tail(&sk->sk_receive_queue, skb);
-		sk->sk_data_ready(sk, skb->len);
+		__netlink_sendskb(sk, skb);
 		return atomic_read(&sk->sk_rmem_alloc) > sk->sk_rcvbuf;
 	}
 	return -1;
@@ -978,6 +1206,22 @@ static inline int do_one_broadcast(struct sock *sk,
 	}
 
 	sock_hold(sk);
+	/* Without a socket filter the message can be copied into the
+	 * listener's ring right away; no clone is needed.
+	 */
+	if (netlink_rx_is_mmaped(sk) && !sk->sk_filter &&
+	    !security_sock_rcv_skb(sk, p->skb)) {
+		val = netlink_ring_broadcast(sk, p->skb);
+		if (val == 0) {
+			sk->sk_data_ready(sk, p->skb->len);
+			p->delivered = 1;
+			goto out_put;
+		}
+		if (val != -EMSGSIZE) {
+			netlink_overrun(sk);
+			goto out_put;
+		}
+	}
 	if (p->skb2 == NULL) {
 		if (skb_shared(p->skb)) {
 			p->skb2 = skb_clone(p->skb, p->allocation);
@@ -1004,6 +1248,7 @@ static inline int do_one_broadcast(struct sock *sk,
 		p->delivered = 1;
 		p->skb2 = NULL;
 	}
+out_put:
 	sock_put(sk);
 
 out:
@@ -1120,6 +1365,262 @@ static void netlink_update_socket_mc(struct netlink_sock *nlk,
 	netlink_update_listeners(&nlk->sk);
 }
 
+#ifndef CONFIG_NETLINK_MMAP
+#define netlink_mmap sock_no_mmap
+#define netlink_poll datagram_poll
+#else
+
+static void netlink_mm_open(struct vm_area_struct *vma)
+{
+	struct file *file = vma->vm_file;
+	struct socket *sock = file->private_data;
+	struct sock *sk = sock->sk;
+
+	if (sk)
+		atomic_inc(&nlk_sk(sk)->mapped);
+}
+
+static void netlink_mm_close(struct vm_area_struct *vma)
+{
+	struct file *file = vma->vm_file;
+	struct socket *sock = file->private_data;
+	struct sock *sk = sock->sk;
+
+	if (sk)
+		atomic_dec(&nlk_sk(sk)->mapped);
+}
+
+static struct vm_operations_struct netlink_mmap_ops = {
+	.open	= netlink_mm_open,
+	.close	= netlink_mm_close,
+};
+
+static void free_pg_vec(char **pg_vec, unsigned int order, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		if (likely(pg_vec[i]))
+			free_pages((unsigned long)pg_vec[i], order);
+	}
+	kfree(pg_vec);
+}
+
+static char **alloc_pg_vec(struct nl_mmap_req *req, unsigned int order)
+{
+	unsigned int block_nr = req->nm_block_nr;
+	char **pg_vec;
+	unsigned int i;
+
+	pg_vec = kzalloc(block_nr * sizeof(char *), GFP_KERNEL);
+	if (unlikely(!pg_vec))
+		return NULL;
+
+	for (i = 0; i < block_nr; i++) {
+		pg_vec[i] = (char *)__get_free_pages(GFP_KERNEL | __GFP_COMP |
+						     __GFP_ZERO, order);
+		if (unlikely(!pg_vec[i])) {
+			free_pg_vec(pg_vec, order, block_nr);
+			return NULL;
+		}
+	}
+	return pg_vec;
+}
+
+static int netlink_set_ring(struct sock *sk, struct nl_mmap_req *req,
+			    int closing, int tx_ring)
+{
+	struct netlink_sock *nlk = nlk_sk(sk);
+	struct netlink_ring *ring;
+	struct sk_buff_head *queue;
+	char **pg_vec = NULL;
+	unsigned int order = 0;
+	unsigned int frames_per_block = 0;
+	int err;
+
+	ring  = tx_ring ? &nlk->tx_ring : &nlk->rx_ring;
+	queue = tx_ring ? &sk->sk_write_queue : &sk->sk_receive_queue;
+
+	if (!closing) {
+		if (atomic_read(&nlk->mapped))
+			return -EBUSY;
+		if (ring->pg_vec && req->nm_block_nr)
+			return -EBUSY;
+	}
+
+	if (req->nm_block_nr) {
+		if ((int)req->nm_block_size <= 0)
+			return -EINVAL;
+		if (!IS_ALIGNED(req->nm_block_size, PAGE_SIZE))
+			return -EINVAL;
+		if (req->nm_frame_size < NL_MMAP_HDRLEN)
+			return -EINVAL;
+		if (!IS_ALIGNED(req->nm_frame_size, NL_MMAP_MSG_ALIGNMENT))
+			return -EINVAL;
+
+		frames_per_block = req->nm_block_size / req->nm_frame_size;
+		if (frames_per_block == 0)
+			return -EINVAL;
+		if (frames_per_block * req->nm_block_nr !=
+		    req->nm_frame_nr)
+			return -EINVAL;
+
+		order = get_order(req->nm_block_size);
+		pg_vec = alloc_pg_vec(req, order);
+		if (pg_vec == NULL)
+			return -ENOMEM;
+	} else {
+		if (req->nm_frame_nr)
+			return -EINVAL;
+	}
+
+	err = -EBUSY;
+	mutex_lock(&nlk->pg_vec_lock);
+	if (closing || atomic_read(&nlk->mapped) == 0) {
+		err = 0;
+#define XC(a, b) ({ __typeof__ ((a)) __t; __t = (a); (a) = (b); __t; })
+		spin_lock_bh(&queue->lock);
+
+		ring->frame_max		= req->nm_frame_nr - 1;
+		ring->head		= 0;
+		ring->frame_size	= req->nm_frame_size;
+		ring->frames_per_block	= frames_per_block;
+		ring->pg_vec_pages	= req->nm_block_size / PAGE_SIZE;
+
+		pg_vec = XC(ring->pg_vec, pg_vec);
+		order = XC(ring->pg_vec_order, order);
+		req->nm_block_nr = XC(ring->pg_vec_len, req->nm_block_nr);
+
+		__skb_queue_purge(queue);
+		spin_unlock_bh(&queue->lock);
+#undef XC
+		WARN_ON(atomic_read(&nlk->mapped));
+	}
+	mutex_unlock(&nlk->pg_vec_lock);
+
+	if (pg_vec)
+		free_pg_vec(pg_vec, order, req->nm_block_nr);
+	return err;
+}
+
+static int netlink_mmap(struct file *file, struct socket *sock,
+			struct vm_area_struct *vma)
+{
+	struct sock *sk = sock->sk;
+	struct netlink_sock *nlk = nlk_sk(sk);
+	struct netlink_ring *ring;
+	unsigned long start, size, expected;
+	unsigned int i;
+	int err = -EINVAL;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	mutex_lock(&nlk->pg_vec_lock);
+
+	expected = 0;
+	for (ring = &nlk->rx_ring; ring <= &nlk->tx_ring; ring++) {
+		if (ring->pg_vec == NULL)
+			continue;
+		expected += ring->pg_vec_len * ring->pg_vec_pages * PAGE_SIZE;
+	}
+
+	if (expected == 0)
+		goto out;
+
+	size = vma->vm_end - vma->vm_start;
+	if (size != expected)
+		goto out;
+
+	/* The RX ring is mapped first, followed by the TX ring. */
+	start = vma->vm_start;
+	for (ring = &nlk->rx_ring; ring <= &nlk->tx_ring; ring++) {
+		if (ring->pg_vec == NULL)
+			continue;
+
+		for (i = 0; i < ring->pg_vec_len; i++) {
+			struct page *page = virt_to_page(ring->pg_vec[i]);
+			unsigned int pg_num;
+
+			for (pg_num = 0; pg_num < ring->pg_vec_pages;
+			     pg_num++, page++) {
+				err = vm_insert_page(vma, start, page);
+				if (err < 0)
+					goto out;
+				start += PAGE_SIZE;
+			}
+		}
+	}
+
+	atomic_inc(&nlk->mapped);
+	vma->vm_ops = &netlink_mmap_ops;
+	err = 0;
+out:
+	mutex_unlock(&nlk->pg_vec_lock);
+	return err;
+}
+
+/*
+ * Memory mapped readers do not call recvmsg(), so dumps are continued
+ * from poll() instead, as long as at least half of the ring is free.
+ */
+static int netlink_dump_space(struct netlink_sock *nlk)
+{
+	struct netlink_ring *ring = &nlk->rx_ring;
+	unsigned int n;
+
+	if (!netlink_rx_has_room(&nlk->sk))
+		return 0;
+
+	n = ring->head + ring->frame_max / 2;
+	if (n > ring->frame_max)
+		n -= ring->frame_max + 1;
+
+	return netlink_lookup_frame(ring, n, NL_MMAP_STATUS_UNUSED) != NULL;
+}
+
+static unsigned int netlink_poll(struct file *file, struct socket *sock,
+				 poll_table *wait)
+{
+	struct sock *sk = sock->sk;
+	struct netlink_sock *nlk = nlk_sk(sk);
+	unsigned int mask;
+	int err;
+
+	if (nlk->rx_ring.pg_vec != NULL) {
+		while (nlk->cb != NULL && netlink_dump_space(nlk)) {
+			err = netlink_dump(sk);
+			if (err < 0) {
+				sk->sk_err = -err;
+				sk->sk_error_report(sk);
+				break;
+			}
+		}
+		netlink_rcv_wake(sk);
+	}
+
+	mask = datagram_poll(file, sock, wait);
+
+	spin_lock_bh(&sk->sk_receive_queue.lock);
+	if (nlk->rx_ring.pg_vec) {
+		if (!netlink_previous_frame(&nlk->rx_ring,
+					    NL_MMAP_STATUS_UNUSED))
+			mask |= POLLIN | POLLRDNORM;
+	}
+	spin_unlock_bh(&sk->sk_receive_queue.lock);
+
+	spin_lock_bh(&sk->sk_write_queue.lock);
+	if (nlk->tx_ring.pg_vec) {
+		if (netlink_current_frame(&nlk->tx_ring,
+					  NL_MMAP_STATUS_UNUSED))
+			mask |= POLLOUT | POLLWRNORM;
+	}
+	spin_unlock_bh(&sk->sk_write_queue.lock);
+
+	return mask;
+}
+#endif /* CONFIG_NETLINK_MMAP */
+
 static int netlink_setsockopt(struct socket *sock, int level, int optname,
 			      char __user *optval, int optlen)
 {
@@ -1159,6 +1660,25 @@ static int netlink_setsockopt(struct socket *sock, int level, int optname,
 		err = 0;
 		break;
 	}
+#ifdef CONFIG_NETLINK_MMAP
+	case NETLINK_RX_RING:
+	case NETLINK_TX_RING: {
+		struct nl_mmap_req req;
+
+		/* Rings might consume more memory than queue limits, require
+		 * CAP_NET_ADMIN.
+		 */
+		if (!capable(CAP_NET_ADMIN))
+			return -EPERM;
+		if (optlen < sizeof(req))
+			return -EINVAL;
+		if (copy_from_user(&req, optval, sizeof(req)))
+			return -EFAULT;
+		err = netlink_set_ring(sk, &req, 0,
+				       optname == NETLINK_TX_RING);
+		break;
+	}
+#endif /* CONFIG_NETLINK_MMAP */
 	default:
 		err = -ENOPROTOOPT;
 	}
@@ -1205,6 +1725,82 @@ static void netlink_cmsg_recv_pktinfo(struct msghdr *msg, struct sk_buff *skb)
 	put_cmsg(msg, SOL_NETLINK, NETLINK_PKTINFO, sizeof(info), &info);
 }
 
+#ifdef CONFIG_NETLINK_MMAP
+/*
+ * Send all messages user space marked valid in the TX ring.  Each one is
+ * copied out of the ring before it is looked at, so user space cannot
+ * change it underneath the receiver.
+ */
+static int netlink_mmap_sendmsg(struct sock *sk, struct msghdr *msg,
+				u32 dst_pid, u32 dst_group,
+				struct sock_iocb *siocb)
+{
+	struct netlink_sock *nlk = nlk_sk(sk);
+	struct netlink_ring *ring = &nlk->tx_ring;
+	struct nl_mmap_hdr *hdr;
+	struct sk_buff *skb;
+	unsigned int maxlen, len;
+	int err = 0, sent = 0;
+
+	mutex_lock(&nlk->pg_vec_lock);
+	maxlen = ring->frame_size - NL_MMAP_HDRLEN;
+
+	for (;;) {
+		spin_lock_bh(&sk->sk_write_queue.lock);
+		hdr = netlink_current_frame(ring, NL_MMAP_STATUS_VALID);
+		spin_unlock_bh(&sk->sk_write_queue.lock);
+		if (hdr == NULL)
+			break;
+
+		len = ACCESS_ONCE(hdr->nm_len);
+		if (len > maxlen || len > sk->sk_sndbuf - 32) {
+			err = -EINVAL;
+			break;
+		}
+
+		skb = alloc_skb(len, GFP_KERNEL);
+		if (skb == NULL) {
+			err = -ENOBUFS;
+			break;
+		}
+		memcpy(skb_put(skb, len), (void *)hdr + NL_MMAP_HDRLEN, len);
+
+		spin_lock_bh(&sk->sk_write_queue.lock);
+		netlink_set_status(hdr, NL_MMAP_STATUS_UNUSED);
+		netlink_increment_head(ring);
+		spin_unlock_bh(&sk->sk_write_queue.lock);
+
+		NETLINK_CB(skb).pid	= nlk->pid;
+		NETLINK_CB(skb).dst_group = dst_group;
+		NETLINK_CB(skb).loginuid = audit_get_loginuid(current);
+		NETLINK_CB(skb).sessionid = audit_get_sessionid(current);
+		security_task_getsecid(current, &(NETLINK_CB(skb).sid));
+		memcpy(NETLINK_CREDS(skb), &siocb->scm->creds,
+		       sizeof(struct ucred));
+
+		err = security_netlink_send(sk, skb);
+		if (err) {
+			kfree_skb(skb);
+			break;
+		}
+
+		if (dst_group) {
+			atomic_inc(&skb->users);
+			netlink_broadcast(sk, skb, dst_pid, dst_group,
+					  GFP_KERNEL);
+		}
+		err = netlink_unicast(sk, skb, dst_pid,
+				      msg->msg_flags & MSG_DONTWAIT);
+		if (err < 0)
+			break;
+		sent += err;
+	}
+
+	mutex_unlock(&nlk->pg_vec_lock);
+	return sent ? : err;
+}
+#endif /* CONFIG_NETLINK_MMAP */
+
 static int netlink_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			   struct msghdr *msg, size_t len)
 {
@@ -1245,6 +1841,16 @@ static int netlink_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			goto out;
 	}
 
+#ifdef CONFIG_NETLINK_MMAP
+	/* A NULL buffer flushes the TX ring. */
+	if (netlink_tx_is_mmaped(sk) &&
+	    (msg->msg_iovlen == 0 || msg->msg_iov->iov_base == NULL)) {
+		err = netlink_mmap_sendmsg(sk, msg, dst_pid, dst_group,
+					   siocb);
+		goto out;
+	}
+#endif
+
 	err = -EMSGSIZE;
 	if (len > sk->sk_sndbuf - 32)
 		goto out;
@@ -1342,7 +1948,8 @@ static int netlink_recvmsg(struct kiocb *kiocb, struct socket *sock,
 		copied = skb->len;
 	skb_free_datagram(sk, skb);
 
-	if (nlk->cb && atomic_read(&sk->sk_rmem_alloc) <= sk->sk_rcvbuf / 2)
+	if (nlk->cb && (netlink_rx_is_mmaped(sk) ||
+			atomic_read(&sk->sk_rmem_alloc) <= sk->sk_rcvbuf / 2))
 		netlink_dump(sk);
 
 	scm_recv(sock, msg, siocb->scm, flags);
@@ -1535,6 +2142,9 @@ static int netlink_dump(struct sock *sk)
 	struct nlmsghdr *nlh;
 	int len, err = -ENOBUFS;
 
+	if (netlink_rx_is_mmaped(sk) && !netlink_rx_has_room(sk))
+		return 0;
+
 	skb = sock_rmalloc(sk, NLMSG_GOODSIZE, 0, GFP_KERNEL);
 	if (!skb)
 		goto errout;
@@ -1554,10 +2164,8 @@ static int netlink_dump(struct sock *sk)
 
 		if (sk_filter(sk, skb))
 			kfree_skb(skb);
-		else {
-			skb_queue_tail(&sk->sk_receive_queue, skb);
-			sk->sk_data_ready(sk, skb->len);
-		}
+		else
+			__netlink_sendskb(sk, skb);
 		return 0;
 	}
 
@@ -1569,10 +2177,8 @@ static int netlink_dump(struct sock *sk)
 
 	if (sk_filter(sk, skb))
 		kfree_skb(skb);
-	else {
-		skb_queue_tail(&sk->sk_receive_queue, skb);
-		sk->sk_data_ready(sk, skb->len);
-	}
+	else
+		__netlink_sendskb(sk, skb);
 
 	if (cb->done)
 		cb->done(cb);
@@ -1906,7 +2512,7 @@ static const struct proto_ops netlink_ops = {
 	.socketpair =	sock_no_socketpair,
 	.accept =	sock_no_accept,
 	.getname =	netlink_getname,
-	.poll =		datagram_poll,
+	.poll =		netlink_poll,
 	.ioctl =	sock_no_ioctl,
 	.listen =	sock_no_listen,
 	.shutdown =	sock_no_shutdown,
@@ -1914,7 +2520,7 @@ static const struct proto_ops netlink_ops = {
 	.getsockopt =	netlink_getsockopt,
 	.sendmsg =	netlink_sendmsg,
 	.recvmsg =	netlink_recvmsg,
-	.mmap =		sock_no_mmap,
+	.mmap =		netlink_mmap,
 	.sendpage =	sock_no_sendpage,
 };
 
@@ -94,6 +94,7 @@
 #include <net/wext.h>
 
 #include <net/sock.h>
+#include <net/busy_poll.h>
 #include <linux/netfilter.h>
 
 static int sock_no_open(struct inode *irrelevant, struct file *dontcare);
@@ -968,6 +969,17 @@ static unsigned int sock_poll(struct file *file, poll_table *wait)
 	 *      We can't return errors to poll, so it's either yes or no.
 	 */
 	sock = file->private_data;
+
+	/*
+	 * Only the first pass of poll()/select() passes a wait table, and
+	 * only while no descriptor is ready yet: spin there, before the
+	 * caller goes to sleep.
+	 */
+	if (wait && net_busy_loop_on() && sock->sk &&
+	    sk_can_busy_loop(sock->sk) &&
+	    skb_queue_empty(&sock->sk->sk_receive_queue))
+		sk_busy_loop_poll(sock->sk);
+
 	return sock->ops->poll(file, sock, wait);
 }
 
@@ -112,6 +112,7 @@
 #include <linux/poll.h>
 #include <linux/rtnetlink.h>
 #include <linux/mount.h>
+#include <linux/splice.h>
 #include <net/checksum.h>
 #include <linux/security.h>
 
@@ -503,6 +504,14 @@ static int unix_dgram_connect(struct socket *, struct sockaddr *,
 			      int, int);
 static int unix_seqpacket_sendmsg(struct kiocb *, struct socket *,
 				  struct msghdr *, size_t);
+static ssize_t unix_stream_sendpage(struct socket *, struct page *, int,
+				    size_t, int);
+static ssize_t unix_stream_splice_read(struct socket *, loff_t *,
+				       struct pipe_inode_info *, size_t,
+				       unsigned int);
+static ssize_t unix_dgram_splice_read(struct socket *, loff_t *,
+				      struct pipe_inode_info *, size_t,
+				      unsigned int);
 
 static const struct proto_ops unix_stream_ops = {
 	.family =	PF_UNIX,
@@ -522,7 +531,8 @@ static const struct proto_ops unix_stream_ops = {
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
-	.sendpage =	sock_no_sendpage,
+	.sendpage =	unix_stream_sendpage,
+	.splice_read =	unix_stream_splice_read,
 };
 
 static const struct proto_ops unix_dgram_ops = {
@@ -544,6 +554,7 @@ static const struct proto_ops unix_dgram_ops = {
 	.recvmsg =	unix_dgram_recvmsg,
 	.mmap =		sock_no_mmap,
 	.sendpage =	sock_no_sendpage,
+	.splice_read =	unix_dgram_splice_read,
 };
 
 static const struct proto_ops unix_seqpacket_ops = {
@@ -565,6 +576,7 @@ static const struct proto_ops unix_seqpacket_ops = {
 	.recvmsg =	unix_dgram_recvmsg,
 	.mmap =		sock_no_mmap,
 	.sendpage =	sock_no_sendpage,
+	.splice_read =	unix_dgram_splice_read,
 };
 
 static struct proto unix_proto = {
@@ -1607,6 +1619,72 @@ out_err:
 	return sent ? : err;
 }
 
+/*
+ *	Queue a page (from splice or sendfile) to the peer as a fragment
+ *	of a new skb, instead of copying it in like unix_stream_sendmsg.
+ */
+static ssize_t unix_stream_sendpage(struct socket *sock, struct page *page,
+				    int offset, size_t size, int flags)
+{
+	struct sock *sk = sock->sk;
+	struct msghdr msg = { .msg_flags = flags };
+	struct scm_cookie scm;
+	struct sock *other;
+	struct sk_buff *skb;
+	int err;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+
+	other = unix_peer(sk);
+	if (!other || sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+
+	if (sk->sk_shutdown & SEND_SHUTDOWN)
+		goto pipe_err;
+
+	err = scm_send(sock, &msg, &scm);
+	if (err < 0)
+		return err;
+
+	skb = sock_alloc_send_skb(sk, 0, flags & MSG_DONTWAIT, &err);
+	if (skb == NULL)
+		goto out_err;
+
+	memcpy(UNIXCREDS(skb), &scm.creds, sizeof(struct ucred));
+
+	get_page(page);
+	skb_fill_page_desc(skb, 0, page, offset, size);
+	skb->len = size;
+	skb->data_len = size;
+	skb->truesize += size;
+	atomic_add(size, &sk->sk_wmem_alloc);
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		kfree_skb(skb);
+		scm_destroy(&scm);
+		goto pipe_err;
+	}
+
+	skb_queue_tail(&other->sk_receive_queue, skb);
+	unix_state_unlock(other);
+	other->sk_data_ready(other, size);
+	scm_destroy(&scm);
+	return size;
+
+pipe_err:
+	if (!(flags & MSG_NOSIGNAL))
+		send_sig(SIGPIPE, current, 0);
+	return -EPIPE;
+out_err:
+	scm_destroy(&scm);
+	return err;
+}
+
 static int unix_seqpacket_sendmsg(struct kiocb *kiocb, struct socket *sock,
 				  struct msghdr *msg, size_t len)
 {
@@ -1720,6 +1798,71 @@ out:
 	return err;
 }
 
+/* Like read(), splice does not block on a socket opened O_NONBLOCK. */
+static int unix_splice_nonblock(struct socket *sock, unsigned int flags)
+{
+	return (flags & SPLICE_F_NONBLOCK) ||
+	       (sock->file->f_flags & O_NONBLOCK);
+}
+
+/*
+ *	Splice one datagram into a pipe.  As with recvmsg() anything beyond
+ *	@size is discarded, and so are any passed descriptors.
+ */
+static ssize_t unix_dgram_splice_read(struct socket *sock, loff_t *ppos,
+				      struct pipe_inode_info *pipe,
+				      size_t size, unsigned int flags)
+{
+	struct sock *sk = sock->sk;
+	struct unix_sock *u = unix_sk(sk);
+	struct scm_cookie scm;
+	struct sk_buff *skb;
+	int err;
+
+	if (unlikely(*ppos))
+		return -ESPIPE;
+
+	mutex_lock(&u->readlock);
+
+	skb = skb_recv_datagram(sk, 0, unix_splice_nonblock(sock, flags), &err);
+	if (!skb) {
+		unix_state_lock(sk);
+		/* Signal EOF on disconnected non-blocking SEQPACKET socket. */
+		if (sk->sk_type == SOCK_SEQPACKET && err == -EAGAIN &&
+		    (sk->sk_shutdown & RCV_SHUTDOWN))
+			err = 0;
+		unix_state_unlock(sk);
+		goto out_unlock;
+	}
+
+	if (size > skb->len)
+		size = skb->len;
+
+	err = skb_splice_bits(skb, NULL, 0, pipe, size, flags);
+	if (size && err <= 0) {
+		/* The pipe is full: keep the datagram for the next read */
+		skb_queue_head(&sk->sk_receive_queue, skb);
+		goto out_unlock;
+	}
+
+	wake_up_interruptible_sync(&u->peer_wait);
+
+	if (UNIXCB(skb).fp) {
+		unix_detach_fds(&scm, skb);
+		scm_destroy(&scm);
+	}
+	skb_free_datagram(sk, skb);
+out_unlock:
+	mutex_unlock(&u->readlock);
+	return err;
+}
+
+/* Bytes of a stream skb not yet read */
+static inline unsigned int unix_skb_len(const struct sk_buff *skb)
+{
+	return skb->len - UNIXCB(skb).consumed;
+}
+
 /*
  *	Sleep until data has arrive. But check for races..
  */
@@ -1852,8 +1995,9 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			sunaddr = NULL;
 		}
 
-		chunk = min_t(unsigned int, skb->len, size);
-		if (memcpy_toiovec(msg->msg_iov, skb->data, chunk)) {
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		if (skb_copy_datagram_iovec(skb, UNIXCB(skb).consumed,
+					    msg->msg_iov, chunk)) {
 			skb_queue_head(&sk->sk_receive_queue, skb);
 			if (copied == 0)
 				copied = -EFAULT;
@@ -1864,13 +2008,13 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 		/* Mark read part of skb as used */
 		if (!(flags & MSG_PEEK)) {
-			skb_pull(skb, chunk);
+			UNIXCB(skb).consumed += chunk;
 
 			if (UNIXCB(skb).fp)
 				unix_detach_fds(siocb->scm, skb);
 
 			/* put the skb back if we didn't use it up.. */
-			if (skb->len) {
+			if (unix_skb_len(skb)) {
 				skb_queue_head(&sk->sk_receive_queue, skb);
 				break;
 			}
@@ -1897,6 +2041,101 @@ out:
 	return copied ? : err;
 }
 
+/*
+ *	Splice stream data into a pipe.  Page fragments queued by
+ *	unix_stream_sendpage() are passed on without a copy.
+ */
+static ssize_t unix_stream_splice_read(struct socket *sock, loff_t *ppos,
+				       struct pipe_inode_info *pipe,
+				       size_t size, unsigned int flags)
+{
+	struct sock *sk = sock->sk;
+	struct unix_sock *u = unix_sk(sk);
+	struct scm_cookie scm;
+	ssize_t spliced = 0;
+	int err = 0;
+	long timeo;
+
+	if (unlikely(*ppos))
+		return -ESPIPE;
+
+	if (sk->sk_state != TCP_ESTABLISHED)
+		return -EINVAL;
+
+	timeo = sock_rcvtimeo(sk, unix_splice_nonblock(sock, flags));
+
+	mutex_lock(&u->readlock);
+
+	while (size) {
+		struct sk_buff *skb;
+		int chunk;
+
+		unix_state_lock(sk);
+		skb = skb_dequeue(&sk->sk_receive_queue);
+		if (skb == NULL) {
+			if (spliced)
+				goto unlock;
+
+			err = sock_error(sk);
+			if (err)
+				goto unlock;
+			if (sk->sk_shutdown & RCV_SHUTDOWN)
+				goto unlock;
+
+			unix_state_unlock(sk);
+			err = -EAGAIN;
+			if (!timeo)
+				break;
+			mutex_unlock(&u->readlock);
+
+			timeo = unix_stream_data_wait(sk, timeo);
+
+			if (signal_pending(current)) {
+				err = sock_intr_errno(timeo);
+				goto out;
+			}
+			mutex_lock(&u->readlock);
+			continue;
+ unlock:
+			unix_state_unlock(sk);
+			break;
+		}
+		unix_state_unlock(sk);
+
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		chunk = skb_splice_bits(skb, NULL, UNIXCB(skb).consumed,
+					pipe, chunk, flags);
+		if (chunk <= 0) {
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			if (!spliced)
+				err = chunk;
+			break;
+		}
+		spliced += chunk;
+		size -= chunk;
+
+		UNIXCB(skb).consumed += chunk;
+
+		/* Descriptors cannot be passed through a pipe */
+		if (UNIXCB(skb).fp) {
+			unix_detach_fds(&scm, skb);
+			scm_destroy(&scm);
+		}
+
+		/* put the skb back if we didn't use it up.. */
+		if (unix_skb_len(skb)) {
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			break;
+		}
+
+		kfree_skb(skb);
+	}
+
+	mutex_unlock(&u->readlock);
+out:
+	return spliced ? : err;
+}
+
 static int unix_shutdown(struct socket *sock, int mode)
 {
 	struct sock *sk = sock->sk;
@@ -1963,7 +2202,7 @@ static int unix_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			if (sk->sk_type == SOCK_STREAM ||
 			    sk->sk_type == SOCK_SEQPACKET) {
 				skb_queue_walk(&sk->sk_receive_queue, skb)
-					amount += skb->len;
+					amount += unix_skb_len(skb);
 			} else {
 				skb = skb_peek(&sk->sk_receive_queue);
 				if (skb)
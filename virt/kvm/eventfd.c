@@ -0,0 +1,514 @@
+/*
+ * kvm eventfd support - use eventfd objects to signal various KVM events
+ *
+ * irqfd: an eventfd whose signal injects an interrupt into the guest,
+ * without a KVM_IRQ_LINE ioctl from the device model.
+ *
+ * ioeventfd: a guest PIO/MMIO write to a registered address signals an
+ * eventfd instead of exiting to userspace.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "iodev.h"
+#include "irq.h"
+
+#include <linux/kvm_host.h>
+#include <linux/kvm.h>
+#include <linux/workqueue.h>
+#include <linux/eventfd.h>
+#include <linux/file.h>
+#include <linux/poll.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+
+/*
+ * --------------------------------------------------------------------
+ * irqfd: Allows an fd to be used to inject an interrupt to the guest
+ *
+ * The eventfd wakeup runs with the eventfd wait queue lock held, so the
+ * injection itself (which needs kvm->lock) is deferred to a work item.
+ * --------------------------------------------------------------------
+ */
+
+struct _irqfd {
+	struct kvm               *kvm;
+	u32                       gsi;
+	struct list_head          list;
+	poll_table                pt;
+	wait_queue_head_t        *wqh;
+	wait_queue_t              wait;
+	struct work_struct        inject;
+	struct file              *file;
+};
+
+static void
+irqfd_inject(struct work_struct *work)
+{
+	struct _irqfd *irqfd = container_of(work, struct _irqfd, inject);
+	struct kvm *kvm = irqfd->kvm;
+
+	mutex_lock(&kvm->lock);
+	kvm_set_irq(kvm, KVM_USERSPACE_IRQ_SOURCE_ID, irqfd->gsi, 1);
+	kvm_set_irq(kvm, KVM_USERSPACE_IRQ_SOURCE_ID, irqfd->gsi, 0);
+	mutex_unlock(&kvm->lock);
+}
+
+static int
+irqfd_wakeup(wait_queue_t *wait, unsigned mode, int sync, void *key)
+{
+	struct _irqfd *irqfd = container_of(wait, struct _irqfd, wait);
+
+	/*
+	 * The eventfd counter is never consumed by us: the interrupt is
+	 * edge-like and only reflects that a signal happened.
+	 */
+	schedule_work(&irqfd->inject);
+
+	return 0;
+}
+
+static void
+irqfd_ptable_queue_proc(struct file *file, wait_queue_head_t *wqh,
+			poll_table *pt)
+{
+	struct _irqfd *irqfd = container_of(pt, struct _irqfd, pt);
+
+	irqfd->wqh = wqh;
+	add_wait_queue(wqh, &irqfd->wait);
+}
+
+static int
+kvm_irqfd_assign(struct kvm *kvm, int fd, u32 gsi)
+{
+	struct _irqfd *irqfd;
+	struct file *file = NULL;
+	unsigned int events;
+	int ret;
+
+	/* irqfd_inject() feeds the gsi straight to the in-kernel irqchip */
+	if (!irqchip_in_kernel(kvm))
+		return -ENODEV;
+	if (gsi >= KVM_IOAPIC_NUM_PINS)
+		return -EINVAL;
+
+	irqfd = kzalloc(sizeof(*irqfd), GFP_KERNEL);
+	if (!irqfd)
+		return -ENOMEM;
+
+	irqfd->kvm = kvm;
+	irqfd->gsi = gsi;
+	INIT_LIST_HEAD(&irqfd->list);
+	INIT_WORK(&irqfd->inject, irqfd_inject);
+
+	file = eventfd_fget(fd);
+	if (IS_ERR(file)) {
+		ret = PTR_ERR(file);
+		goto fail;
+	}
+	irqfd->file = file;
+
+	/*
+	 * Install our own custom wake-up handling so we are notified via
+	 * a callback whenever someone signals the underlying eventfd
+	 */
+	init_waitqueue_func_entry(&irqfd->wait, irqfd_wakeup);
+	init_poll_funcptr(&irqfd->pt, irqfd_ptable_queue_proc);
+
+	events = file->f_op->poll(file, &irqfd->pt);
+
+	mutex_lock(&kvm->lock);
+	list_add_tail(&irqfd->list, &kvm->irqfds);
+	mutex_unlock(&kvm->lock);
+
+	/*
+	 * Check if there was an event already pending on the eventfd
+	 * before we registered, and trigger it as if we didn't miss it.
+	 */
+	if (events & POLLIN)
+		schedule_work(&irqfd->inject);
+
+	return 0;
+
+fail:
+	kfree(irqfd);
+	return ret;
+}
+
+/*
+ * Detach from the eventfd and wait for a pending injection to finish.
+ * Must be called without kvm->lock, which the injection work takes.
+ */
+static void
+irqfd_release(struct _irqfd *irqfd)
+{
+	remove_wait_queue(irqfd->wqh, &irqfd->wait);
+	flush_work(&irqfd->inject);
+	fput(irqfd->file);
+	kfree(irqfd);
+}
+
+static int
+kvm_irqfd_deassign(struct kvm *kvm, int fd, u32 gsi)
+{
+	struct _irqfd *irqfd, *tmp;
+	struct file *file;
+	LIST_HEAD(dead);
+
+	file = eventfd_fget(fd);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	mutex_lock(&kvm->lock);
+	list_for_each_entry_safe(irqfd, tmp, &kvm->irqfds, list)
+		if (irqfd->file == file && irqfd->gsi == gsi)
+			list_move(&irqfd->list, &dead);
+	mutex_unlock(&kvm->lock);
+
+	fput(file);
+
+	if (list_empty(&dead))
+		return -ENOENT;
+
+	list_for_each_entry_safe(irqfd, tmp, &dead, list)
+		irqfd_release(irqfd);
+
+	return 0;
+}
+
+int
+kvm_irqfd(struct kvm *kvm, int fd, u32 gsi, int flags)
+{
+	if (flags & ~KVM_IRQFD_FLAG_DEASSIGN)
+		return -EINVAL;
+
+	if (flags & KVM_IRQFD_FLAG_DEASSIGN)
+		return kvm_irqfd_deassign(kvm, fd, gsi);
+
+	return kvm_irqfd_assign(kvm, fd, gsi);
+}
+
+/*
+ * --------------------------------------------------------------------
+ * ioeventfd: translate a PIO/MMIO memory write to an eventfd signal.
+ *
+ * One kvm_io_device per bus fronts all registered ioeventfds, so they
+ * do not use up the (small) fixed number of bus slots.  in_range() and
+ * write() are called from the PIO and MMIO emulation paths, some of them
+ * without kvm->lock, so they walk the list of ioeventfds under RCU;
+ * kvm->lock serializes the updates.
+ * --------------------------------------------------------------------
+ */
+
+struct _ioeventfd {
+	struct list_head     list;
+	u64                  addr;
+	int                  length;
+	struct file         *file;
+	u64                  datamatch;
+	bool                 wildcard;
+	bool                 pio;
+};
+
+struct kvm_ioeventfd_dev {
+	struct kvm_io_device dev;
+	struct kvm          *kvm;
+	bool                 pio;
+};
+
+static u64
+ioeventfd_value(int len, const void *val)
+{
+	switch (len) {
+	case 1:
+		return *(u8 *)val;
+	case 2:
+		return *(u16 *)val;
+	case 4:
+		return *(u32 *)val;
+	case 8:
+		return *(u64 *)val;
+	}
+	return 0;
+}
+
+static int
+ioeventfd_in_range(struct kvm_io_device *this, gpa_t addr, int len,
+		   int is_write)
+{
+	struct kvm_ioeventfd_dev *dev = this->private;
+	struct _ioeventfd *p;
+	int ret = 0;
+
+	if (!is_write)
+		return 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(p, &dev->kvm->ioeventfds, list)
+		if (p->pio == dev->pio && p->addr == addr && p->length == len) {
+			ret = 1;
+			break;
+		}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static bool
+ioeventfd_match(struct _ioeventfd *p, bool pio, gpa_t addr, int len, u64 data)
+{
+	if (p->pio != pio || p->addr != addr || p->length != len)
+		return false;
+	return p->wildcard || p->datamatch == data;
+}
+
+/*
+ * in_range() cannot see the value written, so a write of a value that
+ * no datamatch ioeventfd wants is refused here and exits to userspace.
+ */
+static int
+ioeventfd_accepts_write(struct kvm_io_device *this, gpa_t addr, int len,
+			const void *val)
+{
+	struct kvm_ioeventfd_dev *dev = this->private;
+	struct _ioeventfd *p;
+	u64 data = ioeventfd_value(len, val);
+	int ret = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(p, &dev->kvm->ioeventfds, list)
+		if (ioeventfd_match(p, dev->pio, addr, len, data)) {
+			ret = 1;
+			break;
+		}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static void
+ioeventfd_write(struct kvm_io_device *this, gpa_t addr, int len,
+		const void *val)
+{
+	struct kvm_ioeventfd_dev *dev = this->private;
+	struct _ioeventfd *p;
+	u64 data = ioeventfd_value(len, val);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(p, &dev->kvm->ioeventfds, list)
+		if (ioeventfd_match(p, dev->pio, addr, len, data))
+			eventfd_signal(p->file, 1);
+	rcu_read_unlock();
+}
+
+static void
+ioeventfd_destructor(struct kvm_io_device *this)
+{
+	kfree(this->private);
+}
+
+static int
+ioeventfd_dev_init(struct kvm *kvm, struct kvm_io_bus *bus, bool pio)
+{
+	struct kvm_ioeventfd_dev *dev;
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return -ENOMEM;
+	dev->dev.write = ioeventfd_write;
+	dev->dev.in_range = ioeventfd_in_range;
+	dev->dev.accepts_write = ioeventfd_accepts_write;
+	dev->dev.destructor = ioeventfd_destructor;
+	dev->dev.private = dev;
+	dev->kvm = kvm;
+	dev->pio = pio;
+	kvm_io_bus_register_dev(bus, &dev->dev);
+
+	return 0;
+}
+
+/* assumes kvm->lock held */
+static bool
+ioeventfd_check_collision(struct kvm *kvm, struct _ioeventfd *p)
+{
+	struct _ioeventfd *_p;
+
+	list_for_each_entry(_p, &kvm->ioeventfds, list)
+		if (_p->pio == p->pio && _p->addr == p->addr &&
+		    _p->length == p->length &&
+		    (_p->wildcard || p->wildcard ||
+		     _p->datamatch == p->datamatch))
+			return true;
+
+	return false;
+}
+
+static int
+kvm_assign_ioeventfd(struct kvm *kvm, struct kvm_ioeventfd *args)
+{
+	struct _ioeventfd *p;
+	struct file *file;
+	int ret;
+
+	/* must be natural-word sized */
+	switch (args->len) {
+	case 1:
+	case 2:
+	case 4:
+	case 8:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* check for range overflow */
+	if (args->addr + args->len < args->addr)
+		return -EINVAL;
+
+	file = eventfd_fget(args->fd);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+
+	INIT_LIST_HEAD(&p->list);
+	p->addr   = args->addr;
+	p->length = args->len;
+	p->file   = file;
+	p->pio    = !!(args->flags & KVM_IOEVENTFD_FLAG_PIO);
+
+	/* The datamatch feature is optional, otherwise this is a wildcard */
+	if (args->flags & KVM_IOEVENTFD_FLAG_DATAMATCH)
+		p->datamatch = args->datamatch;
+	else
+		p->wildcard = true;
+
+	mutex_lock(&kvm->lock);
+
+	if (ioeventfd_check_collision(kvm, p)) {
+		mutex_unlock(&kvm->lock);
+		ret = -EEXIST;
+		goto fail;
+	}
+
+	list_add_tail_rcu(&p->list, &kvm->ioeventfds);
+
+	mutex_unlock(&kvm->lock);
+
+	return 0;
+
+fail:
+	kfree(p);
+	fput(file);
+	return ret;
+}
+
+static int
+kvm_deassign_ioeventfd(struct kvm *kvm, struct kvm_ioeventfd *args)
+{
+	struct _ioeventfd *p, *tmp;
+	struct file *file;
+	bool pio = !!(args->flags & KVM_IOEVENTFD_FLAG_PIO);
+	bool wildcard = !(args->flags & KVM_IOEVENTFD_FLAG_DATAMATCH);
+	int ret = -ENOENT;
+
+	file = eventfd_fget(args->fd);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	mutex_lock(&kvm->lock);
+
+	list_for_each_entry_safe(p, tmp, &kvm->ioeventfds, list) {
+		if (p->file != file || p->pio != pio ||
+		    p->addr != args->addr || p->length != args->len ||
+		    p->wildcard != wildcard)
+			continue;
+
+		if (!p->wildcard && p->datamatch != args->datamatch)
+			continue;
+
+		list_del_rcu(&p->list);
+		ret = 0;
+		break;
+	}
+
+	mutex_unlock(&kvm->lock);
+
+	fput(file);
+
+	if (ret)
+		return ret;
+
+	/* wait for the lookups that may still see it */
+	synchronize_rcu();
+	fput(p->file);
+	kfree(p);
+
+	return 0;
+}
+
+int
+kvm_ioeventfd(struct kvm *kvm, struct kvm_ioeventfd *args)
+{
+	if (args->flags & ~(KVM_IOEVENTFD_FLAG_DATAMATCH |
+			    KVM_IOEVENTFD_FLAG_PIO |
+			    KVM_IOEVENTFD_FLAG_DEASSIGN))
+		return -EINVAL;
+
+	if (args->flags & KVM_IOEVENTFD_FLAG_DEASSIGN)
+		return kvm_deassign_ioeventfd(kvm, args);
+
+	return kvm_assign_ioeventfd(kvm, args);
+}
+
+int
+kvm_eventfd_init(struct kvm *kvm)
+{
+	int ret;
+
+	INIT_LIST_HEAD(&kvm->irqfds);
+	INIT_LIST_HEAD(&kvm->ioeventfds);
+
+	ret = ioeventfd_dev_init(kvm, &kvm->mmio_bus, false);
+	if (ret)
+		return ret;
+
+	return ioeventfd_dev_init(kvm, &kvm->pio_bus, true);
+}
+
+/*
+ * Called on VM teardown, when no vcpu can access the buses any more.
+ * The per-bus devices themselves are freed by kvm_io_bus_destroy().
+ */
+void
+kvm_eventfd_release(struct kvm *kvm)
+{
+	struct _irqfd *irqfd, *itmp;
+	struct _ioeventfd *p, *ptmp;
+
+	list_for_each_entry_safe(irqfd, itmp, &kvm->irqfds, list) {
+		list_del(&irqfd->list);
+		irqfd_release(irqfd);
+	}
+
+	list_for_each_entry_safe(p, ptmp, &kvm->ioeventfds, list) {
+		list_del(&p->list);
+		fput(p->file);
+		kfree(p);
+	}
+}
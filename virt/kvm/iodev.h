@@ -29,6 +29,9 @@ struct kvm_io_device {
 		      const void *val);
 	int (*in_range)(struct kvm_io_device *this, gpa_t addr, int len,
 			int is_write);
+	/* optional: may refuse a write in range, which then goes to userspace */
+	int (*accepts_write)(struct kvm_io_device *this, gpa_t addr, int len,
+			     const void *val);
 	void (*destructor)(struct kvm_io_device *this);
 
 	void             *private;
@@ -56,6 +59,13 @@ static inline int kvm_iodevice_inrange(struct kvm_io_device *dev,
 	return dev->in_range(dev, addr, len, is_write);
 }
 
+static inline int kvm_iodevice_accepts_write(struct kvm_io_device *dev,
+					     gpa_t addr, int len,
+					     const void *val)
+{
+	return dev->accepts_write ? dev->accepts_write(dev, addr, len, val) : 1;
+}
+
 static inline void kvm_iodevice_destructor(struct kvm_io_device *dev)
 {
 	if (dev->destructor)
@@ -803,6 +803,9 @@ static struct kvm *kvm_create_vm(void)
 #ifdef KVM_COALESCED_MMIO_PAGE_OFFSET
 	struct page *page;
 #endif
+#ifdef KVM_CAP_IRQFD
+	int r;
+#endif
 
 	if (IS_ERR(kvm))
 		goto out;
@@ -840,12 +843,28 @@ static struct kvm *kvm_create_vm(void)
 	kvm_io_bus_init(&kvm->mmio_bus);
 	init_rwsem(&kvm->slots_lock);
 	atomic_set(&kvm->users_count, 1);
-	spin_lock(&kvm_lock);
-	list_add(&kvm->vm_list, &vm_list);
-	spin_unlock(&kvm_lock);
 #ifdef KVM_COALESCED_MMIO_PAGE_OFFSET
 	kvm_coalesced_mmio_init(kvm);
 #endif
+#ifdef KVM_CAP_IRQFD
+	r = kvm_eventfd_init(kvm);
+	if (r) {
+		kvm_io_bus_destroy(&kvm->pio_bus);
+		kvm_io_bus_destroy(&kvm->mmio_bus);
+#if defined(CONFIG_MMU_NOTIFIER) && defined(KVM_ARCH_WANT_MMU_NOTIFIER)
+		mmu_notifier_unregister(&kvm->mmu_notifier, kvm->mm);
+#endif
+		mmdrop(kvm->mm);
+#ifdef KVM_COALESCED_MMIO_PAGE_OFFSET
+		put_page(page);
+#endif
+		kfree(kvm);
+		return ERR_PTR(r);
+	}
+#endif
+	spin_lock(&kvm_lock);
+	list_add(&kvm->vm_list, &vm_list);
+	spin_unlock(&kvm_lock);
 out:
 	return kvm;
 }
@@ -886,6 +905,9 @@ static void kvm_destroy_vm(struct kvm *kvm)
 	spin_lock(&kvm_lock);
 	list_del(&kvm->vm_list);
 	spin_unlock(&kvm_lock);
+#ifdef KVM_CAP_IRQFD
+	kvm_eventfd_release(kvm);
+#endif
 	kvm_io_bus_destroy(&kvm->pio_bus);
 	kvm_io_bus_destroy(&kvm->mmio_bus);
 #ifdef KVM_COALESCED_MMIO_PAGE_OFFSET
@@ -1905,6 +1927,26 @@ static long kvm_vm_ioctl(struct file *filp,
 			goto out;
 		break;
 	}
+#endif
+#ifdef KVM_CAP_IRQFD
+	case KVM_IRQFD: {
+		struct kvm_irqfd data;
+
+		r = -EFAULT;
+		if (copy_from_user(&data, argp, sizeof data))
+			goto out;
+		r = kvm_irqfd(kvm, data.fd, data.gsi, data.flags);
+		break;
+	}
+	case KVM_IOEVENTFD: {
+		struct kvm_ioeventfd data;
+
+		r = -EFAULT;
+		if (copy_from_user(&data, argp, sizeof data))
+			goto out;
+		r = kvm_ioeventfd(kvm, &data);
+		break;
+	}
 #endif
 	default:
 		r = kvm_arch_vm_ioctl(filp, ioctl, arg);
@@ -1971,6 +2013,10 @@ static long kvm_dev_ioctl_check_extension_generic(long arg)
 	switch (arg) {
 	case KVM_CAP_USER_MEMORY:
 	case KVM_CAP_DESTROY_MEMORY_REGION_WORKS:
+#ifdef KVM_CAP_IRQFD
+	case KVM_CAP_IRQFD:
+	case KVM_CAP_IOEVENTFD:
+#endif
 		return 1;
 	default:
 		break;